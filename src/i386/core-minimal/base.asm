@@ -25,6 +25,17 @@ header_start:
     HEADER_SIZE                dd (header_end - header_start)
     HEADER_CHECKSUM            dd 0x100000000 - (0xE85250D6 + 0 + (header_end - header_start))
 
+    ; The framebuffer tag, asking GRUB for a 32-bit linear framebuffer. It is
+    ; optional, so the kernel still boots (with the serial port only) without
+    dw 5                                                                ; Type
+    dw 1                                                                ; Flags (optional)
+    dd 20                                                               ; Size
+    dd 1024                                                             ; Width
+    dd 768                                                              ; Height
+    dd 32                                                               ; Depth
+    align 8, db 0                                                       ; Tags are 8 bytes aligned
+
+    ; The end tag
     dw 0                                                                ; Type
     dw 0                                                                ; Flags
     dd 8                                                                ; Size
@@ -18,8 +18,44 @@
 
 #include "osmos/osmos.hpp"
 
+#include "osmos/fs/ext4.hpp"
+#include "osmos/fs/initramfs.hpp"
+#include "osmos/fs/mbr.hpp"
+#include "osmos/fs/pagecache.hpp"
+#include "osmos/io/block.hpp"
+#include "osmos/io/console.hpp"
+#include "osmos/io/pci.hpp"
 #include "osmos/io/port.hpp"
+#include "osmos/io/timer.hpp"
+#include "osmos/io/virtioblock.hpp"
+#include "osmos/sys/deferred.hpp"
+#include "osmos/sys/frame.hpp"
+#include "osmos/sys/interrupts.hpp"
 #include "osmos/sys/memory.hpp"
+#include "osmos/sys/multiboot.hpp"
+#include "osmos/sys/paging.hpp"
+#include "osmos/sys/process.hpp"
+#include "osmos/sys/processor.hpp"
+#include "osmos/sys/scheduler.hpp"
+#include "osmos/sys/segments.hpp"
+#include "osmos/sys/syscall.hpp"
+
+// The end of the kernel image, defined by the linker script
+extern "C" uint8_t ebss[];
+
+// Writes an unsigned number in decimal on the serial port
+static void outDecimal(uint32_t value) {
+    char digits[11];
+    uint32_t position = sizeof(digits) - 1;
+
+    digits[position] = '\0';
+    do {
+        digits[--position] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, &digits[position]);
+}
 
 extern "C"
 void kboot(uint32_t magic, uint32_t table_address) {
@@ -31,6 +67,13 @@ void kboot(uint32_t magic, uint32_t table_address) {
     OSMOS::IO::Port::out((uint16_t) 0x3F8 + 2, (uint8_t) 0xC7);
     OSMOS::IO::Port::out((uint16_t) 0x3F8 + 4, (uint8_t) 0x0B);
 
+    // The boot information is copied before the frame allocator may reuse it
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Reading the boot information... ");
+    if (OSMOS::System::Multiboot::initialize(magic, table_address))
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+    else
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "failed\r\n");
+
     OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializating memory allocation... ");
     
     address_t baseAddress = 0;
@@ -42,6 +85,293 @@ void kboot(uint32_t magic, uint32_t table_address) {
     OSMOS::System::Memory::setLimitAddress(baseAddress + 128 * 1024);
     OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
 
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing frame allocation... ");
+    OSMOS::System::Frame::initialize((address_t) ebss, (address_t) ebss + 16 * 1024 * 1024);
+
+    // The loader puts the modules after the kernel, where the frames are
+    OSMOS::System::Multiboot::Module *module = NULL;
+    while ((module = OSMOS::System::Multiboot::getModule(module)) != NULL)
+        OSMOS::System::Frame::reserve(module->start, module->end - module->start);
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+
+    // The first module which is an archive is the initramfs
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Indexing the initramfs... ");
+    while ((module = OSMOS::System::Multiboot::getModule(module)) != NULL) {
+        if (OSMOS::FS::Initramfs::initialize(module->start, module->end))
+            break;
+    }
+
+    if (OSMOS::FS::Initramfs::isReady()) {
+        outDecimal(OSMOS::FS::Initramfs::getFileCount());
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " files\r\n");
+    } else {
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "none found\r\n");
+    }
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing segments... ");
+    OSMOS::System::Segments::initialize();
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing interrupts... ");
+    OSMOS::System::Interrupts::initialize();
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing scheduler and SSE... ");
+    if (OSMOS::System::Scheduler::initialize())
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+    else
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done (no SSE)\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Enabling paging... ");
+    bool paging = OSMOS::System::Paging::initialize();
+    if (paging)
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+    else
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "unsupported\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing system calls... ");
+    bool syscalls = paging && OSMOS::System::Syscall::initialize();
+    if (syscalls)
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+    else
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "unsupported\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing timer... ");
+    OSMOS::IO::Timer::initialize();
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing deferred work... ");
+    if (OSMOS::System::Deferred::initialize())
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+    else
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done (no worker thread)\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing framebuffer console... ");
+    if (OSMOS::IO::Console::initialize(OSMOS::System::Multiboot::getFramebuffer()) && OSMOS::IO::Console::startFlusher())
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+    else
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "unavailable\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing block layer... ");
+    OSMOS::IO::Block::initialize();
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing page cache... ");
+    OSMOS::FS::PageCache::initialize();
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Enumerating PCI devices... ");
+    OSMOS::IO::PCI::enumerate();
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "Initializing virtio block devices... ");
+    if (OSMOS::IO::VirtioBlock::initialize() > 0)
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+    else
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "none found\r\n");
+    OSMOS::System::Interrupts::enable();
+
+    if (syscalls) {
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "Benchmarking the null system call... ");
+
+        uint32_t cycles = OSMOS::System::Syscall::benchmark();
+        if (cycles != 0) {
+            outDecimal(cycles);
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, " cycles per call\r\n");
+        } else {
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "failed\r\n");
+        }
+    }
+
+    if (OSMOS::IO::Console::isReady()) {
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "Benchmarking the console... ");
+
+        // Every line after the first screen scrolls, so the repaints are
+        // batched while the dirty cells of the last line are flushed
+        uint64_t start = OSMOS::System::Processor::readTimestamp();
+        for (uint32_t i = 0; i < 256; i++)
+            OSMOS::IO::Console::write("OSMOS framebuffer console, drawn from its shadow buffer\n");
+
+        OSMOS::IO::Console::flush();
+        uint64_t cycles = OSMOS::System::Processor::readTimestamp() - start;
+
+        outDecimal((uint32_t) (cycles >> 8));
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " cycles per line, ");
+        outDecimal(OSMOS::IO::Console::getStatistics()->repaints);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " repaints\r\n");
+    }
+
+    // The first program comes from the initramfs, its pages lent by the
+    // memory of the module without any disk, or else from the disk below
+    bool initialized = false;
+    OSMOS::FS::Initramfs::File *init = OSMOS::FS::Initramfs::find("/bin/init");
+    if (syscalls && init != NULL) {
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "Running /bin/init from the initramfs... ");
+
+        OSMOS::System::Process::Control *process = OSMOS::System::Process::execute(init);
+        if (process != NULL) {
+            uint32_t code = OSMOS::System::Process::wait(process);
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "exited with ");
+            outDecimal(code);
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, ", ");
+            outDecimal(OSMOS::FS::Initramfs::getStatistics()->lent);
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, " pages lent, ");
+            outDecimal(OSMOS::FS::Initramfs::getStatistics()->copied);
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, " copied\r\n");
+
+            initialized = true;
+        } else {
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "not an executable\r\n");
+        }
+    }
+
+    OSMOS::IO::Block::Device *disk = OSMOS::IO::Block::getDevice(0);
+    if (disk != NULL) {
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "Reading the boot sector... ");
+
+        OSMOS::IO::Block::Buffer *buffer = OSMOS::IO::Block::read(disk, 0);
+        if (buffer != NULL && buffer->data[510] == 0x55 && buffer->data[511] == 0xAA)
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+        else
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "failed\r\n");
+
+        if (buffer != NULL)
+            OSMOS::IO::Block::release(buffer);
+
+        // The second read is served by the buffer cache
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "Reading the boot sector again... ");
+
+        uint32_t dispatched = disk->statistics.dispatched;
+        buffer = OSMOS::IO::Block::read(disk, 0);
+        if (buffer != NULL && disk->statistics.dispatched == dispatched)
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "done (cached)\r\n");
+        else
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "failed\r\n");
+
+        if (buffer != NULL)
+            OSMOS::IO::Block::release(buffer);
+
+        OSMOS::FS::MBR::Partition partition;
+        OSMOS::FS::Ext4::Volume *volume = NULL;
+
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "Mounting the ext4 partition... ");
+        if (OSMOS::FS::MBR::find(disk, OSMOS::FS::MBR::TYPE_LINUX, &partition))
+            volume = OSMOS::FS::Ext4::mount(disk, partition.start);
+
+        if (volume != NULL)
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+        else
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "failed\r\n");
+
+        // The kernel image is read back by large sequential reads, which grow
+        // the readahead window
+        static OSMOS::FS::Ext4::File file;
+        if (volume != NULL && OSMOS::FS::Ext4::open(volume, "/boot/core/boot.bin", &file)) {
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "Reading /boot/core/boot.bin... ");
+
+            uint32_t size = OSMOS::FS::Ext4::getSize(&file);
+            uint32_t frames = (size + OSMOS::System::Frame::FRAME_SIZE - 1) / OSMOS::System::Frame::FRAME_SIZE;
+            uint8_t *image = (uint8_t *) OSMOS::System::Frame::allocate(frames);
+            uint32_t total = 0;
+
+            if (image != NULL) {
+                uint32_t length;
+
+                while ((length = OSMOS::FS::Ext4::read(&file, image + total, 65536)) > 0)
+                    total += length;
+
+                OSMOS::System::Frame::free((address_t) image, frames);
+            }
+
+            if (image != NULL && total == size)
+                OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+            else
+                OSMOS::IO::Port::out((uint16_t) 0x3F8, "failed\r\n");
+        }
+
+        // The kernel image is mapped in a new space: the pages of the cache
+        // are lent to the mapping, and a write only copies the written page
+        OSMOS::FS::PageCache::Object *object = NULL;
+        OSMOS::System::Paging::Space *space = NULL;
+
+        if (paging && volume != NULL && (object = OSMOS::FS::PageCache::open(volume, "/boot/core/boot.bin")) != NULL)
+            space = OSMOS::System::Paging::create();
+
+        if (space != NULL) {
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "Mapping /boot/core/boot.bin... ");
+
+            uint32_t size = (uint32_t) OSMOS::FS::PageCache::getSize(object);
+            uint8_t *mapped = (uint8_t *) OSMOS::System::Paging::USER_BASE;
+            uint8_t chunk[256];
+
+            // The processes which ran before copied pages too: only the
+            // single copy made by the write below counts
+            uint32_t copied = OSMOS::System::Paging::getStatistics()->copied;
+            bool success = OSMOS::FS::PageCache::mapFile(space, OSMOS::System::Paging::USER_BASE, size, object, 0, OSMOS::System::Paging::MAPPING_PRIVATE | OSMOS::System::Paging::MAPPING_WRITABLE);
+
+            if (success) {
+                OSMOS::System::Paging::activate(space);
+
+                for (uint32_t offset = 0; success && offset < size; offset += sizeof(chunk)) {
+                    uint32_t length = OSMOS::FS::PageCache::read(object, offset, chunk, sizeof(chunk));
+
+                    for (uint32_t i = 0; success && i < length; i++)
+                        success = (chunk[i] == mapped[offset + i]);
+                }
+
+                mapped[0] = (uint8_t) ~mapped[0];
+                success = success && OSMOS::FS::PageCache::read(object, 0, chunk, 1) == 1 && chunk[0] != mapped[0];
+
+                OSMOS::System::Paging::activate(OSMOS::System::Paging::getKernelSpace());
+            }
+
+            if (success && OSMOS::System::Paging::getStatistics()->copied == copied + 1)
+                OSMOS::IO::Port::out((uint16_t) 0x3F8, "done\r\n");
+            else
+                OSMOS::IO::Port::out((uint16_t) 0x3F8, "failed\r\n");
+
+            OSMOS::System::Paging::destroy(space);
+        }
+
+        if (object != NULL)
+            OSMOS::FS::PageCache::close(object);
+
+        // Without an initramfs, the first program comes from the disk, its
+        // segments read as it runs
+        OSMOS::System::Process::Control *process = NULL;
+        if (!initialized && syscalls && volume != NULL && (process = OSMOS::System::Process::execute(volume, "/bin/init")) != NULL) {
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "Running /bin/init... ");
+
+            uint32_t code = OSMOS::System::Process::wait(process);
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "exited with ");
+            outDecimal(code);
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, "\r\n");
+        }
+    }
+
+    // A queue whose batches reach BATCH_MAXIMUM, or with deferred runs, needs
+    // a larger budget
+    for (uint32_t i = 0; i < OSMOS::System::Deferred::getQueueCount(); i++) {
+        OSMOS::System::Deferred::Queue *queue = OSMOS::System::Deferred::getQueue(i);
+        OSMOS::System::Deferred::Statistics *statistics = &queue->statistics;
+
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "Deferred queue ");
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, queue->name);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, ": ");
+        outDecimal(statistics->processed);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " items in ");
+        outDecimal(statistics->batches);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " batches (at most ");
+        outDecimal(statistics->batchMaximum);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "), ");
+        outDecimal(statistics->deferred);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " deferred, ");
+        outDecimal(statistics->dropped);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " dropped, ");
+        outDecimal(statistics->delayMaximum);
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, " cycles of delay at most\r\n");
+    }
+
     OSMOS::IO::Port::out((uint16_t) 0x3F8, "Allocating 16 bytes block... ");
     char *str = (char *) OSMOS::System::Memory::allocateBlock(16);
     OSMOS::IO::Port::out((uint16_t) 0x3F8, "...and another 16 bytes block... ");
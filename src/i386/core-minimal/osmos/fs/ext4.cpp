@@ -0,0 +1,760 @@
+/*
+ * The ext4 filesystem class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ext4.hpp"
+
+#include "../sys/memory.hpp"
+
+uint32_t OSMOS::FS::Ext4::INODE_ROOT                        = 2;
+
+uint16_t OSMOS::FS::Ext4::MODE_TYPE                         = 0xF000;
+uint16_t OSMOS::FS::Ext4::MODE_DIRECTORY                    = 0x4000;
+uint16_t OSMOS::FS::Ext4::MODE_REGULAR                      = 0x8000;
+
+OSMOS::FS::Ext4::Volume OSMOS::FS::Ext4::VOLUMES[OSMOS::FS::Ext4::VOLUME_MAXIMUM];
+uint32_t OSMOS::FS::Ext4::VOLUME_COUNT                      = 0;
+
+// The position of the superblock in the volume, and its magic number
+#define EXT4_SUPERBLOCK_OFFSET                              1024
+#define EXT4_MAGIC                                          0xEF53
+
+// The features used by the driver
+#define EXT4_FEATURE_COMPATIBLE_DIRECTORY_INDEX             0x0020
+#define EXT4_FEATURE_INCOMPATIBLE_FILE_TYPE                 0x0002
+#define EXT4_FEATURE_INCOMPATIBLE_RECOVER                   0x0004
+#define EXT4_FEATURE_INCOMPATIBLE_EXTENTS                   0x0040
+#define EXT4_FEATURE_INCOMPATIBLE_64BIT                     0x0080
+#define EXT4_FEATURE_INCOMPATIBLE_MMP                       0x0100
+#define EXT4_FEATURE_INCOMPATIBLE_FLEX_GROUPS               0x0200
+#define EXT4_FEATURE_INCOMPATIBLE_CHECKSUM_SEED             0x2000
+#define EXT4_FEATURE_INCOMPATIBLE_LARGE_DIRECTORIES         0x4000
+
+// The incompatible features which do not change how a read-only driver finds
+// the data. A journal needing recovery is ignored: its last transactions are
+// not seen
+#define EXT4_FEATURE_INCOMPATIBLE_SUPPORTED                 (EXT4_FEATURE_INCOMPATIBLE_FILE_TYPE | EXT4_FEATURE_INCOMPATIBLE_RECOVER | \
+                                                             EXT4_FEATURE_INCOMPATIBLE_EXTENTS | EXT4_FEATURE_INCOMPATIBLE_64BIT | \
+                                                             EXT4_FEATURE_INCOMPATIBLE_MMP | EXT4_FEATURE_INCOMPATIBLE_FLEX_GROUPS | \
+                                                             EXT4_FEATURE_INCOMPATIBLE_CHECKSUM_SEED | EXT4_FEATURE_INCOMPATIBLE_LARGE_DIRECTORIES)
+
+// The superblock flag selecting the unsigned variants of the hashes
+#define EXT4_FLAG_UNSIGNED_HASH                             0x0002
+
+// The inode flags
+#define EXT4_INODE_INDEX                                    0x00001000
+#define EXT4_INODE_EXTENTS                                  0x00080000
+#define EXT4_INODE_INLINE_DATA                              0x10000000
+
+// The magic number of the extent tree nodes, the length from which an extent
+// is uninitialized, and the maximum depth of a tree
+#define EXT4_EXTENT_MAGIC                                   0xF30A
+#define EXT4_EXTENT_UNINITIALIZED                           32768
+#define EXT4_EXTENT_DEPTH_MAXIMUM                           5
+
+// The hash versions of the directory indexes, the unsigned variants being
+// the signed ones plus 3
+#define EXT4_HASH_LEGACY                                    0
+#define EXT4_HASH_HALF_MD4                                  1
+#define EXT4_HASH_TEA                                       2
+#define EXT4_HASH_LEGACY_UNSIGNED                           3
+#define EXT4_HASH_HALF_MD4_UNSIGNED                         4
+#define EXT4_HASH_TEA_UNSIGNED                              5
+
+OSMOS::FS::Ext4::Volume *OSMOS::FS::Ext4::mount(OSMOS::IO::Block::Device *device, uint32_t sector) {
+    if (OSMOS::FS::Ext4::VOLUME_COUNT >= OSMOS::FS::Ext4::VOLUME_MAXIMUM)
+        return NULL;
+
+    OSMOS::FS::Ext4::Volume *volume = &OSMOS::FS::Ext4::VOLUMES[OSMOS::FS::Ext4::VOLUME_COUNT];
+    volume->device = device;
+    volume->offset = (uint64_t) sector * device->sectorSize;
+
+    OSMOS::FS::Ext4::Superblock superblock;
+    if (!OSMOS::FS::Ext4::readBytes(volume, EXT4_SUPERBLOCK_OFFSET, (uint8_t *) &superblock, sizeof(OSMOS::FS::Ext4::Superblock)))
+        return NULL;
+
+    if (superblock.magic != EXT4_MAGIC || superblock.revision == 0)
+        return NULL;
+    if (superblock.featureIncompatible & ~EXT4_FEATURE_INCOMPATIBLE_SUPPORTED)
+        return NULL;
+
+    // A block must fit in a buffer and never cross two of them
+    volume->blockShift = 10 + superblock.logBlockSize;
+    volume->blockSize = 1 << volume->blockShift;
+    if (volume->blockSize > OSMOS::IO::Block::BUFFER_SIZE || (volume->offset & (volume->blockSize - 1)) != 0)
+        return NULL;
+
+    volume->wide = (superblock.featureIncompatible & EXT4_FEATURE_INCOMPATIBLE_64BIT) != 0;
+    if (volume->wide && superblock.blocksCountHigh != 0)
+        return NULL;
+
+    volume->blockCount = superblock.blocksCountLow;
+    volume->blocksPerGroup = superblock.blocksPerGroup;
+    volume->inodesPerGroup = superblock.inodesPerGroup;
+    volume->inodeSize = superblock.inodeSize;
+    volume->firstDataBlock = superblock.firstDataBlock;
+    volume->descriptorSize = (volume->wide ? superblock.descriptorSize : 32);
+    if (volume->blocksPerGroup == 0 || volume->inodesPerGroup == 0 || volume->inodeSize < sizeof(OSMOS::FS::Ext4::Inode) || volume->descriptorSize < 32)
+        return NULL;
+
+    volume->groupCount = (volume->blockCount - volume->firstDataBlock + volume->blocksPerGroup - 1) / volume->blocksPerGroup;
+
+    for (uint32_t i = 0; i < 4; i++)
+        volume->hashSeed[i] = superblock.hashSeed[i];
+    volume->hashUnsigned = (superblock.flags & EXT4_FLAG_UNSIGNED_HASH ? 3 : 0);
+    volume->indexed = (superblock.featureCompatible & EXT4_FEATURE_COMPATIBLE_DIRECTORY_INDEX) != 0;
+
+    OSMOS::FS::Ext4::File root;
+    if (!OSMOS::FS::Ext4::load(volume, OSMOS::FS::Ext4::INODE_ROOT, &root) || (root.inode.mode & OSMOS::FS::Ext4::MODE_TYPE) != OSMOS::FS::Ext4::MODE_DIRECTORY)
+        return NULL;
+
+    OSMOS::FS::Ext4::VOLUME_COUNT++;
+    return volume;
+}
+
+bool OSMOS::FS::Ext4::readBytes(OSMOS::FS::Ext4::Volume *volume, uint64_t offset, uint8_t *target, uint32_t length) {
+    offset += volume->offset;
+
+    while (length > 0) {
+        uint32_t position = offset % OSMOS::IO::Block::BUFFER_SIZE;
+        uint32_t chunk = OSMOS::IO::Block::BUFFER_SIZE - position;
+        if (chunk > length)
+            chunk = length;
+
+        OSMOS::IO::Block::Buffer *buffer = OSMOS::IO::Block::read(volume->device, offset / OSMOS::IO::Block::BUFFER_SIZE);
+        if (buffer == NULL)
+            return false;
+
+        OSMOS::System::Memory::copy(target, buffer->data + position, chunk);
+        OSMOS::IO::Block::release(buffer);
+
+        offset += chunk;
+        target += chunk;
+        length -= chunk;
+    }
+
+    return true;
+}
+
+uint8_t *OSMOS::FS::Ext4::getBlock(OSMOS::FS::Ext4::Volume *volume, uint64_t block, OSMOS::IO::Block::Buffer **buffer) {
+    if (block >= volume->blockCount)
+        return NULL;
+
+    uint64_t offset = volume->offset + (block << volume->blockShift);
+
+    *buffer = OSMOS::IO::Block::read(volume->device, offset / OSMOS::IO::Block::BUFFER_SIZE);
+    if (*buffer == NULL)
+        return NULL;
+
+    return (*buffer)->data + (offset % OSMOS::IO::Block::BUFFER_SIZE);
+}
+
+bool OSMOS::FS::Ext4::load(OSMOS::FS::Ext4::Volume *volume, uint32_t number, OSMOS::FS::Ext4::File *file) {
+    if (number == 0)
+        return false;
+
+    uint32_t group = (number - 1) / volume->inodesPerGroup;
+    uint32_t index = (number - 1) % volume->inodesPerGroup;
+    if (group >= volume->groupCount)
+        return false;
+
+    // The descriptors follow the block of the superblock
+    OSMOS::FS::Ext4::GroupDescriptor descriptor;
+    uint64_t position = ((uint64_t) (volume->firstDataBlock + 1) << volume->blockShift) + (uint64_t) group * volume->descriptorSize;
+    if (!OSMOS::FS::Ext4::readBytes(volume, position, (uint8_t *) &descriptor, volume->descriptorSize < sizeof(OSMOS::FS::Ext4::GroupDescriptor) ? volume->descriptorSize : sizeof(OSMOS::FS::Ext4::GroupDescriptor)))
+        return false;
+
+    uint64_t table = descriptor.inodeTableLow;
+    if (volume->wide && volume->descriptorSize >= 64)
+        table |= (uint64_t) descriptor.inodeTableHigh << 32;
+
+    position = (table << volume->blockShift) + (uint64_t) index * volume->inodeSize;
+    if (!OSMOS::FS::Ext4::readBytes(volume, position, (uint8_t *) &file->inode, sizeof(OSMOS::FS::Ext4::Inode)))
+        return false;
+
+    // Only the extent-mapped inodes are read; mkfs.ext4 and the kernel map
+    // every new file and directory this way
+    if (!(file->inode.flags & EXT4_INODE_EXTENTS) || (file->inode.flags & EXT4_INODE_INLINE_DATA))
+        return false;
+
+    file->volume = volume;
+    file->number = number;
+    file->size = ((uint64_t) file->inode.sizeHigh << 32) | file->inode.sizeLow;
+    file->position = 0;
+    file->extentBlock = 0;
+    file->extentLength = 0;
+    file->extentStart = 0;
+    file->extentUninitialized = false;
+    file->readaheadNext = 0;
+    file->readaheadEnd = 0;
+    file->readaheadWindow = 0;
+
+    return true;
+}
+
+uint64_t OSMOS::FS::Ext4::map(OSMOS::FS::Ext4::File *file, uint32_t block, uint32_t *count) {
+    *count = 1;
+
+    // Sequential reads stay in the same extent most of the time
+    if (file->extentLength == 0 || block < file->extentBlock || block - file->extentBlock >= file->extentLength) {
+        OSMOS::IO::Block::Buffer *buffer = NULL;
+        uint8_t *node = (uint8_t *) file->inode.block;
+        bool found = false;
+
+        for (uint32_t level = 0; level <= EXT4_EXTENT_DEPTH_MAXIMUM; level++) {
+            OSMOS::FS::Ext4::ExtentHeader *header = (OSMOS::FS::Ext4::ExtentHeader *) node;
+            if (header->magic != EXT4_EXTENT_MAGIC || header->entries == 0)
+                break;
+
+            if (header->depth == 0) {
+                OSMOS::FS::Ext4::Extent *extents = (OSMOS::FS::Ext4::Extent *) (header + 1);
+
+                // The last extent starting at or before the block
+                uint32_t low = 0, high = header->entries;
+                while (high - low > 1) {
+                    uint32_t middle = (low + high) / 2;
+                    if (extents[middle].block <= block)
+                        low = middle;
+                    else
+                        high = middle;
+                }
+
+                OSMOS::FS::Ext4::Extent *extent = &extents[low];
+                uint32_t length = (extent->length > EXT4_EXTENT_UNINITIALIZED ? extent->length - EXT4_EXTENT_UNINITIALIZED : extent->length);
+
+                if (extent->block <= block && block - extent->block < length) {
+                    file->extentBlock = extent->block;
+                    file->extentLength = length;
+                    file->extentStart = ((uint64_t) extent->startHigh << 32) | extent->startLow;
+                    file->extentUninitialized = (extent->length > EXT4_EXTENT_UNINITIALIZED);
+                    found = true;
+                }
+
+                break;
+            }
+
+            OSMOS::FS::Ext4::ExtentIndex *indexes = (OSMOS::FS::Ext4::ExtentIndex *) (header + 1);
+            if (indexes[0].block > block)
+                break;
+
+            uint32_t low = 0, high = header->entries;
+            while (high - low > 1) {
+                uint32_t middle = (low + high) / 2;
+                if (indexes[middle].block <= block)
+                    low = middle;
+                else
+                    high = middle;
+            }
+
+            uint64_t child = ((uint64_t) indexes[low].leafHigh << 32) | indexes[low].leafLow;
+
+            if (buffer != NULL)
+                OSMOS::IO::Block::release(buffer);
+            buffer = NULL;
+
+            node = OSMOS::FS::Ext4::getBlock(file->volume, child, &buffer);
+            if (node == NULL)
+                break;
+        }
+
+        if (buffer != NULL)
+            OSMOS::IO::Block::release(buffer);
+
+        if (!found)
+            return 0;
+    }
+
+    *count = file->extentLength - (block - file->extentBlock);
+    return (file->extentUninitialized ? 0 : file->extentStart + (block - file->extentBlock));
+}
+
+void OSMOS::FS::Ext4::prefetch(OSMOS::FS::Ext4::File *file, uint32_t first, uint32_t end) {
+    OSMOS::FS::Ext4::Volume *volume = file->volume;
+
+    while (first < end) {
+        uint32_t count;
+        uint64_t physical = OSMOS::FS::Ext4::map(file, first, &count);
+
+        if (count > end - first)
+            count = end - first;
+
+        // A whole run of the extent is a single range of buffers, which the
+        // block layer merges into large requests
+        if (physical != 0) {
+            uint64_t start = volume->offset + (physical << volume->blockShift);
+            uint64_t limit = start + ((uint64_t) count << volume->blockShift);
+            uint32_t index = start / OSMOS::IO::Block::BUFFER_SIZE;
+            uint32_t last = (limit - 1) / OSMOS::IO::Block::BUFFER_SIZE;
+
+            OSMOS::IO::Block::prefetch(volume->device, index, last - index + 1);
+        }
+
+        first += count;
+    }
+}
+
+void OSMOS::FS::Ext4::readahead(OSMOS::FS::Ext4::File *file, uint32_t first, uint32_t last) {
+    uint32_t shift = file->volume->blockShift;
+    uint32_t minimum = OSMOS::FS::Ext4::READAHEAD_MINIMUM >> shift;
+    uint32_t maximum = OSMOS::FS::Ext4::READAHEAD_MAXIMUM >> shift;
+
+    // A read continuing the previous one doubles the window, a read at the
+    // start of the file opens it, and any other read closes it
+    if (first == file->readaheadNext && first != 0)
+        file->readaheadWindow = (file->readaheadWindow * 2 < minimum ? minimum : file->readaheadWindow * 2);
+    else if (first == 0)
+        file->readaheadWindow = minimum;
+    else
+        file->readaheadWindow = 0;
+
+    if (file->readaheadWindow > maximum)
+        file->readaheadWindow = maximum;
+
+    file->readaheadNext = last + 1;
+
+    uint64_t blocks = (file->size + file->volume->blockSize - 1) >> shift;
+    uint32_t end = last + 1 + file->readaheadWindow;
+    if (end > blocks)
+        end = blocks;
+
+    if (file->readaheadWindow == 0 || file->readaheadEnd < first)
+        file->readaheadEnd = first;
+
+    // The next window is started once half of the current one is consumed,
+    // so the device keeps working while the reader copies
+    if (file->readaheadEnd < last + 1 + file->readaheadWindow / 2 && file->readaheadEnd < end) {
+        OSMOS::FS::Ext4::prefetch(file, file->readaheadEnd, end);
+        file->readaheadEnd = end;
+    }
+}
+
+uint32_t OSMOS::FS::Ext4::read(OSMOS::FS::Ext4::File *file, uint8_t *target, uint32_t length) {
+    OSMOS::FS::Ext4::Volume *volume = file->volume;
+
+    if (file->position >= file->size || length == 0)
+        return 0;
+    if (file->size - file->position < length)
+        length = file->size - file->position;
+
+    OSMOS::FS::Ext4::readahead(file, file->position >> volume->blockShift, (file->position + length - 1) >> volume->blockShift);
+
+    uint32_t done = 0;
+    while (done < length) {
+        uint32_t block = file->position >> volume->blockShift;
+        uint32_t offset = file->position & (volume->blockSize - 1);
+        uint32_t chunk = volume->blockSize - offset;
+        if (chunk > length - done)
+            chunk = length - done;
+
+        uint32_t count;
+        uint64_t physical = OSMOS::FS::Ext4::map(file, block, &count);
+
+        if (physical == 0) {
+            OSMOS::System::Memory::fill(target + done, chunk, 0);
+        } else {
+            OSMOS::IO::Block::Buffer *buffer;
+            uint8_t *data = OSMOS::FS::Ext4::getBlock(volume, physical, &buffer);
+            if (data == NULL)
+                break;
+
+            OSMOS::System::Memory::copy(target + done, data + offset, chunk);
+            OSMOS::IO::Block::release(buffer);
+        }
+
+        file->position += chunk;
+        done += chunk;
+    }
+
+    return done;
+}
+
+bool OSMOS::FS::Ext4::readPages(OSMOS::FS::Ext4::File *file, uint32_t index, uint8_t **frames, uint32_t count) {
+    OSMOS::FS::Ext4::Volume *volume = file->volume;
+    uint32_t blocksPerPage = OSMOS::IO::Block::BUFFER_SIZE >> volume->blockShift;
+    uint32_t first = 0, start = 0, run = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t contiguous;
+        uint64_t physical = OSMOS::FS::Ext4::map(file, (index + i) * blocksPerPage, &contiguous);
+        uint64_t offset = volume->offset + (physical << volume->blockShift);
+        uint32_t buffer = offset / OSMOS::IO::Block::BUFFER_SIZE;
+
+        // A page is read in place when the blocks of its extent cover it and
+        // start on a buffer of the device
+        bool direct = (physical != 0 && contiguous >= blocksPerPage && offset % OSMOS::IO::Block::BUFFER_SIZE == 0);
+
+        // The pages read in place are gathered while their buffers follow
+        // each other, and each run is a single call to the block layer
+        if (run > 0 && (!direct || buffer != start + run || run == OSMOS::IO::Block::REQUEST_BUFFER_MAXIMUM)) {
+            if (!OSMOS::IO::Block::readFrames(volume->device, start, frames + first, run))
+                return false;
+
+            run = 0;
+        }
+
+        if (direct) {
+            if (run == 0) {
+                first = i;
+                start = buffer;
+            }
+
+            run++;
+            continue;
+        }
+
+        // A hole or an uninitialized extent reads as zeroes
+        if (physical == 0 && contiguous >= blocksPerPage) {
+            OSMOS::System::Memory::fill(frames[i], OSMOS::IO::Block::BUFFER_SIZE, (uint8_t) 0);
+            continue;
+        }
+
+        // A fragmented or misaligned page goes through the buffers
+        uint64_t position = (uint64_t) (index + i) * OSMOS::IO::Block::BUFFER_SIZE;
+        if (position >= file->size)
+            return false;
+
+        uint32_t length = OSMOS::IO::Block::BUFFER_SIZE;
+        if (file->size - position < length)
+            length = file->size - position;
+
+        OSMOS::FS::Ext4::seek(file, position);
+        if (OSMOS::FS::Ext4::read(file, frames[i], length) != length)
+            return false;
+    }
+
+    if (run > 0)
+        return OSMOS::IO::Block::readFrames(volume->device, start, frames + first, run);
+
+    return true;
+}
+
+void OSMOS::FS::Ext4::seek(OSMOS::FS::Ext4::File *file, uint64_t position) {
+    file->position = position;
+}
+
+uint64_t OSMOS::FS::Ext4::getSize(OSMOS::FS::Ext4::File *file) {
+    return file->size;
+}
+
+// The rounds of the half MD4 and TEA hashes, as computed by ext4
+#define EXT4_HASH_F(x, y, z)                                ((z) ^ ((x) & ((y) ^ (z))))
+#define EXT4_HASH_G(x, y, z)                                (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define EXT4_HASH_H(x, y, z)                                ((x) ^ (y) ^ (z))
+#define EXT4_HASH_ROUND(f, a, b, c, d, x, s)                (a += f(b, c, d) + (x), a = ((a) << (s)) | ((a) >> (32 - (s))))
+#define EXT4_HASH_K2                                        013240474631U
+#define EXT4_HASH_K3                                        015666365641U
+#define EXT4_HASH_TEA_DELTA                                 0x9E3779B9
+
+void OSMOS::FS::Ext4::pack(const char *name, uint32_t length, uint32_t *words, int32_t count, bool signedCharacters) {
+    uint32_t padding = length | (length << 8);
+    padding |= padding << 16;
+
+    uint32_t value = padding;
+    if (length > (uint32_t) count * 4)
+        length = count * 4;
+
+    for (uint32_t i = 0; i < length; i++) {
+        int32_t character = (signedCharacters ? (int32_t) (int8_t) name[i] : (int32_t) (uint8_t) name[i]);
+
+        value = character + (value << 8);
+        if (i % 4 == 3) {
+            *words++ = value;
+            value = padding;
+            count--;
+        }
+    }
+
+    if (--count >= 0)
+        *words++ = value;
+    while (--count >= 0)
+        *words++ = padding;
+}
+
+uint32_t OSMOS::FS::Ext4::hash(OSMOS::FS::Ext4::Volume *volume, uint8_t version, const char *name, uint32_t length) {
+    uint32_t state[4] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476 };
+    uint32_t words[8];
+    uint32_t hash = 0;
+
+    if (volume->hashSeed[0] | volume->hashSeed[1] | volume->hashSeed[2] | volume->hashSeed[3]) {
+        for (uint32_t i = 0; i < 4; i++)
+            state[i] = volume->hashSeed[i];
+    }
+
+    bool signedCharacters = (version < EXT4_HASH_LEGACY_UNSIGNED);
+
+    switch (version) {
+    case EXT4_HASH_LEGACY:
+    case EXT4_HASH_LEGACY_UNSIGNED: {
+        uint32_t hash0 = 0x12A3FE2D, hash1 = 0x37ABE8F9;
+
+        for (uint32_t i = 0; i < length; i++) {
+            int32_t character = (signedCharacters ? (int32_t) (int8_t) name[i] : (int32_t) (uint8_t) name[i]);
+
+            hash = hash1 + (hash0 ^ ((uint32_t) character * 7152373));
+            if (hash & 0x80000000)
+                hash -= 0x7FFFFFFF;
+            hash1 = hash0;
+            hash0 = hash;
+        }
+
+        hash = hash0 << 1;
+        break;
+    }
+
+    case EXT4_HASH_HALF_MD4:
+    case EXT4_HASH_HALF_MD4_UNSIGNED:
+        for (int32_t remaining = length; remaining > 0; remaining -= 32, name += 32) {
+            OSMOS::FS::Ext4::pack(name, remaining, words, 8, signedCharacters);
+
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+            EXT4_HASH_ROUND(EXT4_HASH_F, a, b, c, d, words[0], 3);
+            EXT4_HASH_ROUND(EXT4_HASH_F, d, a, b, c, words[1], 7);
+            EXT4_HASH_ROUND(EXT4_HASH_F, c, d, a, b, words[2], 11);
+            EXT4_HASH_ROUND(EXT4_HASH_F, b, c, d, a, words[3], 19);
+            EXT4_HASH_ROUND(EXT4_HASH_F, a, b, c, d, words[4], 3);
+            EXT4_HASH_ROUND(EXT4_HASH_F, d, a, b, c, words[5], 7);
+            EXT4_HASH_ROUND(EXT4_HASH_F, c, d, a, b, words[6], 11);
+            EXT4_HASH_ROUND(EXT4_HASH_F, b, c, d, a, words[7], 19);
+
+            EXT4_HASH_ROUND(EXT4_HASH_G, a, b, c, d, words[1] + EXT4_HASH_K2, 3);
+            EXT4_HASH_ROUND(EXT4_HASH_G, d, a, b, c, words[3] + EXT4_HASH_K2, 5);
+            EXT4_HASH_ROUND(EXT4_HASH_G, c, d, a, b, words[5] + EXT4_HASH_K2, 9);
+            EXT4_HASH_ROUND(EXT4_HASH_G, b, c, d, a, words[7] + EXT4_HASH_K2, 13);
+            EXT4_HASH_ROUND(EXT4_HASH_G, a, b, c, d, words[0] + EXT4_HASH_K2, 3);
+            EXT4_HASH_ROUND(EXT4_HASH_G, d, a, b, c, words[2] + EXT4_HASH_K2, 5);
+            EXT4_HASH_ROUND(EXT4_HASH_G, c, d, a, b, words[4] + EXT4_HASH_K2, 9);
+            EXT4_HASH_ROUND(EXT4_HASH_G, b, c, d, a, words[6] + EXT4_HASH_K2, 13);
+
+            EXT4_HASH_ROUND(EXT4_HASH_H, a, b, c, d, words[3] + EXT4_HASH_K3, 3);
+            EXT4_HASH_ROUND(EXT4_HASH_H, d, a, b, c, words[7] + EXT4_HASH_K3, 9);
+            EXT4_HASH_ROUND(EXT4_HASH_H, c, d, a, b, words[2] + EXT4_HASH_K3, 11);
+            EXT4_HASH_ROUND(EXT4_HASH_H, b, c, d, a, words[6] + EXT4_HASH_K3, 15);
+            EXT4_HASH_ROUND(EXT4_HASH_H, a, b, c, d, words[1] + EXT4_HASH_K3, 3);
+            EXT4_HASH_ROUND(EXT4_HASH_H, d, a, b, c, words[5] + EXT4_HASH_K3, 9);
+            EXT4_HASH_ROUND(EXT4_HASH_H, c, d, a, b, words[0] + EXT4_HASH_K3, 11);
+            EXT4_HASH_ROUND(EXT4_HASH_H, b, c, d, a, words[4] + EXT4_HASH_K3, 15);
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+        }
+
+        hash = state[1];
+        break;
+
+    case EXT4_HASH_TEA:
+    case EXT4_HASH_TEA_UNSIGNED:
+        for (int32_t remaining = length; remaining > 0; remaining -= 16, name += 16) {
+            OSMOS::FS::Ext4::pack(name, remaining, words, 4, signedCharacters);
+
+            uint32_t sum = 0;
+            uint32_t b0 = state[0], b1 = state[1];
+
+            for (uint32_t i = 0; i < 16; i++) {
+                sum += EXT4_HASH_TEA_DELTA;
+                b0 += ((b1 << 4) + words[0]) ^ (b1 + sum) ^ ((b1 >> 5) + words[1]);
+                b1 += ((b0 << 4) + words[2]) ^ (b0 + sum) ^ ((b0 >> 5) + words[3]);
+            }
+
+            state[0] += b0;
+            state[1] += b1;
+        }
+
+        hash = state[0];
+        break;
+    }
+
+    hash &= ~1U;
+    if (hash == 0xFFFFFFFE)
+        hash = 0xFFFFFFFC;
+
+    return hash;
+}
+
+bool OSMOS::FS::Ext4::searchBlock(OSMOS::FS::Ext4::File *file, uint32_t block, const char *name, uint32_t length, uint32_t *number) {
+    OSMOS::FS::Ext4::Volume *volume = file->volume;
+    uint32_t count;
+
+    uint64_t physical = OSMOS::FS::Ext4::map(file, block, &count);
+    if (physical == 0)
+        return false;
+
+    OSMOS::IO::Block::Buffer *buffer;
+    uint8_t *data = OSMOS::FS::Ext4::getBlock(volume, physical, &buffer);
+    if (data == NULL)
+        return false;
+
+    bool found = false;
+    uint32_t offset = 0;
+    while (offset + sizeof(OSMOS::FS::Ext4::DirectoryEntry) <= volume->blockSize) {
+        OSMOS::FS::Ext4::DirectoryEntry *entry = (OSMOS::FS::Ext4::DirectoryEntry *) (data + offset);
+        if (entry->recordLength < sizeof(OSMOS::FS::Ext4::DirectoryEntry) || offset + entry->recordLength > volume->blockSize)
+            break;
+
+        if (entry->inode != 0 && entry->nameLength == length) {
+            const char *entryName = (const char *) (entry + 1);
+            uint32_t i = 0;
+
+            while (i < length && entryName[i] == name[i])
+                i++;
+
+            if (i == length) {
+                *number = entry->inode;
+                found = true;
+                break;
+            }
+        }
+
+        offset += entry->recordLength;
+    }
+
+    OSMOS::IO::Block::release(buffer);
+    return found;
+}
+
+bool OSMOS::FS::Ext4::searchIndex(OSMOS::FS::Ext4::File *file, const char *name, uint32_t length, uint32_t *number, bool *found) {
+    OSMOS::FS::Ext4::Volume *volume = file->volume;
+    uint32_t count;
+
+    uint64_t physical = OSMOS::FS::Ext4::map(file, 0, &count);
+    if (physical == 0)
+        return false;
+
+    OSMOS::IO::Block::Buffer *buffer;
+    uint8_t *data = OSMOS::FS::Ext4::getBlock(volume, physical, &buffer);
+    if (data == NULL)
+        return false;
+
+    // The root follows the "." entry (12 bytes) and the ".." header
+    OSMOS::FS::Ext4::IndexRoot *root = (OSMOS::FS::Ext4::IndexRoot *) (data + 24);
+    uint8_t version = root->hashVersion;
+    uint32_t levels = root->indirectLevels;
+    uint32_t entriesOffset = 24 + root->informationLength;
+
+    if (root->reserved != 0 || version > EXT4_HASH_TEA || levels > 2 || entriesOffset + sizeof(OSMOS::FS::Ext4::IndexEntry) > volume->blockSize) {
+        OSMOS::IO::Block::release(buffer);
+        return false;
+    }
+
+    version += volume->hashUnsigned;
+    uint32_t target = OSMOS::FS::Ext4::hash(volume, version, name, length);
+
+    uint32_t leaf = 0;
+    uint32_t nextHash = 0;
+    bool hasNext = false;
+
+    for (uint32_t level = 0; ; level++) {
+        OSMOS::FS::Ext4::IndexEntry *entries = (OSMOS::FS::Ext4::IndexEntry *) (data + entriesOffset);
+        uint32_t entryCount = entries[0].hash >> 16;
+        uint32_t limit = entries[0].hash & 0xFFFF;
+
+        if (entryCount == 0 || entryCount > limit || entriesOffset + limit * sizeof(OSMOS::FS::Ext4::IndexEntry) > volume->blockSize) {
+            OSMOS::IO::Block::release(buffer);
+            return false;
+        }
+
+        // The last entry whose hash is at most the target; the first entry
+        // covers the lowest hashes
+        uint32_t low = 0, high = entryCount;
+        while (high - low > 1) {
+            uint32_t middle = (low + high) / 2;
+            if (entries[middle].hash <= target)
+                low = middle;
+            else
+                high = middle;
+        }
+
+        leaf = entries[low].block & 0x0FFFFFFF;
+        hasNext = (low + 1 < entryCount);
+        if (hasNext)
+            nextHash = entries[low + 1].hash;
+
+        OSMOS::IO::Block::release(buffer);
+
+        if (level == levels)
+            break;
+
+        // An inner node starts with an empty entry covering the whole block
+        physical = OSMOS::FS::Ext4::map(file, leaf, &count);
+        if (physical == 0)
+            return false;
+
+        data = OSMOS::FS::Ext4::getBlock(volume, physical, &buffer);
+        if (data == NULL)
+            return false;
+
+        entriesOffset = 8;
+    }
+
+    *found = OSMOS::FS::Ext4::searchBlock(file, leaf, name, length, number);
+
+    // Names with the same hash may continue in the next leaf, whose hash then
+    // has its lowest bit set
+    if (!*found && hasNext && (nextHash & ~1U) == target)
+        *found = OSMOS::FS::Ext4::searchBlock(file, leaf + 1, name, length, number);
+
+    return true;
+}
+
+uint32_t OSMOS::FS::Ext4::lookup(OSMOS::FS::Ext4::File *file, const char *name, uint32_t length) {
+    uint32_t number = 0;
+    bool found = false;
+
+    if (file->volume->indexed && (file->inode.flags & EXT4_INODE_INDEX) && OSMOS::FS::Ext4::searchIndex(file, name, length, &number, &found))
+        return (found ? number : 0);
+
+    // Without a usable index, every block is searched
+    uint32_t blocks = (file->size + file->volume->blockSize - 1) >> file->volume->blockShift;
+    OSMOS::FS::Ext4::prefetch(file, 0, blocks);
+
+    for (uint32_t block = 0; block < blocks; block++) {
+        if (OSMOS::FS::Ext4::searchBlock(file, block, name, length, &number))
+            return number;
+    }
+
+    return 0;
+}
+
+bool OSMOS::FS::Ext4::open(OSMOS::FS::Ext4::Volume *volume, const char *path, OSMOS::FS::Ext4::File *file) {
+    if (!OSMOS::FS::Ext4::load(volume, OSMOS::FS::Ext4::INODE_ROOT, file))
+        return false;
+
+    while (*path != '\0') {
+        while (*path == '/')
+            path++;
+
+        uint32_t length = 0;
+        while (path[length] != '\0' && path[length] != '/')
+            length++;
+
+        if (length == 0)
+            break;
+
+        if ((file->inode.mode & OSMOS::FS::Ext4::MODE_TYPE) != OSMOS::FS::Ext4::MODE_DIRECTORY)
+            return false;
+
+        uint32_t number = OSMOS::FS::Ext4::lookup(file, path, length);
+        if (number == 0 || !OSMOS::FS::Ext4::load(volume, number, file))
+            return false;
+
+        path += length;
+    }
+
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,456 @@
+/*
+ * The ext4 filesystem class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXT4_HPP
+#define EXT4_HPP
+
+#include "../osmos.hpp"
+
+#include "../io/block.hpp"
+
+namespace OSMOS {
+    namespace FS {
+        /**
+         * @brief Ext4's class that reads ext4 filesystems. The metadata is
+         * read in place from the buffer cache, file blocks are mapped through
+         * the extent trees, directories are searched through their hash tree
+         * index, and sequential reads are detected to grow the readahead
+         **/
+        class Ext4 {
+        public:
+            /**
+             * The maximum number of mounted volumes
+             **/
+            static const uint32_t VOLUME_MAXIMUM = 4;
+            /**
+             * The length of the readahead window of a file starting to be read
+             * sequentially, and its maximum length, in bytes
+             **/
+            static const uint32_t READAHEAD_MINIMUM = 16384;
+            static const uint32_t READAHEAD_MAXIMUM = 524288;
+
+            /**
+             * The inode of the root directory
+             **/
+            static uint32_t INODE_ROOT;
+
+            /**
+             * The file types of the inode mode
+             **/
+            static uint16_t MODE_TYPE;
+            static uint16_t MODE_DIRECTORY;
+            static uint16_t MODE_REGULAR;
+
+            /**
+             * The superblock, as stored 1024 bytes after the start of the
+             * volume. Only the fields used by the driver are named
+             **/
+            struct Superblock {
+                uint32_t inodesCount;
+                uint32_t blocksCountLow;
+                uint32_t reservedBlocksCountLow;
+                uint32_t freeBlocksCountLow;
+                uint32_t freeInodesCount;
+                uint32_t firstDataBlock;
+                uint32_t logBlockSize;
+                uint32_t logClusterSize;
+                uint32_t blocksPerGroup;
+                uint32_t clustersPerGroup;
+                uint32_t inodesPerGroup;
+                uint32_t mountTime;
+                uint32_t writeTime;
+                uint16_t mountCount;
+                uint16_t maximumMountCount;
+                uint16_t magic;
+                uint16_t state;
+                uint16_t errors;
+                uint16_t minorRevision;
+                uint32_t lastCheck;
+                uint32_t checkInterval;
+                uint32_t creatorSystem;
+                uint32_t revision;
+                uint16_t reservedUser;
+                uint16_t reservedGroup;
+                uint32_t firstInode;
+                uint16_t inodeSize;
+                uint16_t blockGroup;
+                uint32_t featureCompatible;
+                uint32_t featureIncompatible;
+                uint32_t featureReadOnlyCompatible;
+                uint8_t uuid[16];
+                uint8_t volumeName[16];
+                uint8_t lastMounted[64];
+                uint32_t algorithmBitmap;
+                uint8_t preallocatedBlocks;
+                uint8_t preallocatedDirectoryBlocks;
+                uint16_t reservedDescriptorBlocks;
+                uint8_t journalUUID[16];
+                uint32_t journalInode;
+                uint32_t journalDevice;
+                uint32_t lastOrphan;
+                uint32_t hashSeed[4];
+                uint8_t defaultHashVersion;
+                uint8_t journalBackupType;
+                uint16_t descriptorSize;
+                uint32_t defaultMountOptions;
+                uint32_t firstMetaGroup;
+                uint32_t creationTime;
+                uint32_t journalBlocks[17];
+                uint32_t blocksCountHigh;
+                uint32_t reservedBlocksCountHigh;
+                uint32_t freeBlocksCountHigh;
+                uint16_t minimumExtraInodeSize;
+                uint16_t wantedExtraInodeSize;
+                uint32_t flags;
+            } __attribute__((packed));
+
+            /**
+             * A group descriptor. The high halves only exist with the 64-bit
+             * feature
+             **/
+            struct GroupDescriptor {
+                uint32_t blockBitmapLow;
+                uint32_t inodeBitmapLow;
+                uint32_t inodeTableLow;
+                uint16_t freeBlocksCountLow;
+                uint16_t freeInodesCountLow;
+                uint16_t usedDirectoriesCountLow;
+                uint16_t flags;
+                uint32_t excludeBitmapLow;
+                uint16_t blockBitmapChecksumLow;
+                uint16_t inodeBitmapChecksumLow;
+                uint16_t unusedInodesLow;
+                uint16_t checksum;
+                uint32_t blockBitmapHigh;
+                uint32_t inodeBitmapHigh;
+                uint32_t inodeTableHigh;
+                uint8_t reserved[20];
+            } __attribute__((packed));
+
+            /**
+             * The first 128 bytes of an inode, common to every inode size
+             **/
+            struct Inode {
+                uint16_t mode;
+                uint16_t user;
+                uint32_t sizeLow;
+                uint32_t accessTime;
+                uint32_t changeTime;
+                uint32_t modificationTime;
+                uint32_t deletionTime;
+                uint16_t group;
+                uint16_t linksCount;
+                uint32_t blocksLow;
+                uint32_t flags;
+                uint32_t system;
+                /**
+                 * The root of the extent tree
+                 **/
+                uint32_t block[15];
+                uint32_t generation;
+                uint32_t attributesLow;
+                uint32_t sizeHigh;
+                uint32_t fragment;
+                uint8_t reserved[12];
+            } __attribute__((packed));
+
+            /**
+             * The header of an extent tree node
+             **/
+            struct ExtentHeader {
+                uint16_t magic;
+                uint16_t entries;
+                uint16_t maximum;
+                uint16_t depth;
+                uint32_t generation;
+            } __attribute__((packed));
+
+            /**
+             * An entry of an inner extent tree node, pointing to the node
+             * covering the blocks from its first logical block
+             **/
+            struct ExtentIndex {
+                uint32_t block;
+                uint32_t leafLow;
+                uint16_t leafHigh;
+                uint16_t unused;
+            } __attribute__((packed));
+
+            /**
+             * An entry of a leaf extent tree node, mapping contiguous blocks.
+             * A length above 32768 marks an uninitialized extent, read as
+             * zeros
+             **/
+            struct Extent {
+                uint32_t block;
+                uint16_t length;
+                uint16_t startHigh;
+                uint32_t startLow;
+            } __attribute__((packed));
+
+            /**
+             * The header of a directory entry, followed by its name
+             **/
+            struct DirectoryEntry {
+                uint32_t inode;
+                uint16_t recordLength;
+                uint8_t nameLength;
+                uint8_t fileType;
+            } __attribute__((packed));
+
+            /**
+             * An entry of a hash tree node. In the first entry, the hash is
+             * replaced by the limit and the count of the entries
+             **/
+            struct IndexEntry {
+                uint32_t hash;
+                uint32_t block;
+            } __attribute__((packed));
+
+            /**
+             * The information of a hash tree, which follows the "." and ".."
+             * entries of the first block of an indexed directory
+             **/
+            struct IndexRoot {
+                uint32_t reserved;
+                uint8_t hashVersion;
+                uint8_t informationLength;
+                uint8_t indirectLevels;
+                uint8_t flags;
+            } __attribute__((packed));
+
+            /**
+             * A mounted volume
+             **/
+            struct Volume {
+                OSMOS::IO::Block::Device *device;
+                /**
+                 * The position in bytes of the volume on the device
+                 **/
+                uint64_t offset;
+                uint32_t blockSize;
+                uint32_t blockShift;
+                uint32_t blockCount;
+                uint32_t groupCount;
+                uint32_t blocksPerGroup;
+                uint32_t inodesPerGroup;
+                uint32_t inodeSize;
+                uint32_t descriptorSize;
+                uint32_t firstDataBlock;
+                bool wide;
+                /**
+                 * The hash of the directory indexes: the seed, and the number
+                 * added to the hash version for the unsigned variants
+                 **/
+                uint32_t hashSeed[4];
+                uint8_t hashUnsigned;
+                bool indexed;
+            };
+
+            /**
+             * An open file, or a directory while it is searched
+             **/
+            struct File {
+                OSMOS::FS::Ext4::Volume *volume;
+                uint32_t number;
+                OSMOS::FS::Ext4::Inode inode;
+                uint64_t size;
+                uint64_t position;
+                /**
+                 * The last extent found, tried before walking the tree again.
+                 * An empty length means no extent
+                 **/
+                uint32_t extentBlock;
+                uint32_t extentLength;
+                uint64_t extentStart;
+                bool extentUninitialized;
+                /**
+                 * The readahead state: the block a sequential read continues
+                 * at, the first block not prefetched yet, and the length of
+                 * the window in blocks
+                 **/
+                uint32_t readaheadNext;
+                uint32_t readaheadEnd;
+                uint32_t readaheadWindow;
+            };
+
+        private:
+            static OSMOS::FS::Ext4::Volume VOLUMES[VOLUME_MAXIMUM];
+            static uint32_t VOLUME_COUNT;
+
+            /**
+             * @brief Copies bytes of a volume, which may cross buffers
+             * @param volume the volume to read
+             * @param offset the position of the bytes in the volume
+             * @param target the memory to copy to
+             * @param length the number of bytes
+             * @return false if the device cannot be read
+             **/
+            static bool readBytes(OSMOS::FS::Ext4::Volume *volume, uint64_t offset, uint8_t *target, uint32_t length);
+            /**
+             * @brief Gets a block of a volume in place, in the buffer cache
+             * @param volume the volume to read
+             * @param block the block to get
+             * @param buffer the buffer holding the block, to release once the
+             * block is not used anymore
+             * @return the block, or NULL if the device cannot be read
+             **/
+            static uint8_t *getBlock(OSMOS::FS::Ext4::Volume *volume, uint64_t block, OSMOS::IO::Block::Buffer **buffer);
+            /**
+             * @brief Reads an inode and prepares a file for it
+             * @param volume the volume of the inode
+             * @param number the number of the inode
+             * @param file the file to fill
+             * @return false if the inode cannot be read or is not supported
+             **/
+            static bool load(OSMOS::FS::Ext4::Volume *volume, uint32_t number, OSMOS::FS::Ext4::File *file);
+
+            /**
+             * @brief Maps a block of a file through its extent tree
+             * @param file the file
+             * @param block the logical block of the file
+             * @param count the number of blocks following the mapped one in
+             * the same extent, including it
+             * @return the physical block, or 0 for a hole or an uninitialized
+             * extent
+             **/
+            static uint64_t map(OSMOS::FS::Ext4::File *file, uint32_t block, uint32_t *count);
+            /**
+             * @brief Starts reading the blocks of a file, extent by extent
+             * @param file the file
+             * @param first the first logical block
+             * @param end the logical block to stop before
+             **/
+            static void prefetch(OSMOS::FS::Ext4::File *file, uint32_t first, uint32_t end);
+            /**
+             * @brief Updates the readahead window of a file before a read, and
+             * prefetches the blocks read and the ones ahead
+             * @param file the file
+             * @param first the first logical block read
+             * @param last the last logical block read
+             **/
+            static void readahead(OSMOS::FS::Ext4::File *file, uint32_t first, uint32_t last);
+
+            /**
+             * @brief Packs a name into the words hashed by a round, padding
+             * them with its length
+             * @param name the name
+             * @param length the remaining length of the name
+             * @param words the words to fill
+             * @param count the number of words
+             * @param signedCharacters true to sign-extend the characters, as
+             * the signed hash variants do
+             **/
+            static void pack(const char *name, uint32_t length, uint32_t *words, int32_t count, bool signedCharacters);
+            /**
+             * @brief Computes the hash of a name for the directory indexes
+             * @param volume the volume, giving the seed
+             * @param version the hash version, with its unsigned variant
+             * @param name the name
+             * @param length the length of the name
+             * @return the major hash, with its lowest bit cleared
+             **/
+            static uint32_t hash(OSMOS::FS::Ext4::Volume *volume, uint8_t version, const char *name, uint32_t length);
+            /**
+             * @brief Searches a name in a directory block
+             * @param file the directory
+             * @param block the logical block to search
+             * @param name the name
+             * @param length the length of the name
+             * @param number the inode of the entry, set if found
+             * @return true if found
+             **/
+            static bool searchBlock(OSMOS::FS::Ext4::File *file, uint32_t block, const char *name, uint32_t length, uint32_t *number);
+            /**
+             * @brief Searches a name through the hash tree of a directory
+             * @param file the directory
+             * @param name the name
+             * @param length the length of the name
+             * @param number the inode of the entry, set if found
+             * @param found set to true if the name is found
+             * @return false if the index cannot be used, so the directory
+             * must be searched block by block
+             **/
+            static bool searchIndex(OSMOS::FS::Ext4::File *file, const char *name, uint32_t length, uint32_t *number, bool *found);
+            /**
+             * @brief Searches a name in a directory
+             * @param file the directory
+             * @param name the name
+             * @param length the length of the name
+             * @return the inode of the entry, or 0 if not found
+             **/
+            static uint32_t lookup(OSMOS::FS::Ext4::File *file, const char *name, uint32_t length);
+
+        public:
+            /**
+             * @brief Mounts the ext4 filesystem of a partition
+             * @param device the device of the partition
+             * @param sector the first sector of the partition
+             * @return the volume, or NULL if the filesystem is not supported
+             **/
+            static OSMOS::FS::Ext4::Volume *mount(OSMOS::IO::Block::Device *device, uint32_t sector);
+
+            /**
+             * @brief Opens a file or a directory
+             * @param volume the volume of the file
+             * @param path the absolute path of the file
+             * @param file the file to fill
+             * @return false if the path cannot be resolved
+             **/
+            static bool open(OSMOS::FS::Ext4::Volume *volume, const char *path, OSMOS::FS::Ext4::File *file);
+            /**
+             * @brief Reads a file from its position, which is moved after the
+             * bytes read
+             * @param file the file
+             * @param target the memory to copy to
+             * @param length the number of bytes to read
+             * @return the number of bytes read, less than length at the end of
+             * the file or on an error
+             **/
+            static uint32_t read(OSMOS::FS::Ext4::File *file, uint8_t *target, uint32_t length);
+            /**
+             * @brief Reads whole pages of a file straight into frames. The
+             * pages whose blocks are contiguous and aligned on the buffers of
+             * the device skip the buffer cache; the others are copied through
+             * it, as read does. The bytes after the end of the file are not
+             * zeroed
+             * @param file the file
+             * @param index the index of the first page, in BUFFER_SIZE units
+             * of the Block class
+             * @param frames the frames to read to
+             * @param count the number of pages
+             * @return false if a page cannot be read
+             **/
+            static bool readPages(OSMOS::FS::Ext4::File *file, uint32_t index, uint8_t **frames, uint32_t count);
+            /**
+             * @brief Moves the position of a file
+             * @param file the file
+             * @param position the new position
+             **/
+            static void seek(OSMOS::FS::Ext4::File *file, uint64_t position);
+            /**
+             * @brief Gets the size of a file
+             * @param file the file
+             * @return the size in bytes
+             **/
+            static uint64_t getSize(OSMOS::FS::Ext4::File *file);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
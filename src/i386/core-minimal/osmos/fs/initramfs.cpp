@@ -0,0 +1,458 @@
+/*
+ * The initramfs class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "initramfs.hpp"
+
+#include "../sys/frame.hpp"
+#include "../sys/interrupts.hpp"
+#include "../sys/memory.hpp"
+
+const uint8_t *OSMOS::FS::Initramfs::BASE                   = NULL;
+uint32_t OSMOS::FS::Initramfs::SIZE                         = 0;
+OSMOS::FS::Initramfs::File OSMOS::FS::Initramfs::FILES[OSMOS::FS::Initramfs::FILE_MAXIMUM];
+uint32_t OSMOS::FS::Initramfs::FILE_COUNT                   = 0;
+OSMOS::FS::Initramfs::File *OSMOS::FS::Initramfs::BUCKETS[OSMOS::FS::Initramfs::BUCKET_COUNT];
+OSMOS::FS::Initramfs::Statistics OSMOS::FS::Initramfs::STATISTICS;
+OSMOS::FS::Initramfs::Copy OSMOS::FS::Initramfs::COPIES[OSMOS::FS::Initramfs::COPY_MAXIMUM];
+
+const OSMOS::System::Paging::Pager OSMOS::FS::Initramfs::PAGER = {
+    OSMOS::FS::Initramfs::getPage,
+    OSMOS::FS::Initramfs::putPage,
+    NULL
+};
+
+// The FNV-1a parameters
+#define INITRAMFS_HASH_BASIS                                2166136261U
+#define INITRAMFS_HASH_PRIME                                16777619U
+
+// The fields of a ustar header: name, size, checksum, type, magic (followed
+// by a null byte for POSIX, by two spaces for GNU) and prefix
+#define INITRAMFS_TAR_NAME                                  0
+#define INITRAMFS_TAR_NAME_SIZE                             100
+#define INITRAMFS_TAR_SIZE                                  124
+#define INITRAMFS_TAR_SIZE_SIZE                             12
+#define INITRAMFS_TAR_CHECKSUM                              148
+#define INITRAMFS_TAR_CHECKSUM_SIZE                         8
+#define INITRAMFS_TAR_TYPE                                  156
+#define INITRAMFS_TAR_MAGIC                                 257
+#define INITRAMFS_TAR_PREFIX                                345
+#define INITRAMFS_TAR_PREFIX_SIZE                           155
+
+// The types of the ustar regular files, the old one being a null byte
+#define INITRAMFS_TAR_TYPE_REGULAR                          '0'
+#define INITRAMFS_TAR_TYPE_REGULAR_OLD                      '\0'
+
+// The size of a newc header, the position of its fields (8 hexadecimal
+// digits each), and the alignment of the names and data
+#define INITRAMFS_CPIO_HEADER_SIZE                          110
+#define INITRAMFS_CPIO_MODE                                 14
+#define INITRAMFS_CPIO_FILE_SIZE                            54
+#define INITRAMFS_CPIO_NAME_SIZE                            94
+#define INITRAMFS_CPIO_FIELD_SIZE                           8
+#define INITRAMFS_CPIO_ALIGNMENT                            4
+
+// The file type of the cpio mode, and the type of the regular files
+#define INITRAMFS_CPIO_MODE_TYPE                            0170000
+#define INITRAMFS_CPIO_MODE_REGULAR                         0100000
+
+// Compares bytes
+static bool initramfsEquals(const char *first, const char *second, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        if (first[i] != second[i])
+            return false;
+    }
+
+    return true;
+}
+
+// Gets the length of a null-terminated field
+static uint32_t initramfsLength(const char *field, uint32_t size) {
+    uint32_t length = 0;
+
+    while (length < size && field[length] != '\0')
+        length++;
+
+    return length;
+}
+
+// Removes the leading "/" and "./" of a path, which archivers often write
+static void initramfsStrip(const char **path, uint32_t *length) {
+    for (;;) {
+        if (*length >= 1 && (*path)[0] == '/') {
+            (*path)++;
+            (*length)--;
+        } else if (*length >= 2 && (*path)[0] == '.' && (*path)[1] == '/') {
+            *path += 2;
+            *length -= 2;
+        } else {
+            return;
+        }
+    }
+}
+
+bool OSMOS::FS::Initramfs::initialize(address_t start, address_t end) {
+    OSMOS::FS::Initramfs::BASE = NULL;
+    OSMOS::FS::Initramfs::SIZE = 0;
+    OSMOS::FS::Initramfs::FILE_COUNT = 0;
+
+    for (uint32_t i = 0; i < OSMOS::FS::Initramfs::BUCKET_COUNT; i++)
+        OSMOS::FS::Initramfs::BUCKETS[i] = NULL;
+
+    OSMOS::FS::Initramfs::STATISTICS.lookups = 0;
+    OSMOS::FS::Initramfs::STATISTICS.hits = 0;
+    OSMOS::FS::Initramfs::STATISTICS.comparisons = 0;
+    OSMOS::FS::Initramfs::STATISTICS.skipped = 0;
+    OSMOS::FS::Initramfs::STATISTICS.lent = 0;
+    OSMOS::FS::Initramfs::STATISTICS.copied = 0;
+
+    for (uint32_t i = 0; i < OSMOS::FS::Initramfs::COPY_MAXIMUM; i++)
+        OSMOS::FS::Initramfs::COPIES[i].file = NULL;
+
+    // The user area is not mapped in the kernel space
+    if (start == NULL || end <= start || end > OSMOS::System::Paging::USER_BASE)
+        return false;
+
+    OSMOS::FS::Initramfs::BASE = (const uint8_t *) start;
+    OSMOS::FS::Initramfs::SIZE = end - start;
+
+    if (OSMOS::FS::Initramfs::indexTar() || OSMOS::FS::Initramfs::indexCpio())
+        return true;
+
+    OSMOS::FS::Initramfs::BASE = NULL;
+    OSMOS::FS::Initramfs::SIZE = 0;
+    return false;
+}
+
+bool OSMOS::FS::Initramfs::isReady() {
+    return OSMOS::FS::Initramfs::BASE != NULL;
+}
+
+uint32_t OSMOS::FS::Initramfs::hash(uint32_t hash, const char *string, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++)
+        hash = (hash ^ (uint8_t) string[i]) * INITRAMFS_HASH_PRIME;
+
+    return hash;
+}
+
+uint32_t OSMOS::FS::Initramfs::parseNumber(const char *field, uint32_t length, uint32_t base, bool *valid) {
+    uint32_t number = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        char character = field[i];
+        uint32_t digit;
+
+        if (character >= '0' && character <= '9')
+            digit = character - '0';
+        else if (character >= 'A' && character <= 'F')
+            digit = character - 'A' + 10;
+        else if (character >= 'a' && character <= 'f')
+            digit = character - 'a' + 10;
+        else if (character == ' ' || character == '\0')
+            continue;
+        else
+            digit = base;
+
+        if (digit >= base) {
+            *valid = false;
+            return 0;
+        }
+
+        number = number * base + digit;
+    }
+
+    return number;
+}
+
+void OSMOS::FS::Initramfs::add(const char *prefix, uint32_t prefixLength, const char *name, uint32_t nameLength, uint32_t offset, uint32_t length) {
+    initramfsStrip(&prefix, &prefixLength);
+    if (prefixLength == 0)
+        initramfsStrip(&name, &nameLength);
+
+    if (nameLength == 0)
+        return;
+
+    if (OSMOS::FS::Initramfs::FILE_COUNT == OSMOS::FS::Initramfs::FILE_MAXIMUM) {
+        OSMOS::FS::Initramfs::STATISTICS.skipped++;
+        return;
+    }
+
+    uint32_t hash = INITRAMFS_HASH_BASIS;
+    if (prefixLength > 0) {
+        hash = OSMOS::FS::Initramfs::hash(hash, prefix, prefixLength);
+        hash = OSMOS::FS::Initramfs::hash(hash, "/", 1);
+    }
+    hash = OSMOS::FS::Initramfs::hash(hash, name, nameLength);
+
+    OSMOS::FS::Initramfs::File *file = &OSMOS::FS::Initramfs::FILES[OSMOS::FS::Initramfs::FILE_COUNT++];
+    file->hash = hash;
+    file->prefix = prefix;
+    file->prefixLength = prefixLength;
+    file->name = name;
+    file->nameLength = nameLength;
+    file->offset = offset;
+    file->length = length;
+
+    OSMOS::FS::Initramfs::File **bucket = &OSMOS::FS::Initramfs::BUCKETS[hash & (OSMOS::FS::Initramfs::BUCKET_COUNT - 1)];
+    file->next = *bucket;
+    *bucket = file;
+}
+
+bool OSMOS::FS::Initramfs::indexTar() {
+    uint32_t offset = 0;
+
+    while (offset + OSMOS::FS::Initramfs::TAR_BLOCK_SIZE <= OSMOS::FS::Initramfs::SIZE) {
+        const char *header = (const char *) OSMOS::FS::Initramfs::BASE + offset;
+
+        // The archive ends with null blocks
+        if (header[INITRAMFS_TAR_NAME] == '\0')
+            break;
+
+        if (!initramfsEquals(&header[INITRAMFS_TAR_MAGIC], "ustar", 5))
+            break;
+
+        // The checksum is computed with its own field made of spaces
+        bool valid = true;
+        uint32_t checksum = OSMOS::FS::Initramfs::parseNumber(&header[INITRAMFS_TAR_CHECKSUM], INITRAMFS_TAR_CHECKSUM_SIZE, 8, &valid);
+        uint32_t sum = ' ' * INITRAMFS_TAR_CHECKSUM_SIZE;
+
+        for (uint32_t i = 0; i < OSMOS::FS::Initramfs::TAR_BLOCK_SIZE; i++) {
+            if (i < INITRAMFS_TAR_CHECKSUM || i >= INITRAMFS_TAR_CHECKSUM + INITRAMFS_TAR_CHECKSUM_SIZE)
+                sum += (uint8_t) header[i];
+        }
+
+        uint32_t size = OSMOS::FS::Initramfs::parseNumber(&header[INITRAMFS_TAR_SIZE], INITRAMFS_TAR_SIZE_SIZE, 8, &valid);
+        uint32_t data = offset + OSMOS::FS::Initramfs::TAR_BLOCK_SIZE;
+
+        if (!valid || sum != checksum || size > OSMOS::FS::Initramfs::SIZE - data)
+            break;
+
+        if (header[INITRAMFS_TAR_TYPE] == INITRAMFS_TAR_TYPE_REGULAR || header[INITRAMFS_TAR_TYPE] == INITRAMFS_TAR_TYPE_REGULAR_OLD) {
+            // Only POSIX archives have a prefix, GNU ones use its field for
+            // other purposes
+            const char *prefix = &header[INITRAMFS_TAR_PREFIX];
+            uint32_t prefixLength = (header[INITRAMFS_TAR_MAGIC + 5] == '\0' ? initramfsLength(prefix, INITRAMFS_TAR_PREFIX_SIZE) : 0);
+
+            OSMOS::FS::Initramfs::add(prefix, prefixLength, &header[INITRAMFS_TAR_NAME], initramfsLength(&header[INITRAMFS_TAR_NAME], INITRAMFS_TAR_NAME_SIZE), data, size);
+        }
+
+        offset = data + ((size + OSMOS::FS::Initramfs::TAR_BLOCK_SIZE - 1) & ~(OSMOS::FS::Initramfs::TAR_BLOCK_SIZE - 1));
+    }
+
+    // A truncated archive keeps the files indexed before the damage
+    return offset > 0;
+}
+
+bool OSMOS::FS::Initramfs::indexCpio() {
+    uint32_t offset = 0;
+
+    while (offset + INITRAMFS_CPIO_HEADER_SIZE <= OSMOS::FS::Initramfs::SIZE) {
+        const char *header = (const char *) OSMOS::FS::Initramfs::BASE + offset;
+
+        // The "070702" variant only adds a checksum of the data
+        if (!initramfsEquals(header, "07070", 5) || (header[5] != '1' && header[5] != '2'))
+            break;
+
+        bool valid = true;
+        uint32_t mode = OSMOS::FS::Initramfs::parseNumber(&header[INITRAMFS_CPIO_MODE], INITRAMFS_CPIO_FIELD_SIZE, 16, &valid);
+        uint32_t size = OSMOS::FS::Initramfs::parseNumber(&header[INITRAMFS_CPIO_FILE_SIZE], INITRAMFS_CPIO_FIELD_SIZE, 16, &valid);
+        uint32_t nameSize = OSMOS::FS::Initramfs::parseNumber(&header[INITRAMFS_CPIO_NAME_SIZE], INITRAMFS_CPIO_FIELD_SIZE, 16, &valid);
+        uint32_t name = offset + INITRAMFS_CPIO_HEADER_SIZE;
+
+        // The name includes its null byte
+        if (!valid || nameSize == 0 || nameSize > OSMOS::FS::Initramfs::SIZE - name)
+            break;
+
+        const char *path = (const char *) OSMOS::FS::Initramfs::BASE + name;
+        if (nameSize == 11 && initramfsEquals(path, "TRAILER!!!", 11))
+            break;
+
+        uint32_t data = (name + nameSize + INITRAMFS_CPIO_ALIGNMENT - 1) & ~(INITRAMFS_CPIO_ALIGNMENT - 1);
+        if (data > OSMOS::FS::Initramfs::SIZE || size > OSMOS::FS::Initramfs::SIZE - data)
+            break;
+
+        if ((mode & INITRAMFS_CPIO_MODE_TYPE) == INITRAMFS_CPIO_MODE_REGULAR)
+            OSMOS::FS::Initramfs::add(NULL, 0, path, nameSize - 1, data, size);
+
+        offset = (data + size + INITRAMFS_CPIO_ALIGNMENT - 1) & ~(INITRAMFS_CPIO_ALIGNMENT - 1);
+    }
+
+    return offset > 0;
+}
+
+OSMOS::FS::Initramfs::File *OSMOS::FS::Initramfs::find(const char *path) {
+    if (OSMOS::FS::Initramfs::BASE == NULL)
+        return NULL;
+
+    uint32_t length = 0;
+    while (path[length] != '\0')
+        length++;
+
+    initramfsStrip(&path, &length);
+    uint32_t hash = OSMOS::FS::Initramfs::hash(INITRAMFS_HASH_BASIS, path, length);
+
+    OSMOS::FS::Initramfs::STATISTICS.lookups++;
+
+    for (OSMOS::FS::Initramfs::File *file = OSMOS::FS::Initramfs::BUCKETS[hash & (OSMOS::FS::Initramfs::BUCKET_COUNT - 1)]; file != NULL; file = file->next) {
+        if (file->hash != hash)
+            continue;
+
+        OSMOS::FS::Initramfs::STATISTICS.comparisons++;
+
+        if (file->prefixLength > 0) {
+            if (length != file->prefixLength + 1 + file->nameLength || path[file->prefixLength] != '/')
+                continue;
+            if (!initramfsEquals(path, file->prefix, file->prefixLength) || !initramfsEquals(path + file->prefixLength + 1, file->name, file->nameLength))
+                continue;
+        } else if (length != file->nameLength || !initramfsEquals(path, file->name, length)) {
+            continue;
+        }
+
+        OSMOS::FS::Initramfs::STATISTICS.hits++;
+        return file;
+    }
+
+    return NULL;
+}
+
+const uint8_t *OSMOS::FS::Initramfs::getData(OSMOS::FS::Initramfs::File *file) {
+    return OSMOS::FS::Initramfs::BASE + file->offset;
+}
+
+uint32_t OSMOS::FS::Initramfs::getSize(OSMOS::FS::Initramfs::File *file) {
+    return file->length;
+}
+
+uint32_t OSMOS::FS::Initramfs::read(OSMOS::FS::Initramfs::File *file, uint32_t offset, uint8_t *target, uint32_t length) {
+    if (offset >= file->length)
+        return 0;
+
+    if (file->length - offset < length)
+        length = file->length - offset;
+
+    OSMOS::System::Memory::copy(target, (uint8_t *) OSMOS::FS::Initramfs::BASE + file->offset + offset, length);
+    return length;
+}
+
+bool OSMOS::FS::Initramfs::mapFile(OSMOS::System::Paging::Space *space, address_t address, uint32_t length, OSMOS::FS::Initramfs::File *file, uint32_t offset, uint32_t dataLength, uint8_t flags) {
+    if (offset >= file->length)
+        dataLength = 0;
+    else if (file->length - offset < dataLength)
+        dataLength = file->length - offset;
+
+    return OSMOS::System::Paging::addMapping(space, address, length, flags, &OSMOS::FS::Initramfs::PAGER, file, offset, dataLength);
+}
+
+address_t OSMOS::FS::Initramfs::getPage(void *object, uint32_t index) {
+    OSMOS::FS::Initramfs::File *file = (OSMOS::FS::Initramfs::File *) object;
+    uint32_t offset = index * OSMOS::System::Paging::PAGE_SIZE;
+
+    if (offset >= file->length)
+        return NULL;
+
+    // The module starts on a page, so does the data of a file stored at the
+    // right place of the archive: its pages are lent as they are
+    address_t address = (address_t) OSMOS::FS::Initramfs::BASE + file->offset + offset;
+    if (address % OSMOS::System::Paging::PAGE_SIZE == 0) {
+        OSMOS::FS::Initramfs::STATISTICS.lent++;
+        return address;
+    }
+
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    // Otherwise the page is copied once, and the copy is shared by the
+    // mappings until the last one puts it back
+    OSMOS::FS::Initramfs::Copy *copy = NULL;
+    OSMOS::FS::Initramfs::Copy *unused = NULL;
+
+    for (uint32_t i = 0; copy == NULL && i < OSMOS::FS::Initramfs::COPY_MAXIMUM; i++) {
+        OSMOS::FS::Initramfs::Copy *candidate = &OSMOS::FS::Initramfs::COPIES[i];
+
+        if (candidate->file == file && candidate->index == index)
+            copy = candidate;
+        else if (candidate->file == NULL && unused == NULL)
+            unused = candidate;
+    }
+
+    if (copy == NULL && unused != NULL) {
+        uint8_t *frame = (uint8_t *) OSMOS::System::Frame::allocate();
+
+        if (frame != NULL) {
+            uint32_t length = file->length - offset;
+            if (length > OSMOS::System::Paging::PAGE_SIZE)
+                length = OSMOS::System::Paging::PAGE_SIZE;
+
+            OSMOS::System::Memory::copy(frame, (uint8_t *) address, length);
+            if (length < OSMOS::System::Paging::PAGE_SIZE)
+                OSMOS::System::Memory::fill(frame + length, OSMOS::System::Paging::PAGE_SIZE - length, (uint8_t) 0);
+
+            unused->file = file;
+            unused->index = index;
+            unused->frame = frame;
+            unused->references = 0;
+
+            copy = unused;
+            OSMOS::FS::Initramfs::STATISTICS.copied++;
+        }
+    }
+
+    if (copy != NULL)
+        copy->references++;
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return (copy != NULL ? (address_t) copy->frame : NULL);
+}
+
+void OSMOS::FS::Initramfs::putPage(void *object, uint32_t index) {
+    OSMOS::FS::Initramfs::File *file = (OSMOS::FS::Initramfs::File *) object;
+
+    address_t address = (address_t) OSMOS::FS::Initramfs::BASE + file->offset + index * OSMOS::System::Paging::PAGE_SIZE;
+    if (address % OSMOS::System::Paging::PAGE_SIZE == 0)
+        return;
+
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    for (uint32_t i = 0; i < OSMOS::FS::Initramfs::COPY_MAXIMUM; i++) {
+        OSMOS::FS::Initramfs::Copy *copy = &OSMOS::FS::Initramfs::COPIES[i];
+
+        if (copy->file != file || copy->index != index)
+            continue;
+
+        copy->references--;
+        if (copy->references == 0) {
+            OSMOS::System::Frame::free((address_t) copy->frame);
+            copy->file = NULL;
+        }
+
+        break;
+    }
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+}
+
+uint32_t OSMOS::FS::Initramfs::getFileCount() {
+    return OSMOS::FS::Initramfs::FILE_COUNT;
+}
+
+OSMOS::FS::Initramfs::Statistics *OSMOS::FS::Initramfs::getStatistics() {
+    return &OSMOS::FS::Initramfs::STATISTICS;
+}
\ No newline at end of file
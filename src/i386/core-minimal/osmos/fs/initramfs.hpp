@@ -0,0 +1,258 @@
+/*
+ * The initramfs class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INITRAMFS_HPP
+#define INITRAMFS_HPP
+
+#include "../osmos.hpp"
+
+#include "../sys/paging.hpp"
+
+namespace OSMOS {
+    namespace FS {
+        /**
+         * @brief Initramfs' class that serves the files of an uncompressed
+         * archive loaded as a boot module, ustar or cpio (newc). The archive
+         * is indexed in place by a hash table of the paths, and the files are
+         * read straight from the memory of the module, without any copy or
+         * disk driver. The mappings of the files borrow the pages of the
+         * module
+         **/
+        class Initramfs {
+        public:
+            /**
+             * The maximum number of indexed files, and the number of buckets
+             * of the hash table, a power of 2
+             **/
+            static const uint32_t FILE_MAXIMUM = 512;
+            static const uint32_t BUCKET_COUNT = 1024;
+            /**
+             * The size in bytes of a ustar block, the unit of its headers and
+             * data
+             **/
+            static const uint32_t TAR_BLOCK_SIZE = 512;
+            /**
+             * The maximum number of pages copied out of the files whose data
+             * does not start on a page, shared by the mappings
+             **/
+            static const uint32_t COPY_MAXIMUM = 64;
+
+            /**
+             * An indexed file. Its path and data stay in the archive
+             **/
+            struct File {
+                uint32_t hash;
+                /**
+                 * The path, without its leading "/" or "./": the prefix field
+                 * of a ustar header followed by "/" and the name, or the name
+                 * alone if there is no prefix. Neither is null-terminated
+                 **/
+                const char *prefix;
+                uint32_t prefixLength;
+                const char *name;
+                uint32_t nameLength;
+                /**
+                 * The position of the data in the archive, and its length
+                 **/
+                uint32_t offset;
+                uint32_t length;
+                /**
+                 * The next file of the bucket. The later files of the archive
+                 * come first, so they replace the earlier ones
+                 **/
+                OSMOS::FS::Initramfs::File *next;
+            };
+
+            /**
+             * A page of a file copied to a frame, because it straddles two
+             * pages of the module
+             **/
+            struct Copy {
+                /**
+                 * The file of the page, or NULL if the copy is free
+                 **/
+                OSMOS::FS::Initramfs::File *file;
+                uint32_t index;
+                uint8_t *frame;
+                /**
+                 * The number of mappings using the copy, which is freed by the
+                 * last one
+                 **/
+                uint32_t references;
+            };
+
+            /**
+             * The counters of the index
+             **/
+            struct Statistics {
+                uint32_t lookups;
+                uint32_t hits;
+                /**
+                 * The paths compared by the lookups, one per hit when the
+                 * buckets are short
+                 **/
+                uint32_t comparisons;
+                /**
+                 * The regular files left out because the index was full
+                 **/
+                uint32_t skipped;
+                /**
+                 * The pages lent to the mappings in place, and the ones copied
+                 * first
+                 **/
+                uint32_t lent;
+                uint32_t copied;
+            };
+
+        private:
+            static const uint8_t *BASE;
+            static uint32_t SIZE;
+            static OSMOS::FS::Initramfs::File FILES[FILE_MAXIMUM];
+            static uint32_t FILE_COUNT;
+            static OSMOS::FS::Initramfs::File *BUCKETS[BUCKET_COUNT];
+            static OSMOS::FS::Initramfs::Statistics STATISTICS;
+            static OSMOS::FS::Initramfs::Copy COPIES[COPY_MAXIMUM];
+            /**
+             * The pager lending the pages to the mappings of mapFile
+             **/
+            static const OSMOS::System::Paging::Pager PAGER;
+
+            /**
+             * @brief Hashes a part of a path (FNV-1a)
+             * @param hash the hash of the previous parts
+             * @param string the part
+             * @param length the length of the part
+             * @return the hash including the part
+             **/
+            static uint32_t hash(uint32_t hash, const char *string, uint32_t length);
+            /**
+             * @brief Parses a number of a header, written in ASCII digits
+             * @param field the field of the header
+             * @param length the length of the field
+             * @param base 8 for ustar, 16 for cpio
+             * @param valid set to false if the field has another character
+             * than a digit, a space or a null byte
+             * @return the number
+             **/
+            static uint32_t parseNumber(const char *field, uint32_t length, uint32_t base, bool *valid);
+            /**
+             * @brief Adds a regular file to the index
+             * @param prefix the prefix of the path, or NULL
+             * @param prefixLength the length of the prefix
+             * @param name the name, or the rest of the path
+             * @param nameLength the length of the name
+             * @param offset the position of the data in the archive
+             * @param length the length of the data
+             **/
+            static void add(const char *prefix, uint32_t prefixLength, const char *name, uint32_t nameLength, uint32_t offset, uint32_t length);
+            /**
+             * @brief Indexes the archive as ustar
+             * @return false if the archive does not start with a ustar header
+             **/
+            static bool indexTar();
+            /**
+             * @brief Indexes the archive as cpio, in the newc format
+             * @return false if the archive does not start with a newc header
+             **/
+            static bool indexCpio();
+
+            /**
+             * @brief The pager functions of the mappings, which take and give
+             * back pages of a file. The files are never released
+             **/
+            static address_t getPage(void *object, uint32_t index);
+            static void putPage(void *object, uint32_t index);
+
+        public:
+            /**
+             * @brief Indexes an archive loaded in memory. The memory must stay
+             * reserved while the files are used
+             * @param start the first address of the archive
+             * @param end the end address of the archive
+             * @return false if the memory is in the user area, or if it is not
+             * a ustar or newc archive
+             **/
+            static bool initialize(address_t start, address_t end);
+            /**
+             * @brief Checks if an archive is indexed
+             * @return true if an archive is indexed
+             **/
+            static bool isReady();
+
+            /**
+             * @brief Finds a file by its path
+             * @param path the path, absolute or relative to the root of the
+             * archive
+             * @return the file, or NULL if it is not in the archive
+             **/
+            static OSMOS::FS::Initramfs::File *find(const char *path);
+            /**
+             * @brief Gets the data of a file, in the memory of the module
+             * @param file the file
+             * @return the first byte of the data, read-only
+             **/
+            static const uint8_t *getData(OSMOS::FS::Initramfs::File *file);
+            /**
+             * @brief Gets the size of a file
+             * @param file the file
+             * @return the size in bytes
+             **/
+            static uint32_t getSize(OSMOS::FS::Initramfs::File *file);
+            /**
+             * @brief Copies bytes of a file
+             * @param file the file
+             * @param offset the position of the bytes in the file
+             * @param target the memory to copy to
+             * @param length the number of bytes to copy
+             * @return the number of bytes copied, less than length at the end
+             * of the file
+             **/
+            static uint32_t read(OSMOS::FS::Initramfs::File *file, uint32_t offset, uint8_t *target, uint32_t length);
+            /**
+             * @brief Maps a part of a file in an address space. The pages are
+             * lent in place when first touched, read-only, if the data of the
+             * file starts on a page, and copied otherwise. A private writable
+             * mapping copies them on their first write
+             * @param space the address space
+             * @param address the first address, aligned on PAGE_SIZE
+             * @param length the length of the mapping in bytes
+             * @param file the file
+             * @param offset the position of the mapping in the file, aligned
+             * on PAGE_SIZE
+             * @param dataLength the number of bytes of the file mapped, the
+             * rest of the mapping being zeroed
+             * @param flags the MAPPING_* flags of the Paging class
+             * @return false if the mapping could not be added
+             **/
+            static bool mapFile(OSMOS::System::Paging::Space *space, address_t address, uint32_t length, OSMOS::FS::Initramfs::File *file, uint32_t offset, uint32_t dataLength, uint8_t flags);
+
+            /**
+             * @brief Gets the number of indexed files
+             * @return the number of files
+             **/
+            static uint32_t getFileCount();
+            /**
+             * @brief Gets the counters of the index
+             * @return the counters
+             **/
+            static OSMOS::FS::Initramfs::Statistics *getStatistics();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
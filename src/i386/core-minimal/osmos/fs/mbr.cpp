@@ -0,0 +1,69 @@
+/*
+ * The MBR partition table class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mbr.hpp"
+
+uint8_t OSMOS::FS::MBR::TYPE_EMPTY                          = 0x00;
+uint8_t OSMOS::FS::MBR::TYPE_LINUX                          = 0x83;
+
+// The offset of the partition table in the boot record, and the size of an
+// entry
+#define MBR_TABLE_OFFSET                                    446
+#define MBR_ENTRY_SIZE                                      16
+
+bool OSMOS::FS::MBR::read(OSMOS::IO::Block::Device *device, OSMOS::FS::MBR::Partition *partitions) {
+    // The boot record lies in the first buffer, which the filesystems will
+    // read again: it stays in the cache
+    OSMOS::IO::Block::Buffer *buffer = OSMOS::IO::Block::read(device, 0);
+    if (buffer == NULL)
+        return false;
+
+    uint8_t *record = buffer->data;
+    if (record[510] != 0x55 || record[511] != 0xAA) {
+        OSMOS::IO::Block::release(buffer);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < OSMOS::FS::MBR::PARTITION_COUNT; i++) {
+        uint8_t *entry = &record[MBR_TABLE_OFFSET + i * MBR_ENTRY_SIZE];
+
+        partitions[i].bootable = (entry[0] & 0x80) != 0;
+        partitions[i].type = entry[4];
+        partitions[i].start = entry[8] | (entry[9] << 8) | (entry[10] << 16) | ((uint32_t) entry[11] << 24);
+        partitions[i].count = entry[12] | (entry[13] << 8) | (entry[14] << 16) | ((uint32_t) entry[15] << 24);
+    }
+
+    OSMOS::IO::Block::release(buffer);
+    return true;
+}
+
+bool OSMOS::FS::MBR::find(OSMOS::IO::Block::Device *device, uint8_t type, OSMOS::FS::MBR::Partition *partition) {
+    OSMOS::FS::MBR::Partition partitions[OSMOS::FS::MBR::PARTITION_COUNT];
+
+    if (!OSMOS::FS::MBR::read(device, partitions))
+        return false;
+
+    for (uint32_t i = 0; i < OSMOS::FS::MBR::PARTITION_COUNT; i++) {
+        if (partitions[i].type == type && partitions[i].count > 0) {
+            *partition = partitions[i];
+            return true;
+        }
+    }
+
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+/*
+ * The MBR partition table class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MBR_HPP
+#define MBR_HPP
+
+#include "../osmos.hpp"
+
+#include "../io/block.hpp"
+
+namespace OSMOS {
+    namespace FS {
+        /**
+         * @brief MBR's class that reads the primary partitions of the master
+         * boot record of a block device
+         **/
+        class MBR {
+        public:
+            /**
+             * The number of primary partitions
+             **/
+            static const uint32_t PARTITION_COUNT = 4;
+
+            /**
+             * The <i>empty</i> type marks an unused entry
+             **/
+            static uint8_t TYPE_EMPTY;
+            /**
+             * The <i>Linux</i> type marks a native Linux filesystem, such as
+             * ext4
+             **/
+            static uint8_t TYPE_LINUX;
+
+            /**
+             * A primary partition
+             **/
+            struct Partition {
+                bool bootable;
+                uint8_t type;
+                /**
+                 * The first sector of the partition, and its number of sectors
+                 **/
+                uint32_t start;
+                uint32_t count;
+            };
+
+            /**
+             * @brief Reads the partition table of a device
+             * @param device the device to read
+             * @param partitions the PARTITION_COUNT entries to fill
+             * @return false if the device has no valid boot record
+             **/
+            static bool read(OSMOS::IO::Block::Device *device, OSMOS::FS::MBR::Partition *partitions);
+            /**
+             * @brief Finds the first partition of a type
+             * @param device the device to read
+             * @param type the type to find
+             * @param partition the partition to fill
+             * @return false if there is no such partition
+             **/
+            static bool find(OSMOS::IO::Block::Device *device, uint8_t type, OSMOS::FS::MBR::Partition *partition);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
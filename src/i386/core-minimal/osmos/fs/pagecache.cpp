@@ -0,0 +1,558 @@
+/*
+ * The page cache class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pagecache.hpp"
+
+#include "../sys/frame.hpp"
+#include "../sys/interrupts.hpp"
+#include "../sys/memory.hpp"
+
+uint8_t OSMOS::FS::PageCache::PAGE_VALID                    = 0x01;
+uint8_t OSMOS::FS::PageCache::PAGE_LOCKED                   = 0x02;
+uint8_t OSMOS::FS::PageCache::PAGE_REFERENCED               = 0x04;
+
+OSMOS::FS::PageCache::Object OSMOS::FS::PageCache::OBJECTS[OSMOS::FS::PageCache::OBJECT_MAXIMUM];
+OSMOS::FS::PageCache::Page OSMOS::FS::PageCache::PAGES[OSMOS::FS::PageCache::PAGE_MAXIMUM];
+OSMOS::FS::PageCache::Page *OSMOS::FS::PageCache::FREE_PAGES = NULL;
+OSMOS::FS::PageCache::Node OSMOS::FS::PageCache::NODES[OSMOS::FS::PageCache::NODE_MAXIMUM];
+OSMOS::FS::PageCache::Node *OSMOS::FS::PageCache::FREE_NODES = NULL;
+uint32_t OSMOS::FS::PageCache::FREE_NODE_COUNT              = 0;
+uint32_t OSMOS::FS::PageCache::CLOCK_HAND                   = 0;
+OSMOS::FS::PageCache::Statistics OSMOS::FS::PageCache::STATISTICS;
+void *OSMOS::FS::PageCache::WAITING[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+OSMOS::System::Scheduler::Thread *OSMOS::FS::PageCache::WAITERS[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+
+const OSMOS::System::Paging::Pager OSMOS::FS::PageCache::PAGER = {
+    OSMOS::FS::PageCache::getPage,
+    OSMOS::FS::PageCache::putPage,
+    OSMOS::FS::PageCache::releaseObject
+};
+
+void OSMOS::FS::PageCache::initialize() {
+    for (uint32_t i = 0; i < OSMOS::FS::PageCache::OBJECT_MAXIMUM; i++)
+        OSMOS::FS::PageCache::OBJECTS[i].used = false;
+
+    // The free nodes are linked through their first slot
+    OSMOS::FS::PageCache::FREE_NODES = NULL;
+    OSMOS::FS::PageCache::FREE_NODE_COUNT = 0;
+    for (uint32_t i = OSMOS::FS::PageCache::NODE_MAXIMUM; i > 0; i--)
+        OSMOS::FS::PageCache::freeNode(&OSMOS::FS::PageCache::NODES[i - 1]);
+
+    OSMOS::FS::PageCache::FREE_PAGES = NULL;
+    for (uint32_t i = OSMOS::FS::PageCache::PAGE_MAXIMUM; i > 0; i--) {
+        OSMOS::FS::PageCache::Page *page = &OSMOS::FS::PageCache::PAGES[i - 1];
+
+        page->data = NULL;
+        page->object = NULL;
+        page->next = OSMOS::FS::PageCache::FREE_PAGES;
+        OSMOS::FS::PageCache::FREE_PAGES = page;
+    }
+
+    OSMOS::FS::PageCache::CLOCK_HAND = 0;
+    OSMOS::FS::PageCache::STATISTICS.lookups = 0;
+    OSMOS::FS::PageCache::STATISTICS.hits = 0;
+    OSMOS::FS::PageCache::STATISTICS.misses = 0;
+    OSMOS::FS::PageCache::STATISTICS.evictions = 0;
+
+    OSMOS::System::Frame::addReclaimer(OSMOS::FS::PageCache::reclaim);
+}
+
+OSMOS::FS::PageCache::Node *OSMOS::FS::PageCache::allocateNode() {
+    OSMOS::FS::PageCache::Node *node = OSMOS::FS::PageCache::FREE_NODES;
+    if (node == NULL)
+        return NULL;
+
+    OSMOS::FS::PageCache::FREE_NODES = (OSMOS::FS::PageCache::Node *) node->slots[0];
+    OSMOS::FS::PageCache::FREE_NODE_COUNT--;
+
+    for (uint32_t i = 0; i < OSMOS::FS::PageCache::NODE_SIZE; i++)
+        node->slots[i] = NULL;
+    node->count = 0;
+
+    return node;
+}
+
+void OSMOS::FS::PageCache::freeNode(OSMOS::FS::PageCache::Node *node) {
+    node->slots[0] = OSMOS::FS::PageCache::FREE_NODES;
+    OSMOS::FS::PageCache::FREE_NODES = node;
+    OSMOS::FS::PageCache::FREE_NODE_COUNT++;
+}
+
+OSMOS::FS::PageCache::Page *OSMOS::FS::PageCache::find(OSMOS::FS::PageCache::Object *object, uint32_t index) {
+    if (object->root == NULL)
+        return NULL;
+
+    if (object->height < OSMOS::FS::PageCache::HEIGHT_MAXIMUM && (index >> (OSMOS::FS::PageCache::NODE_SHIFT * object->height)) != 0)
+        return NULL;
+
+    OSMOS::FS::PageCache::Node *node = object->root;
+    for (uint32_t level = object->height - 1; level > 0; level--) {
+        node = (OSMOS::FS::PageCache::Node *) node->slots[(index >> (OSMOS::FS::PageCache::NODE_SHIFT * level)) % OSMOS::FS::PageCache::NODE_SIZE];
+        if (node == NULL)
+            return NULL;
+    }
+
+    return (OSMOS::FS::PageCache::Page *) node->slots[index % OSMOS::FS::PageCache::NODE_SIZE];
+}
+
+bool OSMOS::FS::PageCache::insert(OSMOS::FS::PageCache::Page *page) {
+    OSMOS::FS::PageCache::Object *object = page->object;
+    uint32_t index = page->index;
+
+    // The nodes are counted first, so an insertion never fails halfway and
+    // leaves empty nodes: growing then walking down takes at most two nodes
+    // per level
+    if (OSMOS::FS::PageCache::FREE_NODE_COUNT < 2 * OSMOS::FS::PageCache::HEIGHT_MAXIMUM)
+        OSMOS::FS::PageCache::reclaim(OSMOS::FS::PageCache::NODE_SIZE);
+    if (OSMOS::FS::PageCache::FREE_NODE_COUNT < 2 * OSMOS::FS::PageCache::HEIGHT_MAXIMUM)
+        return false;
+
+    // An empty tree starts at the height covering the index
+    if (object->root == NULL) {
+        object->root = OSMOS::FS::PageCache::allocateNode();
+        if (object->root == NULL)
+            return false;
+
+        object->height = 1;
+        while (object->height < OSMOS::FS::PageCache::HEIGHT_MAXIMUM && (index >> (OSMOS::FS::PageCache::NODE_SHIFT * object->height)) != 0)
+            object->height++;
+    }
+
+    // Otherwise it grows from the top until it covers the index, the old root
+    // becoming the first slot of the new one
+    while (object->height < OSMOS::FS::PageCache::HEIGHT_MAXIMUM && (index >> (OSMOS::FS::PageCache::NODE_SHIFT * object->height)) != 0) {
+        OSMOS::FS::PageCache::Node *root = OSMOS::FS::PageCache::allocateNode();
+        if (root == NULL)
+            return false;
+
+        root->slots[0] = object->root;
+        root->count = 1;
+
+        object->root = root;
+        object->height++;
+    }
+
+    OSMOS::FS::PageCache::Node *node = object->root;
+    for (uint32_t level = object->height - 1; level > 0; level--) {
+        void **slot = &node->slots[(index >> (OSMOS::FS::PageCache::NODE_SHIFT * level)) % OSMOS::FS::PageCache::NODE_SIZE];
+
+        if (*slot == NULL) {
+            OSMOS::FS::PageCache::Node *child = OSMOS::FS::PageCache::allocateNode();
+            if (child == NULL)
+                return false;
+
+            *slot = child;
+            node->count++;
+        }
+
+        node = (OSMOS::FS::PageCache::Node *) *slot;
+    }
+
+    node->slots[index % OSMOS::FS::PageCache::NODE_SIZE] = page;
+    node->count++;
+
+    return true;
+}
+
+void OSMOS::FS::PageCache::remove(OSMOS::FS::PageCache::Page *page) {
+    OSMOS::FS::PageCache::Object *object = page->object;
+    OSMOS::FS::PageCache::Node *path[OSMOS::FS::PageCache::HEIGHT_MAXIMUM];
+    uint32_t index = page->index;
+
+    if (object->root == NULL)
+        return;
+
+    OSMOS::FS::PageCache::Node *node = object->root;
+    for (uint32_t level = object->height - 1; level > 0; level--) {
+        path[level] = node;
+        node = (OSMOS::FS::PageCache::Node *) node->slots[(index >> (OSMOS::FS::PageCache::NODE_SHIFT * level)) % OSMOS::FS::PageCache::NODE_SIZE];
+        if (node == NULL)
+            return;
+    }
+
+    if (node->slots[index % OSMOS::FS::PageCache::NODE_SIZE] != page)
+        return;
+
+    node->slots[index % OSMOS::FS::PageCache::NODE_SIZE] = NULL;
+    node->count--;
+
+    // The nodes left empty are freed up to the root
+    for (uint32_t level = 1; node->count == 0; level++) {
+        OSMOS::FS::PageCache::freeNode(node);
+
+        if (level == object->height) {
+            object->root = NULL;
+            object->height = 0;
+            break;
+        }
+
+        node = path[level];
+        node->slots[(index >> (OSMOS::FS::PageCache::NODE_SHIFT * level)) % OSMOS::FS::PageCache::NODE_SIZE] = NULL;
+        node->count--;
+    }
+}
+
+OSMOS::FS::PageCache::Page *OSMOS::FS::PageCache::allocatePage() {
+    if (OSMOS::FS::PageCache::FREE_PAGES == NULL)
+        OSMOS::FS::PageCache::reclaim(1);
+
+    OSMOS::FS::PageCache::Page *page = OSMOS::FS::PageCache::FREE_PAGES;
+    if (page == NULL)
+        return NULL;
+
+    OSMOS::FS::PageCache::FREE_PAGES = page->next;
+    page->next = NULL;
+
+    // The frame may come from pages evicted by the frame allocator, which
+    // puts them back in the free list meanwhile
+    page->data = (uint8_t *) OSMOS::System::Frame::allocate();
+    if (page->data == NULL) {
+        page->next = OSMOS::FS::PageCache::FREE_PAGES;
+        OSMOS::FS::PageCache::FREE_PAGES = page;
+        return NULL;
+    }
+
+    return page;
+}
+
+void OSMOS::FS::PageCache::evict(OSMOS::FS::PageCache::Page *page) {
+    OSMOS::FS::PageCache::Object *object = page->object;
+
+    OSMOS::FS::PageCache::remove(page);
+    OSMOS::System::Frame::free((address_t) page->data);
+
+    page->data = NULL;
+    page->object = NULL;
+    page->flags = 0;
+    page->next = OSMOS::FS::PageCache::FREE_PAGES;
+    OSMOS::FS::PageCache::FREE_PAGES = page;
+
+    object->pageCount--;
+    if (object->pageCount == 0 && object->references == 0)
+        object->used = false;
+}
+
+void OSMOS::FS::PageCache::wait(void *waited) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    OSMOS::System::Scheduler::Thread *current = OSMOS::System::Scheduler::getCurrent();
+    OSMOS::FS::PageCache::WAITING[current->identifier] = waited;
+    OSMOS::FS::PageCache::WAITERS[current->identifier] = current;
+    OSMOS::System::Scheduler::block();
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+}
+
+void OSMOS::FS::PageCache::wake(void *waited) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    for (uint32_t i = 0; i < OSMOS::System::Scheduler::THREAD_MAXIMUM; i++) {
+        OSMOS::System::Scheduler::Thread *waiter = OSMOS::FS::PageCache::WAITERS[i];
+
+        if (waiter != NULL && OSMOS::FS::PageCache::WAITING[i] == waited) {
+            OSMOS::FS::PageCache::WAITERS[i] = NULL;
+            OSMOS::System::Scheduler::wake(waiter);
+        }
+    }
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+}
+
+OSMOS::FS::PageCache::Object *OSMOS::FS::PageCache::open(OSMOS::FS::Ext4::Volume *volume, const char *path) {
+    OSMOS::FS::Ext4::File file;
+
+    if (!OSMOS::FS::Ext4::open(volume, path, &file))
+        return NULL;
+
+    // A file already cached keeps its pages. The inodes are few enough for a
+    // linear search
+    OSMOS::FS::PageCache::Object *object = NULL;
+    OSMOS::FS::PageCache::Object *unused = NULL;
+
+    for (uint32_t i = 0; i < OSMOS::FS::PageCache::OBJECT_MAXIMUM; i++) {
+        OSMOS::FS::PageCache::Object *candidate = &OSMOS::FS::PageCache::OBJECTS[i];
+
+        if (!candidate->used) {
+            if (unused == NULL || unused->used)
+                unused = candidate;
+        } else if (candidate->file.volume == volume && candidate->file.number == file.number) {
+            object = candidate;
+            break;
+        } else if (candidate->references == 0 && unused == NULL) {
+            unused = candidate;
+        }
+    }
+
+    if (object != NULL) {
+        object->references++;
+        return object;
+    }
+
+    if (unused == NULL)
+        return NULL;
+
+    // A closed file gives its object back once its pages are evicted, which
+    // none of them prevents since it has no users
+    for (uint32_t i = 0; unused->used && i < OSMOS::FS::PageCache::PAGE_MAXIMUM; i++) {
+        if (OSMOS::FS::PageCache::PAGES[i].object == unused)
+            OSMOS::FS::PageCache::evict(&OSMOS::FS::PageCache::PAGES[i]);
+    }
+
+    unused->file = file;
+    unused->root = NULL;
+    unused->height = 0;
+    unused->pageCount = 0;
+    unused->references = 1;
+    unused->busy = false;
+    unused->readaheadNext = 0;
+    unused->readaheadWindow = 0;
+    unused->used = true;
+
+    return unused;
+}
+
+void OSMOS::FS::PageCache::close(OSMOS::FS::PageCache::Object *object) {
+    object->references--;
+
+    if (object->references == 0 && object->pageCount == 0)
+        object->used = false;
+}
+
+uint64_t OSMOS::FS::PageCache::getSize(OSMOS::FS::PageCache::Object *object) {
+    return object->file.size;
+}
+
+OSMOS::FS::PageCache::Page *OSMOS::FS::PageCache::get(OSMOS::FS::PageCache::Object *object, uint32_t index) {
+    if ((uint64_t) index * OSMOS::FS::PageCache::PAGE_SIZE >= object->file.size)
+        return NULL;
+
+    OSMOS::FS::PageCache::STATISTICS.lookups++;
+
+    OSMOS::FS::PageCache::Page *page = OSMOS::FS::PageCache::find(object, index);
+    if (page != NULL) {
+        OSMOS::FS::PageCache::STATISTICS.hits++;
+
+        page->references++;
+        page->flags |= OSMOS::FS::PageCache::PAGE_REFERENCED;
+
+        // Another thread may still be reading the page
+        while (page->flags & OSMOS::FS::PageCache::PAGE_LOCKED)
+            OSMOS::FS::PageCache::wait(page);
+
+        if (!(page->flags & OSMOS::FS::PageCache::PAGE_VALID)) {
+            OSMOS::FS::PageCache::release(page);
+            return NULL;
+        }
+
+        return page;
+    }
+
+    OSMOS::FS::PageCache::STATISTICS.misses++;
+
+    // A miss continuing the previous one doubles the window, a miss at the
+    // start of the file opens it, and any other miss closes it
+    if (index == object->readaheadNext && index != 0)
+        object->readaheadWindow = (object->readaheadWindow * 2 < OSMOS::FS::PageCache::READAHEAD_MINIMUM ? OSMOS::FS::PageCache::READAHEAD_MINIMUM : object->readaheadWindow * 2);
+    else if (index == 0)
+        object->readaheadWindow = OSMOS::FS::PageCache::READAHEAD_MINIMUM;
+    else
+        object->readaheadWindow = 1;
+
+    if (object->readaheadWindow > OSMOS::FS::PageCache::READAHEAD_MAXIMUM)
+        object->readaheadWindow = OSMOS::FS::PageCache::READAHEAD_MAXIMUM;
+
+    OSMOS::FS::PageCache::Page *pages[OSMOS::FS::PageCache::READAHEAD_MAXIMUM];
+    uint8_t *frames[OSMOS::FS::PageCache::READAHEAD_MAXIMUM];
+    uint32_t count = 0;
+
+    // The window is the missing page and the pages following it up to the
+    // first cached one. Only the missing page is referenced, so the pages
+    // read ahead and never used are evicted first
+    while (count < object->readaheadWindow && ((uint64_t) index + count) * OSMOS::FS::PageCache::PAGE_SIZE < object->file.size) {
+        if (count > 0 && OSMOS::FS::PageCache::find(object, index + count) != NULL)
+            break;
+
+        page = OSMOS::FS::PageCache::allocatePage();
+        if (page == NULL)
+            break;
+
+        page->object = object;
+        page->index = index + count;
+        page->references = (count == 0 ? 1 : 0);
+        page->flags = OSMOS::FS::PageCache::PAGE_LOCKED | (count == 0 ? OSMOS::FS::PageCache::PAGE_REFERENCED : 0);
+
+        if (!OSMOS::FS::PageCache::insert(page)) {
+            page->references = 0;
+            object->pageCount++;
+            OSMOS::FS::PageCache::evict(page);
+            break;
+        }
+
+        object->pageCount++;
+        pages[count] = page;
+        frames[count] = page->data;
+        count++;
+    }
+
+    if (count == 0)
+        return NULL;
+
+    // The pages are locked in the tree before the read, so the other users
+    // wait for them instead of reading them again. The blocks go from the
+    // device to the frames of the pages, with no copy in the buffer cache
+    while (object->busy)
+        OSMOS::FS::PageCache::wait(object);
+
+    object->busy = true;
+    bool success = OSMOS::FS::Ext4::readPages(&object->file, index, frames, count);
+    object->busy = false;
+    OSMOS::FS::PageCache::wake(object);
+
+    object->readaheadNext = index + count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        page = pages[i];
+
+        if (success) {
+            uint64_t length = object->file.size - (uint64_t) page->index * OSMOS::FS::PageCache::PAGE_SIZE;
+            if (length < OSMOS::FS::PageCache::PAGE_SIZE)
+                OSMOS::System::Memory::fill(page->data + length, OSMOS::FS::PageCache::PAGE_SIZE - (uint32_t) length, (uint8_t) 0);
+
+            page->flags = OSMOS::FS::PageCache::PAGE_VALID | (page->flags & OSMOS::FS::PageCache::PAGE_REFERENCED);
+            OSMOS::FS::PageCache::wake(page);
+            continue;
+        }
+
+        // The pages which could not be read are dropped by their last user
+        page->flags &= ~OSMOS::FS::PageCache::PAGE_LOCKED;
+        OSMOS::FS::PageCache::wake(page);
+        if (i == 0)
+            OSMOS::FS::PageCache::release(page);
+        else if (page->references == 0)
+            OSMOS::FS::PageCache::evict(page);
+    }
+
+    return (success ? pages[0] : NULL);
+}
+
+void OSMOS::FS::PageCache::release(OSMOS::FS::PageCache::Page *page) {
+    page->references--;
+
+    // A page which could not be read is dropped by its last user
+    if (page->references == 0 && !(page->flags & (OSMOS::FS::PageCache::PAGE_VALID | OSMOS::FS::PageCache::PAGE_LOCKED)))
+        OSMOS::FS::PageCache::evict(page);
+}
+
+uint32_t OSMOS::FS::PageCache::read(OSMOS::FS::PageCache::Object *object, uint64_t offset, uint8_t *target, uint32_t length) {
+    uint32_t total = 0;
+
+    if (offset >= object->file.size)
+        return 0;
+
+    if (length > object->file.size - offset)
+        length = (uint32_t) (object->file.size - offset);
+
+    while (total < length) {
+        OSMOS::FS::PageCache::Page *page = OSMOS::FS::PageCache::get(object, (uint32_t) (offset / OSMOS::FS::PageCache::PAGE_SIZE));
+        if (page == NULL)
+            break;
+
+        uint32_t start = (uint32_t) (offset % OSMOS::FS::PageCache::PAGE_SIZE);
+        uint32_t count = OSMOS::FS::PageCache::PAGE_SIZE - start;
+        if (count > length - total)
+            count = length - total;
+
+        OSMOS::System::Memory::copy(target + total, page->data + start, count);
+        OSMOS::FS::PageCache::release(page);
+
+        offset += count;
+        total += count;
+    }
+
+    return total;
+}
+
+bool OSMOS::FS::PageCache::mapFile(OSMOS::System::Paging::Space *space, address_t address, uint32_t length, OSMOS::FS::PageCache::Object *object, uint32_t offset, uint8_t flags) {
+    return OSMOS::FS::PageCache::mapFile(space, address, length, object, offset, length, flags);
+}
+
+bool OSMOS::FS::PageCache::mapFile(OSMOS::System::Paging::Space *space, address_t address, uint32_t length, OSMOS::FS::PageCache::Object *object, uint32_t offset, uint32_t dataLength, uint8_t flags) {
+    if (offset >= object->file.size)
+        dataLength = 0;
+    else if (object->file.size - offset < dataLength)
+        dataLength = (uint32_t) (object->file.size - offset);
+
+    // The mapping keeps the file open
+    object->references++;
+
+    if (!OSMOS::System::Paging::addMapping(space, address, length, flags, &OSMOS::FS::PageCache::PAGER, object, offset, dataLength)) {
+        OSMOS::FS::PageCache::close(object);
+        return false;
+    }
+
+    return true;
+}
+
+address_t OSMOS::FS::PageCache::getPage(void *object, uint32_t index) {
+    OSMOS::FS::PageCache::Page *page = OSMOS::FS::PageCache::get((OSMOS::FS::PageCache::Object *) object, index);
+
+    return (page != NULL ? (address_t) page->data : NULL);
+}
+
+void OSMOS::FS::PageCache::putPage(void *object, uint32_t index) {
+    OSMOS::FS::PageCache::Page *page = OSMOS::FS::PageCache::find((OSMOS::FS::PageCache::Object *) object, index);
+
+    if (page != NULL)
+        OSMOS::FS::PageCache::release(page);
+}
+
+void OSMOS::FS::PageCache::releaseObject(void *object) {
+    OSMOS::FS::PageCache::close((OSMOS::FS::PageCache::Object *) object);
+}
+
+uint32_t OSMOS::FS::PageCache::reclaim(uint32_t count) {
+    uint32_t freed = 0;
+
+    // A second chance clock: a page used since the last turn is kept once
+    for (uint32_t i = 0; freed < count && i < 2 * OSMOS::FS::PageCache::PAGE_MAXIMUM; i++) {
+        OSMOS::FS::PageCache::Page *page = &OSMOS::FS::PageCache::PAGES[OSMOS::FS::PageCache::CLOCK_HAND];
+        OSMOS::FS::PageCache::CLOCK_HAND = (OSMOS::FS::PageCache::CLOCK_HAND + 1) % OSMOS::FS::PageCache::PAGE_MAXIMUM;
+
+        if (page->object == NULL || page->references > 0 || (page->flags & OSMOS::FS::PageCache::PAGE_LOCKED))
+            continue;
+
+        if (page->flags & OSMOS::FS::PageCache::PAGE_REFERENCED) {
+            page->flags &= ~OSMOS::FS::PageCache::PAGE_REFERENCED;
+            continue;
+        }
+
+        OSMOS::FS::PageCache::evict(page);
+        OSMOS::FS::PageCache::STATISTICS.evictions++;
+        freed++;
+    }
+
+    return freed;
+}
+
+OSMOS::FS::PageCache::Statistics *OSMOS::FS::PageCache::getStatistics() {
+    return &OSMOS::FS::PageCache::STATISTICS;
+}
\ No newline at end of file
@@ -0,0 +1,320 @@
+/*
+ * The page cache class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGECACHE_HPP
+#define PAGECACHE_HPP
+
+#include "../osmos.hpp"
+
+#include "ext4.hpp"
+#include "../sys/paging.hpp"
+#include "../sys/scheduler.hpp"
+
+namespace OSMOS {
+    namespace FS {
+        /**
+         * @brief PageCache's class that caches the pages of the files. The
+         * pages of a file (an object) are indexed by their offset in a radix
+         * tree, reads copy straight out of them, and mappings borrow them
+         * without any copy. Unused pages are evicted by a clock when the
+         * frame allocator runs out of frames
+         **/
+        class PageCache {
+        public:
+            /**
+             * The size in bytes of a page
+             **/
+            static const uint32_t PAGE_SIZE = 4096;
+            /**
+             * The maximum number of cached files, pages and radix tree nodes
+             **/
+            static const uint32_t OBJECT_MAXIMUM = 64;
+            static const uint32_t PAGE_MAXIMUM = 4096;
+            static const uint32_t NODE_MAXIMUM = 512;
+            /**
+             * The number of bits of the page index used by each level of the
+             * radix trees, and the maximum height of a tree, which covers
+             * every 32-bit index
+             **/
+            static const uint32_t NODE_SHIFT = 6;
+            static const uint32_t NODE_SIZE = 1 << NODE_SHIFT;
+            static const uint32_t HEIGHT_MAXIMUM = 6;
+            /**
+             * The number of pages read by a miss starting a sequential read,
+             * and the maximum number of pages read by a miss
+             **/
+            static const uint32_t READAHEAD_MINIMUM = 4;
+            static const uint32_t READAHEAD_MAXIMUM = 32;
+
+            /**
+             * The flags of a page: filled with the data of the file, being
+             * filled, and used since the last turn of the clock
+             **/
+            static uint8_t PAGE_VALID;
+            static uint8_t PAGE_LOCKED;
+            static uint8_t PAGE_REFERENCED;
+
+            /**
+             * A node of a radix tree. The slots of the last level point to
+             * pages, the others to nodes
+             **/
+            struct Node {
+                void *slots[NODE_SIZE];
+                uint32_t count;
+            };
+
+            struct Object;
+
+            /**
+             * A cached page
+             **/
+            struct Page {
+                uint8_t *data;
+                /**
+                 * The file of the page, or NULL if the page is free
+                 **/
+                OSMOS::FS::PageCache::Object *object;
+                uint32_t index;
+                /**
+                 * The number of users, including the mappings. A used page is
+                 * never evicted
+                 **/
+                uint32_t references;
+                volatile uint8_t flags;
+                OSMOS::FS::PageCache::Page *next;
+            };
+
+            /**
+             * A cached file. It stays cached once closed, until its last page
+             * is evicted
+             **/
+            struct Object {
+                OSMOS::FS::Ext4::File file;
+                OSMOS::FS::PageCache::Node *root;
+                uint32_t height;
+                uint32_t pageCount;
+                uint32_t references;
+                /**
+                 * Set while pages are read through the file, whose position
+                 * and extent cache are shared
+                 **/
+                volatile bool busy;
+                /**
+                 * The readahead state: the page a sequential read continues
+                 * at, and the number of pages read by the next miss there
+                 **/
+                uint32_t readaheadNext;
+                uint32_t readaheadWindow;
+                bool used;
+            };
+
+            /**
+             * The counters of the cache
+             **/
+            struct Statistics {
+                uint32_t lookups;
+                uint32_t hits;
+                uint32_t misses;
+                uint32_t evictions;
+            };
+
+        private:
+            static OSMOS::FS::PageCache::Object OBJECTS[OBJECT_MAXIMUM];
+            static OSMOS::FS::PageCache::Page PAGES[PAGE_MAXIMUM];
+            static OSMOS::FS::PageCache::Page *FREE_PAGES;
+            static OSMOS::FS::PageCache::Node NODES[NODE_MAXIMUM];
+            static OSMOS::FS::PageCache::Node *FREE_NODES;
+            static uint32_t FREE_NODE_COUNT;
+            static uint32_t CLOCK_HAND;
+            static OSMOS::FS::PageCache::Statistics STATISTICS;
+            /**
+             * The pager lending the pages to the mappings of mapFile
+             **/
+            static const OSMOS::System::Paging::Pager PAGER;
+            /**
+             * The locked page or the busy object each thread waits for, by
+             * thread identifier
+             **/
+            static void *WAITING[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+            static OSMOS::System::Scheduler::Thread *WAITERS[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+
+            /**
+             * @brief Takes a free node, cleared
+             * @return the node, or NULL if none is free
+             **/
+            static OSMOS::FS::PageCache::Node *allocateNode();
+            /**
+             * @brief Gives back a node
+             * @param node the node to free
+             **/
+            static void freeNode(OSMOS::FS::PageCache::Node *node);
+            /**
+             * @brief Finds a page in the radix tree of a file
+             * @param object the file
+             * @param index the index of the page
+             * @return the page, or NULL if it is not cached
+             **/
+            static OSMOS::FS::PageCache::Page *find(OSMOS::FS::PageCache::Object *object, uint32_t index);
+            /**
+             * @brief Inserts a page in the radix tree of its file, growing the
+             * tree as needed
+             * @param page the page, whose object and index are set
+             * @return false if there are not enough free nodes, even after
+             * evicting pages
+             **/
+            static bool insert(OSMOS::FS::PageCache::Page *page);
+            /**
+             * @brief Removes a page from the radix tree of its file and frees
+             * the nodes left empty
+             * @param page the page
+             **/
+            static void remove(OSMOS::FS::PageCache::Page *page);
+            /**
+             * @brief Takes a free page with a frame, evicting pages if needed
+             * @return the page, or NULL if every page is used
+             **/
+            static OSMOS::FS::PageCache::Page *allocatePage();
+            /**
+             * @brief Evicts an unused page: removes it from its file and gives
+             * back its frame
+             * @param page the page to evict
+             **/
+            static void evict(OSMOS::FS::PageCache::Page *page);
+            /**
+             * @brief Blocks the running thread until a locked page is unlocked
+             * or a busy object is freed. The caller checks the condition again
+             * @param waited the page or the object
+             **/
+            static void wait(void *waited);
+            /**
+             * @brief Wakes the threads waiting for a page or an object
+             * @param waited the page or the object
+             **/
+            static void wake(void *waited);
+
+            /**
+             * @brief The pager functions of the mappings, which take and give
+             * back pages of an object, then release it
+             **/
+            static address_t getPage(void *object, uint32_t index);
+            static void putPage(void *object, uint32_t index);
+            static void releaseObject(void *object);
+
+        public:
+            /**
+             * @brief Initializes the cache and registers it as a reclaimer of
+             * the frame allocator
+             **/
+            static void initialize();
+
+            /**
+             * @brief Opens a file through the cache
+             * @param volume the volume of the file
+             * @param path the absolute path of the file
+             * @return the object of the file, or NULL if the file is not found
+             * or if every object is used
+             **/
+            static OSMOS::FS::PageCache::Object *open(OSMOS::FS::Ext4::Volume *volume, const char *path);
+            /**
+             * @brief Closes a file. Its pages stay cached
+             * @param object the object of the file
+             **/
+            static void close(OSMOS::FS::PageCache::Object *object);
+            /**
+             * @brief Gets the size of a file
+             * @param object the object of the file
+             * @return the size in bytes
+             **/
+            static uint64_t getSize(OSMOS::FS::PageCache::Object *object);
+
+            /**
+             * @brief Gets a page of a file, reading it if it is not cached,
+             * along with the pages which follow it when the file is read
+             * sequentially. The pages are read straight into their frames. The
+             * page stays until released
+             * @param object the object of the file
+             * @param index the index of the page
+             * @return the page, or NULL if it is after the end of the file or
+             * could not be read
+             **/
+            static OSMOS::FS::PageCache::Page *get(OSMOS::FS::PageCache::Object *object, uint32_t index);
+            /**
+             * @brief Releases a page returned by get
+             * @param page the page to release
+             **/
+            static void release(OSMOS::FS::PageCache::Page *page);
+            /**
+             * @brief Copies bytes of a file out of its cached pages
+             * @param object the object of the file
+             * @param offset the position of the bytes in the file
+             * @param target the memory to copy to
+             * @param length the number of bytes to copy
+             * @return the number of bytes copied, less than length at the end
+             * of the file or on a read error
+             **/
+            static uint32_t read(OSMOS::FS::PageCache::Object *object, uint64_t offset, uint8_t *target, uint32_t length);
+            /**
+             * @brief Maps a file in an address space. The pages are borrowed
+             * from the cache when first touched, read-only, or copied on their
+             * first write if the mapping is private and writable. The file
+             * stays open until the mapping is removed
+             * @param space the address space
+             * @param address the first address, aligned on PAGE_SIZE
+             * @param length the length of the mapping in bytes. The pages
+             * after the end of the file are zeroed
+             * @param object the object of the file
+             * @param offset the position of the mapping in the file, aligned
+             * on PAGE_SIZE
+             * @param flags the MAPPING_* flags of the Paging class
+             * @return false if the mapping could not be added
+             **/
+            static bool mapFile(OSMOS::System::Paging::Space *space, address_t address, uint32_t length, OSMOS::FS::PageCache::Object *object, uint32_t offset, uint8_t flags);
+            /**
+             * @brief Maps a part of a file in an address space, as mapFile does,
+             * with the pages after a given length of data zeroed. It maps the
+             * segments of the executables, whose end is not in the file
+             * @param space the address space
+             * @param address the first address, aligned on PAGE_SIZE
+             * @param length the length of the mapping in bytes
+             * @param object the object of the file
+             * @param offset the position of the mapping in the file, aligned
+             * on PAGE_SIZE
+             * @param dataLength the number of bytes of the file mapped, the
+             * rest of the mapping being zeroed
+             * @param flags the MAPPING_* flags of the Paging class
+             * @return false if the mapping could not be added
+             **/
+            static bool mapFile(OSMOS::System::Paging::Space *space, address_t address, uint32_t length, OSMOS::FS::PageCache::Object *object, uint32_t offset, uint32_t dataLength, uint8_t flags);
+
+            /**
+             * @brief Evicts unused pages, the recently used ones last. It is
+             * registered as a reclaimer of the frame allocator
+             * @param count the number of frames wanted
+             * @return the number of frames freed
+             **/
+            static uint32_t reclaim(uint32_t count);
+            /**
+             * @brief Gets the counters of the cache
+             * @return the counters
+             **/
+            static OSMOS::FS::PageCache::Statistics *getStatistics();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,901 @@
+/*
+ * The block layer class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "block.hpp"
+
+#include "timer.hpp"
+#include "../sys/frame.hpp"
+#include "../sys/interrupts.hpp"
+#include "../sys/memory.hpp"
+
+uint8_t OSMOS::IO::Block::BUFFER_VALID                      = 0x01;
+uint8_t OSMOS::IO::Block::BUFFER_DIRTY                      = 0x02;
+uint8_t OSMOS::IO::Block::BUFFER_IO                         = 0x04;
+uint8_t OSMOS::IO::Block::BUFFER_REFERENCED                 = 0x08;
+uint8_t OSMOS::IO::Block::BUFFER_ERROR                      = 0x10;
+
+uint8_t OSMOS::IO::Block::REQUEST_READ                      = 0;
+uint8_t OSMOS::IO::Block::REQUEST_WRITE                     = 1;
+
+OSMOS::IO::Block::Device *OSMOS::IO::Block::DEVICES[OSMOS::IO::Block::DEVICE_MAXIMUM];
+uint32_t OSMOS::IO::Block::DEVICE_COUNT                     = 0;
+
+OSMOS::IO::Block::Buffer OSMOS::IO::Block::BUFFERS[OSMOS::IO::Block::BUFFER_MAXIMUM];
+uint32_t OSMOS::IO::Block::BUFFER_COUNT                     = 0;
+OSMOS::IO::Block::Buffer *OSMOS::IO::Block::HASH[OSMOS::IO::Block::HASH_SIZE];
+uint32_t OSMOS::IO::Block::CLOCK_HAND                       = 0;
+
+OSMOS::IO::Block::Request OSMOS::IO::Block::REQUESTS[OSMOS::IO::Block::REQUEST_MAXIMUM];
+OSMOS::IO::Block::Request *OSMOS::IO::Block::FREE_REQUESTS  = NULL;
+
+OSMOS::IO::Block::Buffer *OSMOS::IO::Block::WAITING[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+OSMOS::System::Scheduler::Thread *OSMOS::IO::Block::WAITERS[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+
+// The number of ticks a request may wait in the elevator before it is
+// dispatched first, by direction
+#define BLOCK_READ_EXPIRE                                   50
+#define BLOCK_WRITE_EXPIRE                                  500
+
+// The number of requests dispatched in a row in the same direction, and the
+// number of read batches which may go before the pending writes
+#define BLOCK_BATCH_MAXIMUM                                 16
+#define BLOCK_STARVED_MAXIMUM                               2
+
+// The period of the write-back thread, and the age from which it writes a
+// dirty buffer, in ticks
+#define BLOCK_WRITEBACK_INTERVAL                            500
+#define BLOCK_DIRTY_EXPIRE                                  3000
+
+void OSMOS::IO::Block::initialize() {
+    OSMOS::IO::Block::DEVICE_COUNT = 0;
+    OSMOS::IO::Block::BUFFER_COUNT = 0;
+    OSMOS::IO::Block::CLOCK_HAND = 0;
+
+    for (uint32_t i = 0; i < OSMOS::IO::Block::HASH_SIZE; i++)
+        OSMOS::IO::Block::HASH[i] = NULL;
+
+    OSMOS::IO::Block::FREE_REQUESTS = NULL;
+    for (uint32_t i = OSMOS::IO::Block::REQUEST_MAXIMUM; i > 0; i--) {
+        OSMOS::IO::Block::Request *request = &OSMOS::IO::Block::REQUESTS[i - 1];
+
+        request->identifier = i - 1;
+        request->sortedNext = OSMOS::IO::Block::FREE_REQUESTS;
+        OSMOS::IO::Block::FREE_REQUESTS = request;
+    }
+
+    for (uint32_t i = 0; i < OSMOS::System::Scheduler::THREAD_MAXIMUM; i++) {
+        OSMOS::IO::Block::WAITING[i] = NULL;
+        OSMOS::IO::Block::WAITERS[i] = NULL;
+    }
+
+    OSMOS::System::Scheduler::create(OSMOS::IO::Block::writeBack, NULL);
+    OSMOS::System::Frame::addReclaimer(OSMOS::IO::Block::shrink);
+}
+
+bool OSMOS::IO::Block::attach(OSMOS::IO::Block::Device *device) {
+    if (OSMOS::IO::Block::DEVICE_COUNT >= OSMOS::IO::Block::DEVICE_MAXIMUM)
+        return false;
+
+    if (device->segmentMaximum == 0 || device->segmentMaximum > OSMOS::IO::Block::REQUEST_BUFFER_MAXIMUM)
+        device->segmentMaximum = OSMOS::IO::Block::REQUEST_BUFFER_MAXIMUM;
+    if (device->queueMaximum == 0 || device->queueMaximum > OSMOS::IO::Block::REQUEST_MAXIMUM)
+        device->queueMaximum = OSMOS::IO::Block::REQUEST_MAXIMUM;
+
+    for (uint8_t direction = 0; direction < 2; direction++) {
+        device->sorted[direction] = NULL;
+        device->fifoHead[direction] = NULL;
+        device->fifoTail[direction] = NULL;
+    }
+
+    device->lastMerge = NULL;
+    device->position = 0;
+    device->direction = OSMOS::IO::Block::REQUEST_READ;
+    device->batch = 0;
+    device->starved = 0;
+    device->pending = 0;
+    device->inFlight = 0;
+    device->queueDepth = device->queueMaximum;
+    device->dirtyHead = NULL;
+    device->dirtyTail = NULL;
+    device->dirtyCount = 0;
+    OSMOS::System::Memory::fill((uint8_t *) &device->statistics, sizeof(OSMOS::IO::Block::Statistics), 0);
+
+    device->identifier = OSMOS::IO::Block::DEVICE_COUNT;
+    OSMOS::IO::Block::DEVICES[OSMOS::IO::Block::DEVICE_COUNT++] = device;
+
+    return true;
+}
+
+uint32_t OSMOS::IO::Block::getDeviceCount() {
+    return OSMOS::IO::Block::DEVICE_COUNT;
+}
+
+OSMOS::IO::Block::Device *OSMOS::IO::Block::getDevice(uint32_t index) {
+    return (index < OSMOS::IO::Block::DEVICE_COUNT ? OSMOS::IO::Block::DEVICES[index] : NULL);
+}
+
+uint32_t OSMOS::IO::Block::hash(OSMOS::IO::Block::Device *device, uint32_t index) {
+    // Multiplicative hashing: the upper bits are the best mixed, and HASH_SIZE
+    // is 2 ^ 9
+    uint32_t key = index ^ (device->identifier << 24);
+    return (key * 2654435761U) >> 23;
+}
+
+OSMOS::IO::Block::Buffer *OSMOS::IO::Block::lookup(OSMOS::IO::Block::Device *device, uint32_t index) {
+    OSMOS::IO::Block::Buffer *buffer = OSMOS::IO::Block::HASH[OSMOS::IO::Block::hash(device, index)];
+
+    while (buffer != NULL && (buffer->device != device || buffer->index != index))
+        buffer = buffer->hashNext;
+
+    return buffer;
+}
+
+void OSMOS::IO::Block::unhash(OSMOS::IO::Block::Buffer *buffer) {
+    OSMOS::IO::Block::Buffer **link = &OSMOS::IO::Block::HASH[OSMOS::IO::Block::hash(buffer->device, buffer->index)];
+
+    while (*link != NULL && *link != buffer)
+        link = &(*link)->hashNext;
+
+    if (*link != NULL)
+        *link = buffer->hashNext;
+
+    buffer->hashNext = NULL;
+}
+
+OSMOS::IO::Block::Buffer *OSMOS::IO::Block::obtain(OSMOS::IO::Block::Device *device, uint32_t index) {
+    OSMOS::IO::Block::Buffer *buffer = NULL;
+
+    // The cache grows with new frames until it is full or the frames run out
+    if (OSMOS::IO::Block::BUFFER_COUNT < OSMOS::IO::Block::BUFFER_MAXIMUM) {
+        uint8_t *data = (uint8_t *) OSMOS::System::Frame::allocate();
+
+        if (data != NULL) {
+            buffer = &OSMOS::IO::Block::BUFFERS[OSMOS::IO::Block::BUFFER_COUNT++];
+            buffer->data = data;
+        }
+    }
+
+    // Otherwise the clock evicts the first clean and unused buffer which was
+    // not referenced since its last turn
+    for (uint32_t i = 0; buffer == NULL && i < 2 * OSMOS::IO::Block::BUFFER_COUNT; i++) {
+        OSMOS::IO::Block::Buffer *candidate = &OSMOS::IO::Block::BUFFERS[OSMOS::IO::Block::CLOCK_HAND];
+        OSMOS::IO::Block::CLOCK_HAND = (OSMOS::IO::Block::CLOCK_HAND + 1) % OSMOS::IO::Block::BUFFER_COUNT;
+
+        // A buffer whose frame was given back by shrink takes a new one
+        if (candidate->data == NULL) {
+            candidate->data = (uint8_t *) OSMOS::System::Frame::allocate();
+            if (candidate->data != NULL)
+                buffer = candidate;
+
+            continue;
+        }
+
+        if (candidate->references > 0 || (candidate->flags & (OSMOS::IO::Block::BUFFER_DIRTY | OSMOS::IO::Block::BUFFER_IO)))
+            continue;
+
+        if (candidate->flags & OSMOS::IO::Block::BUFFER_REFERENCED) {
+            candidate->flags &= ~OSMOS::IO::Block::BUFFER_REFERENCED;
+            continue;
+        }
+
+        if (candidate->device != NULL) {
+            candidate->device->statistics.evictions++;
+            OSMOS::IO::Block::unhash(candidate);
+        }
+
+        buffer = candidate;
+    }
+
+    if (buffer == NULL)
+        return NULL;
+
+    buffer->device = device;
+    buffer->index = index;
+    buffer->flags = 0;
+    buffer->references = 0;
+    buffer->dirtyTick = 0;
+    buffer->dirtyPrevious = NULL;
+    buffer->dirtyNext = NULL;
+
+    uint32_t bucket = OSMOS::IO::Block::hash(device, index);
+    buffer->hashNext = OSMOS::IO::Block::HASH[bucket];
+    OSMOS::IO::Block::HASH[bucket] = buffer;
+
+    return buffer;
+}
+
+void OSMOS::IO::Block::undirty(OSMOS::IO::Block::Buffer *buffer) {
+    OSMOS::IO::Block::Device *device = buffer->device;
+
+    if (buffer->dirtyPrevious != NULL)
+        buffer->dirtyPrevious->dirtyNext = buffer->dirtyNext;
+    else
+        device->dirtyHead = buffer->dirtyNext;
+
+    if (buffer->dirtyNext != NULL)
+        buffer->dirtyNext->dirtyPrevious = buffer->dirtyPrevious;
+    else
+        device->dirtyTail = buffer->dirtyPrevious;
+
+    buffer->dirtyPrevious = NULL;
+    buffer->dirtyNext = NULL;
+    buffer->flags &= ~OSMOS::IO::Block::BUFFER_DIRTY;
+    device->dirtyCount--;
+}
+
+bool OSMOS::IO::Block::queue(OSMOS::IO::Block::Buffer *buffer, uint8_t type) {
+    OSMOS::IO::Block::Device *device = buffer->device;
+    OSMOS::IO::Block::Request *request = device->lastMerge;
+    OSMOS::IO::Block::Request *merged = NULL;
+
+    // Sequential transfers extend the same request, so the hint is tried
+    // before the sorted list
+    if (request != NULL && request->type == type)
+        merged = OSMOS::IO::Block::merge(request, buffer);
+
+    for (request = device->sorted[type]; merged == NULL && request != NULL && request->index <= buffer->index + 1; request = request->sortedNext)
+        merged = OSMOS::IO::Block::merge(request, buffer);
+
+    device->statistics.queued++;
+
+    if (merged != NULL) {
+        device->statistics.merges++;
+        device->lastMerge = merged;
+        return true;
+    }
+
+    request = OSMOS::IO::Block::FREE_REQUESTS;
+    if (request == NULL) {
+        device->statistics.queued--;
+        return false;
+    }
+    OSMOS::IO::Block::FREE_REQUESTS = request->sortedNext;
+
+    request->type = type;
+    request->device = device;
+    request->index = buffer->index;
+    request->count = 1;
+    request->buffers[0] = buffer;
+    request->deadline = OSMOS::IO::Timer::getTicks() + (type == OSMOS::IO::Block::REQUEST_READ ? BLOCK_READ_EXPIRE : BLOCK_WRITE_EXPIRE);
+
+    OSMOS::IO::Block::insert(request);
+    device->pending++;
+    device->lastMerge = request;
+
+    return true;
+}
+
+OSMOS::IO::Block::Request *OSMOS::IO::Block::merge(OSMOS::IO::Block::Request *request, OSMOS::IO::Block::Buffer *buffer) {
+    if (request->count >= request->device->segmentMaximum)
+        return NULL;
+
+    if (buffer->index == request->index + request->count) {
+        request->buffers[request->count++] = buffer;
+
+        // The buffer may fill the hole before the next request
+        if (request->sortedNext != NULL)
+            OSMOS::IO::Block::coalesce(request, request->sortedNext);
+
+        return request;
+    }
+
+    if (buffer->index + 1 == request->index) {
+        for (uint32_t i = request->count; i > 0; i--)
+            request->buffers[i] = request->buffers[i - 1];
+
+        request->buffers[0] = buffer;
+        request->index--;
+        request->count++;
+
+        if (request->sortedPrevious != NULL && OSMOS::IO::Block::coalesce(request->sortedPrevious, request))
+            return request->sortedPrevious;
+
+        return request;
+    }
+
+    return NULL;
+}
+
+bool OSMOS::IO::Block::coalesce(OSMOS::IO::Block::Request *first, OSMOS::IO::Block::Request *second) {
+    if (first->index + first->count != second->index || first->count + second->count > first->device->segmentMaximum)
+        return false;
+
+    for (uint32_t i = 0; i < second->count; i++)
+        first->buffers[first->count + i] = second->buffers[i];
+
+    first->count += second->count;
+    if ((int32_t) (second->deadline - first->deadline) < 0)
+        first->deadline = second->deadline;
+
+    OSMOS::IO::Block::remove(second);
+    first->device->pending--;
+
+    second->sortedNext = OSMOS::IO::Block::FREE_REQUESTS;
+    OSMOS::IO::Block::FREE_REQUESTS = second;
+
+    return true;
+}
+
+void OSMOS::IO::Block::insert(OSMOS::IO::Block::Request *request) {
+    OSMOS::IO::Block::Device *device = request->device;
+    uint8_t type = request->type;
+
+    OSMOS::IO::Block::Request *previous = NULL;
+    OSMOS::IO::Block::Request *next = device->sorted[type];
+    while (next != NULL && next->index < request->index) {
+        previous = next;
+        next = next->sortedNext;
+    }
+
+    request->sortedPrevious = previous;
+    request->sortedNext = next;
+    if (previous != NULL)
+        previous->sortedNext = request;
+    else
+        device->sorted[type] = request;
+    if (next != NULL)
+        next->sortedPrevious = request;
+
+    // The FIFO stays ordered by deadline, as requests put back by dispatch
+    // keep theirs
+    previous = device->fifoTail[type];
+    while (previous != NULL && (int32_t) (previous->deadline - request->deadline) > 0)
+        previous = previous->fifoPrevious;
+
+    next = (previous != NULL ? previous->fifoNext : device->fifoHead[type]);
+    request->fifoPrevious = previous;
+    request->fifoNext = next;
+    if (previous != NULL)
+        previous->fifoNext = request;
+    else
+        device->fifoHead[type] = request;
+    if (next != NULL)
+        next->fifoPrevious = request;
+    else
+        device->fifoTail[type] = request;
+}
+
+void OSMOS::IO::Block::remove(OSMOS::IO::Block::Request *request) {
+    OSMOS::IO::Block::Device *device = request->device;
+    uint8_t type = request->type;
+
+    if (request->sortedPrevious != NULL)
+        request->sortedPrevious->sortedNext = request->sortedNext;
+    else
+        device->sorted[type] = request->sortedNext;
+    if (request->sortedNext != NULL)
+        request->sortedNext->sortedPrevious = request->sortedPrevious;
+
+    if (request->fifoPrevious != NULL)
+        request->fifoPrevious->fifoNext = request->fifoNext;
+    else
+        device->fifoHead[type] = request->fifoNext;
+    if (request->fifoNext != NULL)
+        request->fifoNext->fifoPrevious = request->fifoPrevious;
+    else
+        device->fifoTail[type] = request->fifoPrevious;
+
+    if (device->lastMerge == request)
+        device->lastMerge = NULL;
+}
+
+OSMOS::IO::Block::Request *OSMOS::IO::Block::choose(OSMOS::IO::Block::Device *device) {
+    OSMOS::IO::Block::Request *request;
+    uint8_t direction = device->direction;
+
+    // The current batch goes on in the same direction while the elevator has
+    // a request ahead
+    if (device->batch > 0 && device->batch < BLOCK_BATCH_MAXIMUM) {
+        for (request = device->sorted[direction]; request != NULL && request->index < device->position; request = request->sortedNext);
+
+        if (request != NULL) {
+            device->batch++;
+            return request;
+        }
+    }
+
+    // A new batch prefers the reads, unless the writes waited for too many
+    // read batches
+    bool reads = device->sorted[OSMOS::IO::Block::REQUEST_READ] != NULL;
+    bool writes = device->sorted[OSMOS::IO::Block::REQUEST_WRITE] != NULL;
+
+    if (reads && (!writes || device->starved < BLOCK_STARVED_MAXIMUM)) {
+        direction = OSMOS::IO::Block::REQUEST_READ;
+        if (writes)
+            device->starved++;
+    } else if (writes) {
+        direction = OSMOS::IO::Block::REQUEST_WRITE;
+        device->starved = 0;
+    } else {
+        device->batch = 0;
+        return NULL;
+    }
+
+    device->direction = direction;
+    device->batch = 1;
+
+    // An expired request goes first, otherwise the elevator goes on from its
+    // position and wraps around to the lowest request
+    request = device->fifoHead[direction];
+    if ((int32_t) (OSMOS::IO::Timer::getTicks() - request->deadline) >= 0)
+        return request;
+
+    for (request = device->sorted[direction]; request != NULL && request->index < device->position; request = request->sortedNext);
+
+    return (request != NULL ? request : device->sorted[direction]);
+}
+
+void OSMOS::IO::Block::dispatch(OSMOS::IO::Block::Device *device) {
+    OSMOS::IO::Block::Request *requests[OSMOS::IO::Block::REQUEST_MAXIMUM];
+    uint32_t count = 0;
+    uint32_t position = device->position;
+
+    // The state of the elevator before each choice, restored for the requests
+    // refused by the driver
+    uint8_t directions[OSMOS::IO::Block::REQUEST_MAXIMUM];
+    uint8_t batches[OSMOS::IO::Block::REQUEST_MAXIMUM];
+    uint8_t starves[OSMOS::IO::Block::REQUEST_MAXIMUM];
+
+    while (device->inFlight + count < device->queueDepth && count < OSMOS::IO::Block::REQUEST_MAXIMUM) {
+        directions[count] = device->direction;
+        batches[count] = device->batch;
+        starves[count] = device->starved;
+
+        OSMOS::IO::Block::Request *request = OSMOS::IO::Block::choose(device);
+
+        if (request == NULL)
+            break;
+
+        OSMOS::IO::Block::remove(request);
+        device->pending--;
+        device->position = request->index + request->count;
+        requests[count++] = request;
+    }
+
+    if (count == 0)
+        return;
+
+    uint32_t accepted = device->submit(device, requests, count);
+
+    for (uint32_t i = 0; i < accepted; i++) {
+        device->inFlight++;
+        device->statistics.depthTotal += device->inFlight;
+    }
+
+    if (device->inFlight > device->statistics.depthMaximum)
+        device->statistics.depthMaximum = device->inFlight;
+    device->statistics.dispatched += accepted;
+
+    // The driver is full: the rest waits for the next completion, and the
+    // queue depth is limited to what the driver really accepts. The elevator
+    // goes back to where the last accepted request left it
+    for (uint32_t i = accepted; i < count; i++) {
+        OSMOS::IO::Block::insert(requests[i]);
+        device->pending++;
+    }
+
+    if (accepted < count) {
+        device->position = (accepted > 0 ? requests[accepted - 1]->index + requests[accepted - 1]->count : position);
+        device->direction = directions[accepted];
+        device->batch = batches[accepted];
+        device->starved = starves[accepted];
+    }
+
+    if (accepted < count && device->inFlight > 0)
+        device->queueDepth = device->inFlight;
+}
+
+void OSMOS::IO::Block::complete(OSMOS::IO::Block::Request *request, bool success) {
+    OSMOS::IO::Block::Device *device = request->device;
+
+    for (uint32_t i = 0; i < request->count; i++) {
+        OSMOS::IO::Block::Buffer *buffer = request->buffers[i];
+
+        if (success) {
+            buffer->flags &= ~OSMOS::IO::Block::BUFFER_ERROR;
+            if (request->type == OSMOS::IO::Block::REQUEST_READ)
+                buffer->flags |= OSMOS::IO::Block::BUFFER_VALID;
+        } else {
+            buffer->flags |= OSMOS::IO::Block::BUFFER_ERROR;
+        }
+
+        buffer->flags &= ~OSMOS::IO::Block::BUFFER_IO;
+
+        // The data of a failed write is only in the buffer: it stays dirty,
+        // so it is neither evicted nor lost, and is written again later
+        if (!success && request->type == OSMOS::IO::Block::REQUEST_WRITE)
+            OSMOS::IO::Block::markDirty(buffer);
+    }
+
+    device->statistics.completed++;
+    if (!success)
+        device->statistics.errors++;
+
+    device->inFlight--;
+    if (device->inFlight == 0)
+        device->queueDepth = device->queueMaximum;
+
+    request->sortedNext = OSMOS::IO::Block::FREE_REQUESTS;
+    OSMOS::IO::Block::FREE_REQUESTS = request;
+
+    // The threads waiting for a buffer of the request, or for any request
+    for (uint32_t i = 0; i < OSMOS::System::Scheduler::THREAD_MAXIMUM; i++) {
+        OSMOS::System::Scheduler::Thread *waiter = OSMOS::IO::Block::WAITERS[i];
+
+        if (waiter == NULL)
+            continue;
+
+        if (OSMOS::IO::Block::WAITING[i] == NULL || !(OSMOS::IO::Block::WAITING[i]->flags & OSMOS::IO::Block::BUFFER_IO)) {
+            OSMOS::IO::Block::WAITERS[i] = NULL;
+            OSMOS::System::Scheduler::wake(waiter);
+        }
+    }
+
+    OSMOS::IO::Block::dispatch(device);
+}
+
+void OSMOS::IO::Block::wait(OSMOS::IO::Block::Buffer *buffer) {
+    while (buffer->flags & OSMOS::IO::Block::BUFFER_IO) {
+        OSMOS::IO::Block::Device *device = buffer->device;
+
+        if (device->poll != NULL) {
+            device->poll(device);
+            continue;
+        }
+
+        OSMOS::System::Scheduler::Thread *current = OSMOS::System::Scheduler::getCurrent();
+        OSMOS::IO::Block::WAITING[current->identifier] = buffer;
+        OSMOS::IO::Block::WAITERS[current->identifier] = current;
+        OSMOS::System::Scheduler::block();
+    }
+}
+
+void OSMOS::IO::Block::waitAny() {
+    bool polled = false;
+
+    for (uint32_t i = 0; i < OSMOS::IO::Block::DEVICE_COUNT; i++) {
+        OSMOS::IO::Block::Device *device = OSMOS::IO::Block::DEVICES[i];
+
+        if (device->poll != NULL && device->inFlight > 0) {
+            device->poll(device);
+            polled = true;
+        }
+    }
+
+    if (polled)
+        return;
+
+    OSMOS::System::Scheduler::Thread *current = OSMOS::System::Scheduler::getCurrent();
+    OSMOS::IO::Block::WAITING[current->identifier] = NULL;
+    OSMOS::IO::Block::WAITERS[current->identifier] = current;
+    OSMOS::System::Scheduler::block();
+}
+
+OSMOS::IO::Block::Buffer *OSMOS::IO::Block::read(OSMOS::IO::Block::Device *device, uint32_t index) {
+    if (index >= device->bufferCount)
+        return NULL;
+
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    device->statistics.lookups++;
+
+    OSMOS::IO::Block::Buffer *buffer = OSMOS::IO::Block::lookup(device, index);
+    if (buffer != NULL && (buffer->flags & (OSMOS::IO::Block::BUFFER_VALID | OSMOS::IO::Block::BUFFER_IO))) {
+        device->statistics.hits++;
+    } else {
+        device->statistics.misses++;
+
+        // Every buffer is busy: the dirty ones are written back so the clock
+        // can evict them once clean
+        while (buffer == NULL && (buffer = OSMOS::IO::Block::obtain(device, index)) == NULL) {
+            uint32_t busy = 0;
+
+            for (uint32_t i = 0; i < OSMOS::IO::Block::DEVICE_COUNT; i++) {
+                busy += OSMOS::IO::Block::writeDirty(OSMOS::IO::Block::DEVICES[i], 0);
+                OSMOS::IO::Block::dispatch(OSMOS::IO::Block::DEVICES[i]);
+                busy += OSMOS::IO::Block::DEVICES[i]->inFlight;
+            }
+
+            if (busy == 0) {
+                if (enabled)
+                    OSMOS::System::Interrupts::enable();
+                return NULL;
+            }
+
+            OSMOS::IO::Block::waitAny();
+            buffer = OSMOS::IO::Block::lookup(device, index);
+        }
+    }
+
+    buffer->references++;
+    buffer->flags |= OSMOS::IO::Block::BUFFER_REFERENCED;
+
+    if (!(buffer->flags & (OSMOS::IO::Block::BUFFER_VALID | OSMOS::IO::Block::BUFFER_IO))) {
+        buffer->flags |= OSMOS::IO::Block::BUFFER_IO;
+
+        while (!OSMOS::IO::Block::queue(buffer, OSMOS::IO::Block::REQUEST_READ)) {
+            OSMOS::IO::Block::dispatch(device);
+            OSMOS::IO::Block::waitAny();
+        }
+
+        OSMOS::IO::Block::dispatch(device);
+    }
+
+    OSMOS::IO::Block::wait(buffer);
+
+    if (!(buffer->flags & OSMOS::IO::Block::BUFFER_VALID)) {
+        buffer->references--;
+        buffer = NULL;
+    }
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return buffer;
+}
+
+uint32_t OSMOS::IO::Block::prefetch(OSMOS::IO::Block::Device *device, uint32_t index, uint32_t count) {
+    uint32_t started = 0;
+
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    // The reads are only queued here, so contiguous blocks end up in the same
+    // request before the single dispatch
+    for (uint32_t i = index; i < index + count && i < device->bufferCount; i++) {
+        if (OSMOS::IO::Block::lookup(device, i) != NULL)
+            continue;
+
+        OSMOS::IO::Block::Buffer *buffer = OSMOS::IO::Block::obtain(device, i);
+        if (buffer == NULL)
+            break;
+
+        buffer->flags = OSMOS::IO::Block::BUFFER_IO;
+        if (!OSMOS::IO::Block::queue(buffer, OSMOS::IO::Block::REQUEST_READ)) {
+            OSMOS::IO::Block::unhash(buffer);
+            buffer->flags = 0;
+            buffer->device = NULL;
+            break;
+        }
+
+        started++;
+    }
+
+    OSMOS::IO::Block::dispatch(device);
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return started;
+}
+
+bool OSMOS::IO::Block::readFrames(OSMOS::IO::Block::Device *device, uint32_t index, uint8_t **frames, uint32_t count) {
+    OSMOS::IO::Block::Buffer buffers[OSMOS::IO::Block::REQUEST_BUFFER_MAXIMUM];
+    OSMOS::IO::Block::Buffer *cached[OSMOS::IO::Block::REQUEST_BUFFER_MAXIMUM];
+    bool success = true;
+
+    if (count > OSMOS::IO::Block::REQUEST_BUFFER_MAXIMUM || index >= device->bufferCount || count > device->bufferCount - index)
+        return false;
+
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    // The missing blocks are described by buffers which are never hashed and
+    // whose data is the frame of the caller, so the driver fills the frames
+    // directly. Being contiguous, they are merged into few requests
+    for (uint32_t i = 0; i < count; i++) {
+        device->statistics.lookups++;
+
+        cached[i] = OSMOS::IO::Block::lookup(device, index + i);
+        if (cached[i] != NULL && (cached[i]->flags & (OSMOS::IO::Block::BUFFER_VALID | OSMOS::IO::Block::BUFFER_IO))) {
+            device->statistics.hits++;
+            cached[i]->references++;
+            continue;
+        }
+
+        device->statistics.misses++;
+        cached[i] = NULL;
+
+        OSMOS::IO::Block::Buffer *buffer = &buffers[i];
+        buffer->device = device;
+        buffer->index = index + i;
+        buffer->data = frames[i];
+        buffer->flags = OSMOS::IO::Block::BUFFER_IO;
+        buffer->references = 1;
+        buffer->dirtyTick = 0;
+        buffer->hashNext = NULL;
+        buffer->dirtyPrevious = NULL;
+        buffer->dirtyNext = NULL;
+
+        while (!OSMOS::IO::Block::queue(buffer, OSMOS::IO::Block::REQUEST_READ)) {
+            OSMOS::IO::Block::dispatch(device);
+            OSMOS::IO::Block::waitAny();
+        }
+    }
+
+    OSMOS::IO::Block::dispatch(device);
+
+    for (uint32_t i = 0; i < count; i++) {
+        OSMOS::IO::Block::Buffer *buffer = (cached[i] != NULL ? cached[i] : &buffers[i]);
+
+        OSMOS::IO::Block::wait(buffer);
+
+        if (!(buffer->flags & OSMOS::IO::Block::BUFFER_VALID))
+            success = false;
+        else if (cached[i] != NULL)
+            OSMOS::System::Memory::copy(frames[i], buffer->data, OSMOS::IO::Block::BUFFER_SIZE);
+
+        if (cached[i] != NULL)
+            cached[i]->references--;
+    }
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return success;
+}
+
+void OSMOS::IO::Block::markDirty(OSMOS::IO::Block::Buffer *buffer) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    if (!(buffer->flags & OSMOS::IO::Block::BUFFER_DIRTY)) {
+        OSMOS::IO::Block::Device *device = buffer->device;
+
+        buffer->flags |= OSMOS::IO::Block::BUFFER_DIRTY | OSMOS::IO::Block::BUFFER_VALID;
+        buffer->dirtyTick = OSMOS::IO::Timer::getTicks();
+        buffer->dirtyPrevious = device->dirtyTail;
+        buffer->dirtyNext = NULL;
+
+        if (device->dirtyTail != NULL)
+            device->dirtyTail->dirtyNext = buffer;
+        else
+            device->dirtyHead = buffer;
+
+        device->dirtyTail = buffer;
+        device->dirtyCount++;
+    }
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+}
+
+void OSMOS::IO::Block::release(OSMOS::IO::Block::Buffer *buffer) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    if (buffer->references > 0)
+        buffer->references--;
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+}
+
+uint32_t OSMOS::IO::Block::writeDirty(OSMOS::IO::Block::Device *device, uint32_t age) {
+    uint32_t now = OSMOS::IO::Timer::getTicks();
+    uint32_t queued = 0;
+
+    OSMOS::IO::Block::Buffer *buffer = device->dirtyHead;
+    while (buffer != NULL && (int32_t) (now - buffer->dirtyTick) >= (int32_t) age) {
+        OSMOS::IO::Block::Buffer *next = buffer->dirtyNext;
+
+        // A buffer modified again while being written waits for the next pass
+        if (buffer->flags & OSMOS::IO::Block::BUFFER_IO) {
+            buffer = next;
+            continue;
+        }
+
+        OSMOS::IO::Block::undirty(buffer);
+        buffer->flags |= OSMOS::IO::Block::BUFFER_IO;
+
+        bool waited = false;
+        while (!OSMOS::IO::Block::queue(buffer, OSMOS::IO::Block::REQUEST_WRITE)) {
+            OSMOS::IO::Block::dispatch(device);
+            OSMOS::IO::Block::waitAny();
+            waited = true;
+        }
+
+        device->statistics.writeBacks++;
+        queued++;
+
+        // Another thread may have changed the list while this one waited
+        buffer = (waited ? device->dirtyHead : next);
+    }
+
+    return queued;
+}
+
+bool OSMOS::IO::Block::flush(OSMOS::IO::Block::Device *device) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    uint32_t errors = device->statistics.errors;
+
+    OSMOS::IO::Block::writeDirty(device, 0);
+    OSMOS::IO::Block::dispatch(device);
+
+    while (device->inFlight > 0)
+        OSMOS::IO::Block::waitAny();
+
+    // The buffers left dirty by a failed write, even one written back
+    // before the flush, make it fail
+    bool success = (device->statistics.errors == errors);
+    for (OSMOS::IO::Block::Buffer *buffer = device->dirtyHead; success && buffer != NULL; buffer = buffer->dirtyNext)
+        success = !(buffer->flags & OSMOS::IO::Block::BUFFER_ERROR);
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return success;
+}
+
+uint32_t OSMOS::IO::Block::shrink(uint32_t count) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    // The same clock as obtain, so the recently referenced buffers stay
+    uint32_t freed = 0;
+    for (uint32_t i = 0; freed < count && i < 2 * OSMOS::IO::Block::BUFFER_COUNT; i++) {
+        OSMOS::IO::Block::Buffer *candidate = &OSMOS::IO::Block::BUFFERS[OSMOS::IO::Block::CLOCK_HAND];
+        OSMOS::IO::Block::CLOCK_HAND = (OSMOS::IO::Block::CLOCK_HAND + 1) % OSMOS::IO::Block::BUFFER_COUNT;
+
+        if (candidate->data == NULL || candidate->references > 0 || (candidate->flags & (OSMOS::IO::Block::BUFFER_DIRTY | OSMOS::IO::Block::BUFFER_IO)))
+            continue;
+
+        if (candidate->flags & OSMOS::IO::Block::BUFFER_REFERENCED) {
+            candidate->flags &= ~OSMOS::IO::Block::BUFFER_REFERENCED;
+            continue;
+        }
+
+        if (candidate->device != NULL) {
+            candidate->device->statistics.evictions++;
+            OSMOS::IO::Block::unhash(candidate);
+        }
+
+        OSMOS::System::Frame::free((address_t) candidate->data);
+        candidate->data = NULL;
+        candidate->device = NULL;
+        candidate->flags = 0;
+        freed++;
+    }
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return freed;
+}
+
+void OSMOS::IO::Block::writeBack(void *argument) {
+    (void) argument;
+
+    for (;;) {
+        OSMOS::System::Scheduler::sleep(BLOCK_WRITEBACK_INTERVAL);
+
+        OSMOS::System::Interrupts::disable();
+
+        for (uint32_t i = 0; i < OSMOS::IO::Block::DEVICE_COUNT; i++) {
+            OSMOS::IO::Block::Device *device = OSMOS::IO::Block::DEVICES[i];
+
+            if (device->dirtyCount > 0 && OSMOS::IO::Block::writeDirty(device, BLOCK_DIRTY_EXPIRE) > 0)
+                OSMOS::IO::Block::dispatch(device);
+        }
+
+        OSMOS::System::Interrupts::enable();
+    }
+}
\ No newline at end of file
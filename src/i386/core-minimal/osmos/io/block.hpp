@@ -0,0 +1,482 @@
+/*
+ * The block layer class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BLOCK_HPP
+#define BLOCK_HPP
+
+#include "../osmos.hpp"
+
+#include "../sys/scheduler.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief Block's class that sits between the filesystems and the disk
+         * drivers. The devices are read and written by buffers of BUFFER_SIZE
+         * bytes kept in a hashed cache; the misses and the write-backs are
+         * turned into requests which are merged when contiguous, sorted by a
+         * deadline elevator, and given to the driver by batches
+         **/
+        class Block {
+        public:
+            /**
+             * The size in bytes of a buffer, a single frame
+             **/
+            static const uint32_t BUFFER_SIZE = 4096;
+            /**
+             * The maximum number of buffers of the cache
+             **/
+            static const uint32_t BUFFER_MAXIMUM = 1024;
+            /**
+             * The number of buckets of the buffer hash table
+             **/
+            static const uint32_t HASH_SIZE = 512;
+            /**
+             * The maximum number of registered devices
+             **/
+            static const uint32_t DEVICE_MAXIMUM = 4;
+            /**
+             * The number of requests shared by the devices
+             **/
+            static const uint32_t REQUEST_MAXIMUM = 64;
+            /**
+             * The maximum number of buffers of a request (128 KB)
+             **/
+            static const uint32_t REQUEST_BUFFER_MAXIMUM = 32;
+
+            /**
+             * The <i>valid</i> flag indicates that the data of the buffer
+             * matches the device, or is newer if the buffer is dirty
+             **/
+            static uint8_t BUFFER_VALID;
+            /**
+             * The <i>dirty</i> flag indicates that the data of the buffer must
+             * be written back to the device
+             **/
+            static uint8_t BUFFER_DIRTY;
+            /**
+             * The <i>I/O</i> flag indicates that the buffer belongs to a
+             * request which did not complete yet
+             **/
+            static uint8_t BUFFER_IO;
+            /**
+             * The <i>referenced</i> flag gives a second chance to a recently
+             * used buffer when the clock looks for a buffer to evict
+             **/
+            static uint8_t BUFFER_REFERENCED;
+            /**
+             * The <i>error</i> flag indicates that the last transfer of the
+             * buffer failed
+             **/
+            static uint8_t BUFFER_ERROR;
+
+            /**
+             * The request types, also used as the direction of the elevator
+             **/
+            static uint8_t REQUEST_READ;
+            static uint8_t REQUEST_WRITE;
+
+            struct Device;
+
+            /**
+             * A cached block of a device
+             **/
+            struct Buffer {
+                OSMOS::IO::Block::Device *device;
+                /**
+                 * The index of the block on the device, in BUFFER_SIZE units
+                 **/
+                uint32_t index;
+                /**
+                 * The frame holding the data, allocated on first use
+                 **/
+                uint8_t *data;
+                /**
+                 * The BUFFER_* flags of the Block class
+                 **/
+                volatile uint8_t flags;
+                /**
+                 * The number of users of the buffer, which cannot be evicted
+                 * while it is not null
+                 **/
+                uint16_t references;
+                /**
+                 * The tick at which the buffer became dirty
+                 **/
+                uint32_t dirtyTick;
+                OSMOS::IO::Block::Buffer *hashNext;
+                OSMOS::IO::Block::Buffer *dirtyPrevious;
+                OSMOS::IO::Block::Buffer *dirtyNext;
+            };
+
+            /**
+             * A transfer of contiguous buffers. It is linked both in the
+             * sorted list and in the FIFO of its direction until it is
+             * dispatched to the driver
+             **/
+            struct Request {
+                /**
+                 * The index of the request in the pool, which drivers can use
+                 * to find their own request state
+                 **/
+                uint32_t identifier;
+                uint8_t type;
+                OSMOS::IO::Block::Device *device;
+                /**
+                 * The index of the first buffer, and the number of buffers
+                 **/
+                uint32_t index;
+                uint32_t count;
+                OSMOS::IO::Block::Buffer *buffers[REQUEST_BUFFER_MAXIMUM];
+                /**
+                 * The tick after which the request is dispatched first
+                 **/
+                uint32_t deadline;
+                OSMOS::IO::Block::Request *sortedPrevious;
+                OSMOS::IO::Block::Request *sortedNext;
+                OSMOS::IO::Block::Request *fifoPrevious;
+                OSMOS::IO::Block::Request *fifoNext;
+            };
+
+            /**
+             * The counters of a device. The hit rate is hits / lookups, the
+             * merge rate is merges / queued and the mean queue depth is
+             * depthTotal / dispatched
+             **/
+            struct Statistics {
+                uint32_t lookups;
+                uint32_t hits;
+                uint32_t misses;
+                uint32_t evictions;
+                /**
+                 * The number of buffers queued, and the number of them which
+                 * joined an existing request
+                 **/
+                uint32_t queued;
+                uint32_t merges;
+                uint32_t dispatched;
+                uint32_t completed;
+                uint32_t errors;
+                uint32_t writeBacks;
+                /**
+                 * The number of requests in flight sampled at each dispatch
+                 **/
+                uint32_t depthTotal;
+                uint32_t depthMaximum;
+            };
+
+            /**
+             * A block device registered by its driver
+             **/
+            struct Device {
+                uint32_t identifier;
+                /**
+                 * The size in bytes of a sector, the unit of the driver
+                 **/
+                uint32_t sectorSize;
+                /**
+                 * The number of whole buffers of the device
+                 **/
+                uint32_t bufferCount;
+                /**
+                 * The maximum number of buffers of a request accepted by the
+                 * driver, and the maximum number of requests in flight
+                 **/
+                uint32_t segmentMaximum;
+                uint32_t queueMaximum;
+                bool readOnly;
+                /**
+                 * Gives requests to the driver, which calls complete for each
+                 * of them once done
+                 * @return the number of requests accepted
+                 **/
+                uint32_t (*submit)(OSMOS::IO::Block::Device *device, OSMOS::IO::Block::Request **requests, uint32_t count);
+                /**
+                 * Completes the requests of a driver without interrupts, or
+                 * NULL if the driver completes them from its interrupt handler
+                 **/
+                void (*poll)(OSMOS::IO::Block::Device *device);
+                /**
+                 * Free for the driver
+                 **/
+                void *driver;
+
+                /**
+                 * The sorted lists and the FIFOs of the pending requests, by
+                 * direction
+                 **/
+                OSMOS::IO::Block::Request *sorted[2];
+                OSMOS::IO::Block::Request *fifoHead[2];
+                OSMOS::IO::Block::Request *fifoTail[2];
+                /**
+                 * The request which accepted the last merge, tried first
+                 **/
+                OSMOS::IO::Block::Request *lastMerge;
+                /**
+                 * The elevator state: the buffer following the last dispatched
+                 * request, the current direction, the number of requests
+                 * dispatched in a row in this direction, and the number of
+                 * read batches which went before pending writes
+                 **/
+                uint32_t position;
+                uint8_t direction;
+                uint32_t batch;
+                uint32_t starved;
+                uint32_t pending;
+                volatile uint32_t inFlight;
+                /**
+                 * The number of requests dispatched at most, lowered to what
+                 * the driver accepted when it refuses a request, and back to
+                 * queueMaximum once the requests in flight are completed
+                 **/
+                uint32_t queueDepth;
+
+                /**
+                 * The dirty buffers, from the oldest to the newest
+                 **/
+                OSMOS::IO::Block::Buffer *dirtyHead;
+                OSMOS::IO::Block::Buffer *dirtyTail;
+                uint32_t dirtyCount;
+
+                OSMOS::IO::Block::Statistics statistics;
+            };
+
+        private:
+            static OSMOS::IO::Block::Device *DEVICES[DEVICE_MAXIMUM];
+            static uint32_t DEVICE_COUNT;
+
+            static OSMOS::IO::Block::Buffer BUFFERS[BUFFER_MAXIMUM];
+            /**
+             * The number of buffers which own a frame
+             **/
+            static uint32_t BUFFER_COUNT;
+            static OSMOS::IO::Block::Buffer *HASH[HASH_SIZE];
+            /**
+             * The next buffer looked at by the clock
+             **/
+            static uint32_t CLOCK_HAND;
+
+            static OSMOS::IO::Block::Request REQUESTS[REQUEST_MAXIMUM];
+            static OSMOS::IO::Block::Request *FREE_REQUESTS;
+
+            /**
+             * The buffer each thread waits for, by thread identifier. A thread
+             * waiting for NULL is woken by any completion
+             **/
+            static OSMOS::IO::Block::Buffer *WAITING[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+            static OSMOS::System::Scheduler::Thread *WAITERS[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+
+            /**
+             * @brief Computes the hash bucket of a block
+             * @param device the device of the block
+             * @param index the index of the block
+             * @return the bucket
+             **/
+            static uint32_t hash(OSMOS::IO::Block::Device *device, uint32_t index);
+            /**
+             * @brief Finds a cached block
+             * @param device the device of the block
+             * @param index the index of the block
+             * @return the buffer, or NULL if the block is not cached
+             **/
+            static OSMOS::IO::Block::Buffer *lookup(OSMOS::IO::Block::Device *device, uint32_t index);
+            /**
+             * @brief Gets a buffer for a block which is not cached, either an
+             * unused one or one evicted by the clock, and hashes it
+             * @param device the device of the block
+             * @param index the index of the block
+             * @return the buffer, or NULL if every buffer is busy
+             **/
+            static OSMOS::IO::Block::Buffer *obtain(OSMOS::IO::Block::Device *device, uint32_t index);
+            /**
+             * @brief Removes a buffer from the hash table
+             * @param buffer the buffer to remove
+             **/
+            static void unhash(OSMOS::IO::Block::Buffer *buffer);
+            /**
+             * @brief Removes a buffer from the dirty list of its device
+             * @param buffer the buffer to remove
+             **/
+            static void undirty(OSMOS::IO::Block::Buffer *buffer);
+
+            /**
+             * @brief Adds a buffer to the elevator, merging it into a pending
+             * request when it is contiguous. The caller has the interrupts
+             * disabled
+             * @param buffer the buffer to transfer, already marked for I/O
+             * @param type the direction of the transfer
+             * @return false if there is no free request
+             **/
+            static bool queue(OSMOS::IO::Block::Buffer *buffer, uint8_t type);
+            /**
+             * @brief Tries to add a buffer at either end of a request, then to
+             * join the request with its neighbour if they became contiguous
+             * @param request the request to extend
+             * @param buffer the buffer to add
+             * @return the request holding the buffer, or NULL if the buffer
+             * has not been merged
+             **/
+            static OSMOS::IO::Block::Request *merge(OSMOS::IO::Block::Request *request, OSMOS::IO::Block::Buffer *buffer);
+            /**
+             * @brief Moves the buffers of a request at the end of the previous
+             * one if they are contiguous, and frees it
+             * @param first the request which is kept
+             * @param second the request which follows it
+             * @return true if the requests have been joined
+             **/
+            static bool coalesce(OSMOS::IO::Block::Request *first, OSMOS::IO::Block::Request *second);
+            /**
+             * @brief Links a request in the sorted list and the FIFO of its
+             * direction
+             * @param request the request to link
+             **/
+            static void insert(OSMOS::IO::Block::Request *request);
+            /**
+             * @brief Unlinks a request from the sorted list and the FIFO of its
+             * direction
+             * @param request the request to unlink
+             **/
+            static void remove(OSMOS::IO::Block::Request *request);
+            /**
+             * @brief Chooses the next request of the elevator
+             * @param device the device
+             * @return the request, or NULL if none is pending
+             **/
+            static OSMOS::IO::Block::Request *choose(OSMOS::IO::Block::Device *device);
+            /**
+             * @brief Gives the chosen requests to the driver, as a single
+             * batch, while the driver has room for them
+             * @param device the device
+             **/
+            static void dispatch(OSMOS::IO::Block::Device *device);
+
+            /**
+             * @brief Waits until a buffer has no I/O in progress
+             * @param buffer the buffer to wait for
+             **/
+            static void wait(OSMOS::IO::Block::Buffer *buffer);
+            /**
+             * @brief Waits until any request completes, or polls once the
+             * devices which have no interrupt
+             **/
+            static void waitAny();
+            /**
+             * @brief Queues the writes of the dirty buffers of a device
+             * @param device the device
+             * @param age the minimal number of ticks since the buffers became
+             * dirty
+             * @return the number of buffers queued
+             **/
+            static uint32_t writeDirty(OSMOS::IO::Block::Device *device, uint32_t age);
+            /**
+             * @brief The write-back thread, which periodically writes the
+             * buffers dirty for too long
+             * @param argument unused
+             **/
+            static void writeBack(void *argument);
+
+        public:
+            /**
+             * @brief Initializes the cache and starts the write-back thread
+             **/
+            static void initialize();
+            /**
+             * @brief Registers a device. The driver fills the geometry, the
+             * limits and the operations; the rest is reset
+             * @param device the device to register
+             * @return false if there are too many devices
+             **/
+            static bool attach(OSMOS::IO::Block::Device *device);
+            /**
+             * @brief Gets the number of registered devices
+             * @return the number of devices
+             **/
+            static uint32_t getDeviceCount();
+            /**
+             * @brief Gets a registered device
+             * @param index the index of the device
+             * @return the device, or NULL if the index is out of range
+             **/
+            static OSMOS::IO::Block::Device *getDevice(uint32_t index);
+
+            /**
+             * @brief Reads a block through the cache. A cached block is
+             * returned without touching the device
+             * @param device the device to read
+             * @param index the index of the block
+             * @return the buffer, referenced until release is called, or NULL
+             * if the block cannot be read
+             **/
+            static OSMOS::IO::Block::Buffer *read(OSMOS::IO::Block::Device *device, uint32_t index);
+            /**
+             * @brief Starts reading blocks which are not cached yet, without
+             * waiting for them. The reads are merged into few requests
+             * @param device the device to read
+             * @param index the index of the first block
+             * @param count the number of blocks
+             * @return the number of reads started
+             **/
+            static uint32_t prefetch(OSMOS::IO::Block::Device *device, uint32_t index, uint32_t count);
+            /**
+             * @brief Reads contiguous blocks straight into frames of the
+             * caller, without caching them. A cached block is copied from its
+             * buffer instead, since it may be newer than the device
+             * @param device the device to read
+             * @param index the index of the first block
+             * @param frames the frames to read to, of BUFFER_SIZE bytes each
+             * @param count the number of blocks, at most REQUEST_BUFFER_MAXIMUM
+             * @return false if a block cannot be read
+             **/
+            static bool readFrames(OSMOS::IO::Block::Device *device, uint32_t index, uint8_t **frames, uint32_t count);
+            /**
+             * @brief Marks a modified buffer to be written back
+             * @param buffer the buffer, which must be referenced
+             **/
+            static void markDirty(OSMOS::IO::Block::Buffer *buffer);
+            /**
+             * @brief Releases a buffer returned by read
+             * @param buffer the buffer to release
+             **/
+            static void release(OSMOS::IO::Block::Buffer *buffer);
+            /**
+             * @brief Writes every dirty buffer of a device and waits for them.
+             * A buffer whose write failed stays dirty
+             * @param device the device to flush
+             * @return false if a write failed
+             **/
+            static bool flush(OSMOS::IO::Block::Device *device);
+            /**
+             * @brief Gives back the frames of clean and unused buffers. It is
+             * registered as a reclaimer of the frame allocator
+             * @param count the number of frames wanted
+             * @return the number of frames freed
+             **/
+            static uint32_t shrink(uint32_t count);
+
+            /**
+             * @brief Completes a request. It is called by the drivers,
+             * usually from their interrupt handler
+             * @param request the completed request
+             * @param success true if the transfer succeeded
+             **/
+            static void complete(OSMOS::IO::Block::Request *request, bool success);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,413 @@
+/*
+ * The framebuffer console class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "console.hpp"
+
+#include "timer.hpp"
+#include "../sys/fpu.hpp"
+#include "../sys/frame.hpp"
+#include "../sys/paging.hpp"
+#include "../sys/scheduler.hpp"
+
+uint8_t OSMOS::IO::Console::COLOR_BLACK                     = 0;
+uint8_t OSMOS::IO::Console::COLOR_BLUE                      = 1;
+uint8_t OSMOS::IO::Console::COLOR_GREEN                     = 2;
+uint8_t OSMOS::IO::Console::COLOR_CYAN                      = 3;
+uint8_t OSMOS::IO::Console::COLOR_RED                       = 4;
+uint8_t OSMOS::IO::Console::COLOR_MAGENTA                   = 5;
+uint8_t OSMOS::IO::Console::COLOR_BROWN                     = 6;
+uint8_t OSMOS::IO::Console::COLOR_LIGHT_GRAY                = 7;
+uint8_t OSMOS::IO::Console::COLOR_DARK_GRAY                 = 8;
+uint8_t OSMOS::IO::Console::COLOR_LIGHT_BLUE                = 9;
+uint8_t OSMOS::IO::Console::COLOR_LIGHT_GREEN               = 10;
+uint8_t OSMOS::IO::Console::COLOR_LIGHT_CYAN                = 11;
+uint8_t OSMOS::IO::Console::COLOR_LIGHT_RED                 = 12;
+uint8_t OSMOS::IO::Console::COLOR_LIGHT_MAGENTA             = 13;
+uint8_t OSMOS::IO::Console::COLOR_YELLOW                    = 14;
+uint8_t OSMOS::IO::Console::COLOR_WHITE                     = 15;
+
+uint8_t *OSMOS::IO::Console::FRAMEBUFFER                    = NULL;
+uint32_t OSMOS::IO::Console::PITCH                          = 0;
+uint32_t *OSMOS::IO::Console::SHADOW                        = NULL;
+uint32_t OSMOS::IO::Console::COLUMNS                        = 0;
+uint32_t OSMOS::IO::Console::LINES                          = 0;
+uint32_t OSMOS::IO::Console::TOP                            = 0;
+uint32_t OSMOS::IO::Console::COLUMN                         = 0;
+uint32_t OSMOS::IO::Console::LINE                           = 0;
+uint16_t OSMOS::IO::Console::DIRTY_START[OSMOS::IO::Console::LINE_MAXIMUM];
+uint16_t OSMOS::IO::Console::DIRTY_END[OSMOS::IO::Console::LINE_MAXIMUM];
+bool OSMOS::IO::Console::REPAINT                            = false;
+uint32_t OSMOS::IO::Console::REPAINT_TICK                   = 0;
+uint32_t OSMOS::IO::Console::PALETTE[OSMOS::IO::Console::COLOR_COUNT];
+uint8_t OSMOS::IO::Console::FOREGROUND                      = 0;
+uint8_t OSMOS::IO::Console::BACKGROUND                      = 0;
+OSMOS::IO::Console::Cache OSMOS::IO::Console::CACHES[OSMOS::IO::Console::CACHE_MAXIMUM];
+OSMOS::IO::Console::Cache *OSMOS::IO::Console::CACHE        = NULL;
+uint32_t OSMOS::IO::Console::CACHE_STAMP                    = 0;
+bool OSMOS::IO::Console::WIDE                               = false;
+bool OSMOS::IO::Console::READY                              = false;
+OSMOS::IO::Console::Statistics OSMOS::IO::Console::STATISTICS;
+
+// The colors of the palette, as 0xRRGGBB
+static const uint32_t CONSOLE_COLORS[OSMOS::IO::Console::COLOR_COUNT] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF
+};
+
+// The size in bytes of a pixel of the shadow buffer and of the video memory
+#define CONSOLE_PIXEL_SIZE                                  4
+
+// Fills words with a value (rep stosd)
+static inline void consoleFill(uint32_t *target, uint32_t count, uint32_t value) {
+    asm volatile("rep stosd"
+                : "+D" (target), "+c" (count)
+                : "a" (value)
+                : "memory");
+}
+
+// Packs a color into the fields of a pixel
+static uint32_t consolePack(uint32_t color, OSMOS::System::Multiboot::Framebuffer *framebuffer) {
+    uint32_t red = (color >> 16) & 0xFF;
+    uint32_t green = (color >> 8) & 0xFF;
+    uint32_t blue = color & 0xFF;
+
+    return ((red >> (8 - framebuffer->redSize)) << framebuffer->redPosition)
+         | ((green >> (8 - framebuffer->greenSize)) << framebuffer->greenPosition)
+         | ((blue >> (8 - framebuffer->blueSize)) << framebuffer->bluePosition);
+}
+
+bool OSMOS::IO::Console::initialize(OSMOS::System::Multiboot::Framebuffer *framebuffer) {
+    if (framebuffer == NULL || framebuffer->type != OSMOS::System::Multiboot::FRAMEBUFFER_RGB || framebuffer->depth != 32)
+        return false;
+
+    if ((framebuffer->address >> 32) != 0 || framebuffer->redSize > 8 || framebuffer->greenSize > 8 || framebuffer->blueSize > 8)
+        return false;
+
+    // The user area is not mapped in the kernel space
+    address_t address = (address_t) framebuffer->address;
+    uint32_t size = framebuffer->pitch * framebuffer->height;
+    if (address + size > OSMOS::System::Paging::USER_BASE && address < OSMOS::System::Paging::USER_LIMIT)
+        return false;
+
+    OSMOS::IO::Console::COLUMNS = framebuffer->width / OSMOS::IO::Console::CELL_WIDTH;
+    OSMOS::IO::Console::LINES = framebuffer->height / OSMOS::IO::Console::CELL_HEIGHT;
+    if (OSMOS::IO::Console::LINES > OSMOS::IO::Console::LINE_MAXIMUM)
+        OSMOS::IO::Console::LINES = OSMOS::IO::Console::LINE_MAXIMUM;
+
+    if (OSMOS::IO::Console::COLUMNS == 0 || OSMOS::IO::Console::LINES == 0)
+        return false;
+
+    uint32_t shadowSize = OSMOS::IO::Console::LINES * OSMOS::IO::Console::CELL_HEIGHT * OSMOS::IO::Console::COLUMNS * OSMOS::IO::Console::CELL_WIDTH * CONSOLE_PIXEL_SIZE;
+    OSMOS::IO::Console::SHADOW = (uint32_t *) OSMOS::System::Frame::allocate((shadowSize + OSMOS::System::Frame::FRAME_SIZE - 1) / OSMOS::System::Frame::FRAME_SIZE);
+    if (OSMOS::IO::Console::SHADOW == NULL)
+        return false;
+
+    OSMOS::System::Paging::enableWriteCombining(address, size);
+
+    OSMOS::IO::Console::FRAMEBUFFER = (uint8_t *) address;
+    OSMOS::IO::Console::PITCH = framebuffer->pitch;
+    OSMOS::IO::Console::WIDE = OSMOS::System::FPU::isEnabled() && (address % 16) == 0 && (framebuffer->pitch % 16) == 0;
+
+    for (uint32_t i = 0; i < OSMOS::IO::Console::COLOR_COUNT; i++)
+        OSMOS::IO::Console::PALETTE[i] = consolePack(CONSOLE_COLORS[i], framebuffer);
+
+    for (uint32_t i = 0; i < OSMOS::IO::Console::CACHE_MAXIMUM; i++)
+        OSMOS::IO::Console::CACHES[i].used = false;
+
+    OSMOS::IO::Console::STATISTICS.characters = 0;
+    OSMOS::IO::Console::STATISTICS.scrolls = 0;
+    OSMOS::IO::Console::STATISTICS.rendered = 0;
+    OSMOS::IO::Console::STATISTICS.flushes = 0;
+    OSMOS::IO::Console::STATISTICS.repaints = 0;
+    OSMOS::IO::Console::STATISTICS.written = 0;
+
+    OSMOS::IO::Console::READY = true;
+    OSMOS::IO::Console::setColor(OSMOS::IO::Console::COLOR_LIGHT_GRAY, OSMOS::IO::Console::COLOR_BLACK);
+    OSMOS::IO::Console::clear();
+
+    return true;
+}
+
+bool OSMOS::IO::Console::startFlusher() {
+    if (!OSMOS::IO::Console::READY)
+        return false;
+
+    return OSMOS::System::Scheduler::create(OSMOS::IO::Console::runFlusher, NULL) != NULL;
+}
+
+bool OSMOS::IO::Console::isReady() {
+    return OSMOS::IO::Console::READY;
+}
+
+void OSMOS::IO::Console::runFlusher(void *) {
+    for (;;) {
+        OSMOS::System::Scheduler::sleep(OSMOS::IO::Console::REPAINT_TICKS);
+
+        if (OSMOS::IO::Console::REPAINT)
+            OSMOS::IO::Console::flush();
+    }
+}
+
+void OSMOS::IO::Console::setColor(uint8_t foreground, uint8_t background) {
+    OSMOS::IO::Console::FOREGROUND = foreground % OSMOS::IO::Console::COLOR_COUNT;
+    OSMOS::IO::Console::BACKGROUND = background % OSMOS::IO::Console::COLOR_COUNT;
+
+    if (OSMOS::IO::Console::READY)
+        OSMOS::IO::Console::selectCache();
+}
+
+void OSMOS::IO::Console::selectCache() {
+    OSMOS::IO::Console::Cache *replaced = &OSMOS::IO::Console::CACHES[0];
+
+    OSMOS::IO::Console::CACHE_STAMP++;
+
+    for (uint32_t i = 0; i < OSMOS::IO::Console::CACHE_MAXIMUM; i++) {
+        OSMOS::IO::Console::Cache *cache = &OSMOS::IO::Console::CACHES[i];
+
+        if (cache->used && cache->foreground == OSMOS::IO::Console::FOREGROUND && cache->background == OSMOS::IO::Console::BACKGROUND) {
+            cache->stamp = OSMOS::IO::Console::CACHE_STAMP;
+            OSMOS::IO::Console::CACHE = cache;
+            return;
+        }
+
+        if (replaced->used && (!cache->used || cache->stamp < replaced->stamp))
+            replaced = cache;
+    }
+
+    // The glyphs are rendered again as they are drawn
+    for (uint32_t i = 0; i < sizeof(replaced->rendered) / sizeof(replaced->rendered[0]); i++)
+        replaced->rendered[i] = 0;
+
+    replaced->foreground = OSMOS::IO::Console::FOREGROUND;
+    replaced->background = OSMOS::IO::Console::BACKGROUND;
+    replaced->used = true;
+    replaced->stamp = OSMOS::IO::Console::CACHE_STAMP;
+    OSMOS::IO::Console::CACHE = replaced;
+}
+
+const uint32_t *OSMOS::IO::Console::getGlyph(uint8_t character) {
+    if (character < OSMOS::IO::Font::FIRST || character >= OSMOS::IO::Font::FIRST + OSMOS::IO::Font::COUNT)
+        character = '?';
+
+    OSMOS::IO::Console::Cache *cache = OSMOS::IO::Console::CACHE;
+    uint32_t index = character - OSMOS::IO::Font::FIRST;
+    uint32_t *pixels = cache->pixels[index];
+
+    if (cache->rendered[index / 32] & (1U << (index % 32)))
+        return pixels;
+
+    const uint8_t *glyph = OSMOS::IO::Font::getGlyph(character);
+    uint32_t foreground = OSMOS::IO::Console::PALETTE[cache->foreground];
+    uint32_t background = OSMOS::IO::Console::PALETTE[cache->background];
+
+    for (uint32_t y = 0; y < OSMOS::IO::Console::CELL_HEIGHT; y++) {
+        uint8_t bits = glyph[y * OSMOS::IO::Font::GLYPH_HEIGHT / OSMOS::IO::Console::CELL_HEIGHT];
+
+        for (uint32_t x = 0; x < OSMOS::IO::Console::CELL_WIDTH; x++)
+            pixels[y * OSMOS::IO::Console::CELL_WIDTH + x] = (bits & (0x80 >> x)) ? foreground : background;
+    }
+
+    cache->rendered[index / 32] |= 1U << (index % 32);
+    OSMOS::IO::Console::STATISTICS.rendered++;
+
+    return pixels;
+}
+
+uint32_t *OSMOS::IO::Console::getLine(uint32_t line) {
+    uint32_t index = (OSMOS::IO::Console::TOP + line) % OSMOS::IO::Console::LINES;
+
+    return OSMOS::IO::Console::SHADOW + index * OSMOS::IO::Console::CELL_HEIGHT * OSMOS::IO::Console::COLUMNS * OSMOS::IO::Console::CELL_WIDTH;
+}
+
+void OSMOS::IO::Console::markDirty(uint32_t line, uint32_t start, uint32_t end) {
+    if (start < OSMOS::IO::Console::DIRTY_START[line])
+        OSMOS::IO::Console::DIRTY_START[line] = (uint16_t) start;
+
+    if (end > OSMOS::IO::Console::DIRTY_END[line])
+        OSMOS::IO::Console::DIRTY_END[line] = (uint16_t) end;
+}
+
+void OSMOS::IO::Console::clearLine(uint32_t line) {
+    consoleFill(OSMOS::IO::Console::getLine(line), OSMOS::IO::Console::CELL_HEIGHT * OSMOS::IO::Console::COLUMNS * OSMOS::IO::Console::CELL_WIDTH, OSMOS::IO::Console::PALETTE[OSMOS::IO::Console::BACKGROUND]);
+}
+
+void OSMOS::IO::Console::scroll() {
+    OSMOS::IO::Console::TOP = (OSMOS::IO::Console::TOP + 1) % OSMOS::IO::Console::LINES;
+    OSMOS::IO::Console::clearLine(OSMOS::IO::Console::LINES - 1);
+
+    // Every line of the screen has moved
+    OSMOS::IO::Console::REPAINT = true;
+    OSMOS::IO::Console::STATISTICS.scrolls++;
+}
+
+void OSMOS::IO::Console::put(uint8_t character) {
+    OSMOS::IO::Console::STATISTICS.characters++;
+
+    switch (character) {
+        case '\n':
+            OSMOS::IO::Console::COLUMN = 0;
+            OSMOS::IO::Console::LINE++;
+            break;
+        case '\r':
+            OSMOS::IO::Console::COLUMN = 0;
+            break;
+        case '\t':
+            OSMOS::IO::Console::COLUMN = (OSMOS::IO::Console::COLUMN / OSMOS::IO::Console::TAB_SIZE + 1) * OSMOS::IO::Console::TAB_SIZE;
+            break;
+        case '\b':
+            if (OSMOS::IO::Console::COLUMN > 0)
+                OSMOS::IO::Console::COLUMN--;
+            break;
+        default: {
+            if (OSMOS::IO::Console::COLUMN >= OSMOS::IO::Console::COLUMNS) {
+                OSMOS::IO::Console::COLUMN = 0;
+                OSMOS::IO::Console::LINE++;
+            }
+
+            if (OSMOS::IO::Console::LINE >= OSMOS::IO::Console::LINES) {
+                OSMOS::IO::Console::scroll();
+                OSMOS::IO::Console::LINE = OSMOS::IO::Console::LINES - 1;
+            }
+
+            const uint32_t *glyph = OSMOS::IO::Console::getGlyph(character);
+            uint32_t stride = OSMOS::IO::Console::COLUMNS * OSMOS::IO::Console::CELL_WIDTH;
+            uint32_t *target = OSMOS::IO::Console::getLine(OSMOS::IO::Console::LINE) + OSMOS::IO::Console::COLUMN * OSMOS::IO::Console::CELL_WIDTH;
+
+            for (uint32_t y = 0; y < OSMOS::IO::Console::CELL_HEIGHT; y++) {
+                for (uint32_t x = 0; x < OSMOS::IO::Console::CELL_WIDTH; x++)
+                    target[x] = glyph[x];
+
+                target += stride;
+                glyph += OSMOS::IO::Console::CELL_WIDTH;
+            }
+
+            OSMOS::IO::Console::markDirty(OSMOS::IO::Console::LINE, OSMOS::IO::Console::COLUMN, OSMOS::IO::Console::COLUMN + 1);
+            OSMOS::IO::Console::COLUMN++;
+            return;
+        }
+    }
+
+    // The cursor is moved to the next line lazily for the wrapped characters,
+    // but right away for a new line
+    if (OSMOS::IO::Console::LINE >= OSMOS::IO::Console::LINES) {
+        OSMOS::IO::Console::scroll();
+        OSMOS::IO::Console::LINE = OSMOS::IO::Console::LINES - 1;
+    }
+}
+
+void OSMOS::IO::Console::write(const char *string) {
+    if (!OSMOS::IO::Console::READY)
+        return;
+
+    for (; *string != '\0'; string++)
+        OSMOS::IO::Console::put((uint8_t) *string);
+
+    // The dirty cells are cheap to copy, while the repaints are batched
+    if (!OSMOS::IO::Console::REPAINT || OSMOS::IO::Timer::getTicks() - OSMOS::IO::Console::REPAINT_TICK >= OSMOS::IO::Console::REPAINT_TICKS)
+        OSMOS::IO::Console::flush();
+}
+
+void OSMOS::IO::Console::clear() {
+    if (!OSMOS::IO::Console::READY)
+        return;
+
+    for (uint32_t line = 0; line < OSMOS::IO::Console::LINES; line++)
+        OSMOS::IO::Console::clearLine(line);
+
+    OSMOS::IO::Console::COLUMN = 0;
+    OSMOS::IO::Console::LINE = 0;
+    OSMOS::IO::Console::REPAINT = true;
+    OSMOS::IO::Console::flush();
+}
+
+void OSMOS::IO::Console::copyRow(uint8_t *target, const uint32_t *source, uint32_t length) {
+    // The non-temporal stores skip the caches, and fill whole write-combining
+    // lines. A cell row is 32 bytes, so the length is a multiple of it
+    if (OSMOS::IO::Console::WIDE) {
+        asm volatile("1:\n \
+                      movdqa xmm0, [%[source]]\n \
+                      movdqa xmm1, [%[source] + 16]\n \
+                      movntdq [%[target]], xmm0\n \
+                      movntdq [%[target] + 16], xmm1\n \
+                      add %[source], 32\n \
+                      add %[target], 32\n \
+                      sub %[length], 32\n \
+                      jnz 1b"
+                    : [target] "+r" (target), [source] "+r" (source), [length] "+r" (length)
+                    :
+                    : "memory");
+        return;
+    }
+
+    length /= CONSOLE_PIXEL_SIZE;
+    asm volatile("rep movsd"
+                : "+D" (target), "+S" (source), "+c" (length)
+                :
+                : "memory");
+}
+
+void OSMOS::IO::Console::flush() {
+    if (!OSMOS::IO::Console::READY)
+        return;
+
+    bool repaint = OSMOS::IO::Console::REPAINT;
+    uint32_t stride = OSMOS::IO::Console::COLUMNS * OSMOS::IO::Console::CELL_WIDTH;
+
+    if (OSMOS::IO::Console::WIDE)
+        OSMOS::System::FPU::beginKernelSection();
+
+    for (uint32_t line = 0; line < OSMOS::IO::Console::LINES; line++) {
+        uint32_t start = (repaint ? 0 : OSMOS::IO::Console::DIRTY_START[line]);
+        uint32_t end = (repaint ? OSMOS::IO::Console::COLUMNS : OSMOS::IO::Console::DIRTY_END[line]);
+
+        OSMOS::IO::Console::DIRTY_START[line] = (uint16_t) OSMOS::IO::Console::COLUMNS;
+        OSMOS::IO::Console::DIRTY_END[line] = 0;
+
+        if (start >= end)
+            continue;
+
+        const uint32_t *source = OSMOS::IO::Console::getLine(line) + start * OSMOS::IO::Console::CELL_WIDTH;
+        uint8_t *target = OSMOS::IO::Console::FRAMEBUFFER + line * OSMOS::IO::Console::CELL_HEIGHT * OSMOS::IO::Console::PITCH + start * OSMOS::IO::Console::CELL_WIDTH * CONSOLE_PIXEL_SIZE;
+        uint32_t length = (end - start) * OSMOS::IO::Console::CELL_WIDTH * CONSOLE_PIXEL_SIZE;
+
+        for (uint32_t y = 0; y < OSMOS::IO::Console::CELL_HEIGHT; y++) {
+            OSMOS::IO::Console::copyRow(target, source, length);
+            target += OSMOS::IO::Console::PITCH;
+            source += stride;
+        }
+
+        OSMOS::IO::Console::STATISTICS.written += length * OSMOS::IO::Console::CELL_HEIGHT;
+    }
+
+    if (OSMOS::IO::Console::WIDE) {
+        asm volatile("sfence" : : : "memory");
+        OSMOS::System::FPU::endKernelSection();
+    }
+
+    if (repaint) {
+        OSMOS::IO::Console::REPAINT = false;
+        OSMOS::IO::Console::REPAINT_TICK = OSMOS::IO::Timer::getTicks();
+        OSMOS::IO::Console::STATISTICS.repaints++;
+    }
+
+    OSMOS::IO::Console::STATISTICS.flushes++;
+}
+
+OSMOS::IO::Console::Statistics *OSMOS::IO::Console::getStatistics() {
+    return &OSMOS::IO::Console::STATISTICS;
+}
\ No newline at end of file
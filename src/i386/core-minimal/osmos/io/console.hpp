@@ -0,0 +1,276 @@
+/*
+ * The framebuffer console class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONSOLE_HPP
+#define CONSOLE_HPP
+
+#include "../osmos.hpp"
+
+#include "font.hpp"
+#include "../sys/multiboot.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief Console's class that draws text on the framebuffer set up by
+         * the loader. The text is drawn in a shadow buffer in memory, so the
+         * slow video memory is only written, never read. The lines of the
+         * shadow buffer form a ring, so scrolling moves no pixel in memory.
+         * The glyphs are drawn from caches of pixels rendered once per pair of
+         * colors, and only the dirty part of each line is copied to the video
+         * memory, with SSE non-temporal stores when available. The repaints of
+         * a scrolled screen are batched by a flusher thread
+         **/
+        class Console {
+        public:
+            /**
+             * The size in pixels of a character cell. The rows of the font are
+             * doubled
+             **/
+            static const uint32_t CELL_WIDTH = 8;
+            static const uint32_t CELL_HEIGHT = 16;
+            /**
+             * The maximum number of lines of the console
+             **/
+            static const uint32_t LINE_MAXIMUM = 256;
+            /**
+             * The number of pairs of colors whose glyphs are cached
+             **/
+            static const uint32_t CACHE_MAXIMUM = 4;
+            /**
+             * The number of colors of the palette
+             **/
+            static const uint32_t COLOR_COUNT = 16;
+            /**
+             * The minimum number of timer ticks between two repaints of the
+             * whole screen. The scrolls in between are batched
+             **/
+            static const uint32_t REPAINT_TICKS = 20;
+            /**
+             * The width in characters of a tabulation
+             **/
+            static const uint32_t TAB_SIZE = 8;
+
+            /**
+             * The colors of the palette, those of the VGA text mode
+             **/
+            static uint8_t COLOR_BLACK;
+            static uint8_t COLOR_BLUE;
+            static uint8_t COLOR_GREEN;
+            static uint8_t COLOR_CYAN;
+            static uint8_t COLOR_RED;
+            static uint8_t COLOR_MAGENTA;
+            static uint8_t COLOR_BROWN;
+            static uint8_t COLOR_LIGHT_GRAY;
+            static uint8_t COLOR_DARK_GRAY;
+            static uint8_t COLOR_LIGHT_BLUE;
+            static uint8_t COLOR_LIGHT_GREEN;
+            static uint8_t COLOR_LIGHT_CYAN;
+            static uint8_t COLOR_LIGHT_RED;
+            static uint8_t COLOR_LIGHT_MAGENTA;
+            static uint8_t COLOR_YELLOW;
+            static uint8_t COLOR_WHITE;
+
+            /**
+             * The glyphs rendered for a pair of colors
+             **/
+            struct Cache {
+                uint32_t pixels[OSMOS::IO::Font::COUNT][CELL_WIDTH * CELL_HEIGHT];
+                /**
+                 * A bit per glyph, set once it is rendered
+                 **/
+                uint32_t rendered[(OSMOS::IO::Font::COUNT + 31) / 32];
+                uint8_t foreground;
+                uint8_t background;
+                bool used;
+                /**
+                 * The last use of the cache, to replace the least recently used
+                 **/
+                uint32_t stamp;
+            };
+
+            /**
+             * The counters of the console
+             **/
+            struct Statistics {
+                uint32_t characters;
+                uint32_t scrolls;
+                /**
+                 * The glyphs rendered in a cache
+                 **/
+                uint32_t rendered;
+                uint32_t flushes;
+                uint32_t repaints;
+                /**
+                 * The number of bytes written to the video memory
+                 **/
+                uint32_t written;
+            };
+
+        private:
+            /**
+             * The video memory and the number of bytes between two rows
+             **/
+            static uint8_t *FRAMEBUFFER;
+            static uint32_t PITCH;
+            /**
+             * The shadow buffer: LINES lines of CELL_HEIGHT rows of COLUMNS
+             * cells. The line TOP is shown at the top of the screen
+             **/
+            static uint32_t *SHADOW;
+            static uint32_t COLUMNS;
+            static uint32_t LINES;
+            static uint32_t TOP;
+            /**
+             * The position of the cursor on the screen
+             **/
+            static uint32_t COLUMN;
+            static uint32_t LINE;
+            /**
+             * The dirty cells of each line of the screen, from the start to
+             * the end column. A repaint copies every line
+             **/
+            static uint16_t DIRTY_START[LINE_MAXIMUM];
+            static uint16_t DIRTY_END[LINE_MAXIMUM];
+            static bool REPAINT;
+            static uint32_t REPAINT_TICK;
+
+            static uint32_t PALETTE[COLOR_COUNT];
+            static uint8_t FOREGROUND;
+            static uint8_t BACKGROUND;
+            static OSMOS::IO::Console::Cache CACHES[CACHE_MAXIMUM];
+            static OSMOS::IO::Console::Cache *CACHE;
+            static uint32_t CACHE_STAMP;
+
+            /**
+             * Whether the copies to the video memory use the SSE registers
+             **/
+            static bool WIDE;
+            static bool READY;
+            static OSMOS::IO::Console::Statistics STATISTICS;
+
+            /**
+             * @brief Selects the cache of the current colors, reusing the least
+             * recently used one if none matches
+             **/
+            static void selectCache();
+            /**
+             * @brief Gets the pixels of a glyph in the current colors,
+             * rendering them if they are not cached
+             * @param character the character
+             * @return the pixels of the cell, row by row
+             **/
+            static const uint32_t *getGlyph(uint8_t character);
+            /**
+             * @brief Gets the shadow buffer of a line of the screen
+             * @param line the line of the screen
+             * @return the first pixel of the line
+             **/
+            static uint32_t *getLine(uint32_t line);
+            /**
+             * @brief Marks cells of a line of the screen as dirty
+             * @param line the line of the screen
+             * @param start the first column
+             * @param end the column after the last one
+             **/
+            static void markDirty(uint32_t line, uint32_t start, uint32_t end);
+            /**
+             * @brief Fills a line of the shadow buffer with the background
+             * @param line the line of the screen
+             **/
+            static void clearLine(uint32_t line);
+            /**
+             * @brief Scrolls the screen by a line: the top line of the ring
+             * becomes the cleared bottom line
+             **/
+            static void scroll();
+            /**
+             * @brief Draws a character at the cursor, or moves the cursor for
+             * the control characters, without flushing
+             * @param character the character
+             **/
+            static void put(uint8_t character);
+            /**
+             * @brief Copies a row of pixels of the shadow buffer to the video
+             * memory
+             * @param target the video memory
+             * @param source the shadow buffer
+             * @param length the number of bytes, a multiple of a cell row
+             **/
+            static void copyRow(uint8_t *target, const uint32_t *source, uint32_t length);
+            /**
+             * @brief The function of the flusher thread, which repaints the
+             * scrolled screen every REPAINT_TICKS
+             **/
+            static void runFlusher(void *argument);
+
+        public:
+            /**
+             * @brief Sets up the console on a framebuffer, allocates its shadow
+             * buffer and clears the screen. The video memory is made write
+             * combining if the processor allows it
+             * @param framebuffer the framebuffer tag of the loader
+             * @return false if the framebuffer is not a 32-bit RGB one reachable
+             * by the kernel, or if the shadow buffer could not be allocated
+             **/
+            static bool initialize(OSMOS::System::Multiboot::Framebuffer *framebuffer);
+            /**
+             * @brief Starts the flusher thread. Until then, the scrolled screen
+             * is only repainted by the writes
+             * @return false if the thread could not be created
+             **/
+            static bool startFlusher();
+            /**
+             * @brief Checks if the console has been set up
+             * @return true if initialize succeeded
+             **/
+            static bool isReady();
+
+            /**
+             * @brief Sets the colors of the next characters
+             * @param foreground the color of the characters
+             * @param background the color behind them
+             **/
+            static void setColor(uint8_t foreground, uint8_t background);
+            /**
+             * @brief Writes a string at the cursor, then copies the dirty cells
+             * to the video memory. A repaint of the whole screen is left to the
+             * flusher thread if the last one is too recent
+             * @param string the string, ended by a null character
+             **/
+            static void write(const char *string);
+            /**
+             * @brief Clears the screen and moves the cursor to its top
+             **/
+            static void clear();
+            /**
+             * @brief Copies the dirty cells, or the whole screen if it has
+             * scrolled, to the video memory
+             **/
+            static void flush();
+
+            /**
+             * @brief Gets the counters of the console
+             * @return the counters
+             **/
+            static OSMOS::IO::Console::Statistics *getStatistics();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+ * The console font class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FONT_HPP
+#define FONT_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief Font's class that holds the bitmap font of the console: the
+         * printable ASCII characters, drawn on 5 by 7 pixels with a row below
+         * for the descenders, in cells of 8 by 8 pixels
+         **/
+        class Font {
+        public:
+            /**
+             * The size in pixels of a glyph. Each row is a byte, whose most
+             * significant bit is the leftmost pixel
+             **/
+            static const uint32_t GLYPH_WIDTH = 8;
+            static const uint32_t GLYPH_HEIGHT = 8;
+            /**
+             * The first character of the font and the number of characters
+             **/
+            static const uint8_t FIRST = 0x20;
+            static const uint32_t COUNT = 95;
+
+        private:
+            static const uint8_t GLYPHS[COUNT][GLYPH_HEIGHT];
+
+        public:
+            /**
+             * @brief Gets the glyph of a character
+             * @param character the character
+             * @return the rows of the glyph, the one of '?' if the character is
+             * not in the font
+             **/
+            static const uint8_t *getGlyph(uint8_t character);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,190 @@
+/*
+ * The PCI (Peripheral Component Interconnect) bus class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pci.hpp"
+
+#include "port.hpp"
+
+uint8_t OSMOS::IO::PCI::BAR_TYPE_MEMORY                     = 0;
+uint8_t OSMOS::IO::PCI::BAR_TYPE_IO                         = 1;
+
+uint16_t OSMOS::IO::PCI::COMMAND_IO_SPACE                   = 1 << 0;
+uint16_t OSMOS::IO::PCI::COMMAND_MEMORY_SPACE               = 1 << 1;
+uint16_t OSMOS::IO::PCI::COMMAND_BUS_MASTER                 = 1 << 2;
+
+OSMOS::IO::PCI::Device OSMOS::IO::PCI::DEVICES[OSMOS::IO::PCI::DEVICE_MAXIMUM];
+uint32_t OSMOS::IO::PCI::DEVICE_COUNT                       = 0;
+
+uint32_t OSMOS::IO::PCI::read(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset) {
+    uint32_t value;
+
+    OSMOS::IO::Port::out((uint16_t) 0xCF8, (uint32_t) (0x80000000 | (bus << 16) | ((slot & 0x1F) << 11) | ((function & 0x07) << 8) | (offset & 0xFC)));
+    OSMOS::IO::Port::in((uint16_t) 0xCFC, &value);
+
+    return value;
+}
+
+void OSMOS::IO::PCI::write(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value) {
+    OSMOS::IO::Port::out((uint16_t) 0xCF8, (uint32_t) (0x80000000 | (bus << 16) | ((slot & 0x1F) << 11) | ((function & 0x07) << 8) | (offset & 0xFC)));
+    OSMOS::IO::Port::out((uint16_t) 0xCFC, value);
+}
+
+uint32_t OSMOS::IO::PCI::read(OSMOS::IO::PCI::Device *device, uint8_t offset) {
+    return OSMOS::IO::PCI::read(device->bus, device->slot, device->function, offset);
+}
+
+void OSMOS::IO::PCI::write(OSMOS::IO::PCI::Device *device, uint8_t offset, uint32_t value) {
+    OSMOS::IO::PCI::write(device->bus, device->slot, device->function, offset, value);
+}
+
+void OSMOS::IO::PCI::probe(uint8_t bus, uint8_t slot, uint8_t function) {
+    if (OSMOS::IO::PCI::DEVICE_COUNT >= OSMOS::IO::PCI::DEVICE_MAXIMUM)
+        return;
+
+    OSMOS::IO::PCI::Device *device = &OSMOS::IO::PCI::DEVICES[OSMOS::IO::PCI::DEVICE_COUNT++];
+    device->bus = bus;
+    device->slot = slot;
+    device->function = function;
+
+    uint32_t identifier = OSMOS::IO::PCI::read(device, 0x00);
+    device->vendor = identifier & 0xFFFF;
+    device->device = identifier >> 16;
+
+    uint32_t classes = OSMOS::IO::PCI::read(device, 0x08);
+    device->revision = classes & 0xFF;
+    device->interface = (classes >> 8) & 0xFF;
+    device->subclass = (classes >> 16) & 0xFF;
+    device->classCode = classes >> 24;
+    device->headerType = (OSMOS::IO::PCI::read(device, 0x0C) >> 16) & 0xFF;
+
+    uint32_t interrupt = OSMOS::IO::PCI::read(device, 0x3C);
+    device->interruptLine = interrupt & 0xFF;
+    device->interruptPin = (interrupt >> 8) & 0xFF;
+
+    // Only the general devices have 6 BARs and a subsystem, the bridges have
+    // 2 BARs and no subsystem
+    uint32_t barCount = 0;
+    device->subsystem = 0;
+    if ((device->headerType & 0x7F) == 0x00) {
+        barCount = OSMOS::IO::PCI::BAR_COUNT;
+        device->subsystem = OSMOS::IO::PCI::read(device, 0x2C) >> 16;
+    } else if ((device->headerType & 0x7F) == 0x01)
+        barCount = 2;
+
+    for (uint32_t i = 0; i < OSMOS::IO::PCI::BAR_COUNT; i++) {
+        device->bars[i].address = 0;
+        device->bars[i].size = 0;
+        device->bars[i].type = OSMOS::IO::PCI::BAR_TYPE_MEMORY;
+        device->bars[i].prefetchable = false;
+    }
+
+    // The decoding is disabled while the BARs are sized, so the device never
+    // answers at the all-ones address. The status register (upper half) is
+    // written back as zeroes, as its bits are cleared by writing ones
+    uint32_t command = OSMOS::IO::PCI::read(device, 0x04) & 0xFFFF;
+    OSMOS::IO::PCI::write(device, 0x04, command & ~(uint32_t) (OSMOS::IO::PCI::COMMAND_IO_SPACE | OSMOS::IO::PCI::COMMAND_MEMORY_SPACE));
+
+    for (uint32_t i = 0; i < barCount; i++) {
+        uint8_t offset = 0x10 + i * 4;
+        uint32_t value = OSMOS::IO::PCI::read(device, offset);
+
+        OSMOS::IO::PCI::write(device, offset, 0xFFFFFFFF);
+        uint32_t mask = OSMOS::IO::PCI::read(device, offset);
+        OSMOS::IO::PCI::write(device, offset, value);
+
+        if (mask == 0 || mask == 0xFFFFFFFF)
+            continue;
+
+        OSMOS::IO::PCI::Bar *bar = &device->bars[i];
+        if (value & 0x01) {
+            bar->type = OSMOS::IO::PCI::BAR_TYPE_IO;
+            bar->address = value & ~(uint32_t) 0x03;
+            bar->size = (~(mask & ~(uint32_t) 0x03) & 0xFFFF) + 1;
+        } else {
+            bar->type = OSMOS::IO::PCI::BAR_TYPE_MEMORY;
+            bar->address = value & ~(uint32_t) 0x0F;
+            bar->size = ~(mask & ~(uint32_t) 0x0F) + 1;
+            bar->prefetchable = (value & 0x08) != 0;
+
+            // A 64-bit BAR uses the next register for its high half: the region
+            // is only usable if it is below 4 GB
+            if (((value >> 1) & 0x03) == 0x02) {
+                i++;
+                if (OSMOS::IO::PCI::read(device, offset + 4) != 0) {
+                    bar->address = 0;
+                    bar->size = 0;
+                }
+            }
+        }
+    }
+
+    OSMOS::IO::PCI::write(device, 0x04, command);
+
+    // A PCI-to-PCI bridge leads to another bus
+    if ((device->headerType & 0x7F) == 0x01) {
+        uint8_t secondary = (OSMOS::IO::PCI::read(device, 0x18) >> 8) & 0xFF;
+        if (secondary != 0 && secondary != bus)
+            OSMOS::IO::PCI::scan(secondary);
+    }
+}
+
+void OSMOS::IO::PCI::scan(uint8_t bus) {
+    for (uint8_t slot = 0; slot < 32; slot++) {
+        if ((OSMOS::IO::PCI::read(bus, slot, 0, 0x00) & 0xFFFF) == 0xFFFF)
+            continue;
+
+        OSMOS::IO::PCI::probe(bus, slot, 0);
+
+        if (((OSMOS::IO::PCI::read(bus, slot, 0, 0x0C) >> 16) & 0x80) == 0)
+            continue;
+
+        for (uint8_t function = 1; function < 8; function++)
+            if ((OSMOS::IO::PCI::read(bus, slot, function, 0x00) & 0xFFFF) != 0xFFFF)
+                OSMOS::IO::PCI::probe(bus, slot, function);
+    }
+}
+
+uint32_t OSMOS::IO::PCI::enumerate() {
+    OSMOS::IO::PCI::DEVICE_COUNT = 0;
+    OSMOS::IO::PCI::scan(0);
+
+    return OSMOS::IO::PCI::DEVICE_COUNT;
+}
+
+uint32_t OSMOS::IO::PCI::getDeviceCount() {
+    return OSMOS::IO::PCI::DEVICE_COUNT;
+}
+
+OSMOS::IO::PCI::Device *OSMOS::IO::PCI::getDevice(uint32_t index) {
+    return (index < OSMOS::IO::PCI::DEVICE_COUNT ? &OSMOS::IO::PCI::DEVICES[index] : NULL);
+}
+
+OSMOS::IO::PCI::Device *OSMOS::IO::PCI::findDevice(uint16_t vendor, uint16_t device, uint32_t start) {
+    for (uint32_t i = start; i < OSMOS::IO::PCI::DEVICE_COUNT; i++)
+        if (OSMOS::IO::PCI::DEVICES[i].vendor == vendor && OSMOS::IO::PCI::DEVICES[i].device == device)
+            return &OSMOS::IO::PCI::DEVICES[i];
+
+    return NULL;
+}
+
+void OSMOS::IO::PCI::enable(OSMOS::IO::PCI::Device *device) {
+    uint32_t command = OSMOS::IO::PCI::read(device, 0x04) & 0xFFFF;
+    command |= OSMOS::IO::PCI::COMMAND_IO_SPACE | OSMOS::IO::PCI::COMMAND_MEMORY_SPACE | OSMOS::IO::PCI::COMMAND_BUS_MASTER;
+
+    OSMOS::IO::PCI::write(device, 0x04, command);
+}
\ No newline at end of file
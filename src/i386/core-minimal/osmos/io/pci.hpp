@@ -0,0 +1,206 @@
+/*
+ * The PCI (Peripheral Component Interconnect) bus class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PCI_HPP
+#define PCI_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief PCI's class that accesses the configuration space through the
+         * ports 0xCF8/0xCFC, enumerates the devices and decodes their BARs
+         **/
+        class PCI {
+        public:
+            /**
+             * The maximum number of devices kept by the enumeration
+             **/
+            static const uint32_t DEVICE_MAXIMUM = 64;
+            /**
+             * The number of base address registers of a device
+             **/
+            static const uint32_t BAR_COUNT = 6;
+
+            /**
+             * The <i>memory</i> type indicates that the BAR maps memory
+             **/
+            static uint8_t BAR_TYPE_MEMORY;
+            /**
+             * The <i>I/O</i> type indicates that the BAR maps ports
+             **/
+            static uint8_t BAR_TYPE_IO;
+
+            /**
+             * The <i>I/O space</i> bit of the command register
+             **/
+            static uint16_t COMMAND_IO_SPACE;
+            /**
+             * The <i>memory space</i> bit of the command register
+             **/
+            static uint16_t COMMAND_MEMORY_SPACE;
+            /**
+             * The <i>bus master</i> bit of the command register, which allows
+             * the device to do DMA
+             **/
+            static uint16_t COMMAND_BUS_MASTER;
+
+            /**
+             * A decoded base address register
+             **/
+            struct Bar {
+                /**
+                 * The base address (memory) or the first port (I/O), or 0 if
+                 * the BAR is not implemented
+                 **/
+                address_t address;
+                /**
+                 * The size in bytes of the region
+                 **/
+                uint32_t size;
+                /**
+                 * One of the BAR_TYPE_* values of the PCI class
+                 **/
+                uint8_t type;
+                bool prefetchable;
+            };
+
+            /**
+             * A function found by the enumeration
+             **/
+            struct Device {
+                uint8_t bus;
+                uint8_t slot;
+                uint8_t function;
+                uint16_t vendor;
+                uint16_t device;
+                uint8_t classCode;
+                uint8_t subclass;
+                uint8_t interface;
+                uint8_t revision;
+                uint8_t headerType;
+                /**
+                 * The IRQ line routed by the firmware, or 0xFF if none
+                 **/
+                uint8_t interruptLine;
+                uint8_t interruptPin;
+                /**
+                 * The subsystem identifier, which tells the device type of the
+                 * legacy virtio devices
+                 **/
+                uint16_t subsystem;
+                OSMOS::IO::PCI::Bar bars[BAR_COUNT];
+            };
+
+        private:
+            /**
+             * The devices found by the enumeration
+             **/
+            static OSMOS::IO::PCI::Device DEVICES[DEVICE_MAXIMUM];
+            /**
+             * The number of devices found by the enumeration
+             **/
+            static uint32_t DEVICE_COUNT;
+
+            /**
+             * @brief Adds a function to the devices and decodes its BARs
+             * @param bus the bus of the function
+             * @param slot the slot of the function
+             * @param function the function number
+             **/
+            static void probe(uint8_t bus, uint8_t slot, uint8_t function);
+            /**
+             * @brief Scans every slot of a bus, following the PCI-to-PCI
+             * bridges
+             * @param bus the bus to scan
+             **/
+            static void scan(uint8_t bus);
+
+        public:
+            /**
+             * @brief Reads a double word of the configuration space
+             * @param bus the bus of the function
+             * @param slot the slot of the function
+             * @param function the function number
+             * @param offset the offset of the register, aligned on 4
+             * @return the value of the register
+             **/
+            static uint32_t read(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset);
+            /**
+             * @brief Writes a double word of the configuration space
+             * @param bus the bus of the function
+             * @param slot the slot of the function
+             * @param function the function number
+             * @param offset the offset of the register, aligned on 4
+             * @param value the value to write
+             **/
+            static void write(uint8_t bus, uint8_t slot, uint8_t function, uint8_t offset, uint32_t value);
+            /**
+             * @brief Reads a double word of the configuration space of a device
+             * @param device the device to access
+             * @param offset the offset of the register, aligned on 4
+             * @return the value of the register
+             **/
+            static uint32_t read(OSMOS::IO::PCI::Device *device, uint8_t offset);
+            /**
+             * @brief Writes a double word of the configuration space of a device
+             * @param device the device to access
+             * @param offset the offset of the register, aligned on 4
+             * @param value the value to write
+             **/
+            static void write(OSMOS::IO::PCI::Device *device, uint8_t offset, uint32_t value);
+
+            /**
+             * @brief Enumerates the devices of every bus reachable from the
+             * bus 0
+             * @return the number of devices found
+             **/
+            static uint32_t enumerate();
+            /**
+             * @brief Gets the number of devices found by the enumeration
+             * @return the number of devices
+             **/
+            static uint32_t getDeviceCount();
+            /**
+             * @brief Gets a device found by the enumeration
+             * @param index the index of the device
+             * @return the device, or NULL if the index is out of range
+             **/
+            static OSMOS::IO::PCI::Device *getDevice(uint32_t index);
+            /**
+             * @brief Finds a device by its identifiers
+             * @param vendor the vendor identifier
+             * @param device the device identifier
+             * @param start the index to start from, so the next devices with
+             * the same identifiers can be found
+             * @return the device, or NULL if none is found
+             **/
+            static OSMOS::IO::PCI::Device *findDevice(uint16_t vendor, uint16_t device, uint32_t start);
+
+            /**
+             * @brief Enables the decoding of the BARs and the bus mastering
+             * (DMA) of a device
+             * @param device the device to enable
+             **/
+            static void enable(OSMOS::IO::PCI::Device *device);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
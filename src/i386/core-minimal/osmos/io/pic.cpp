@@ -0,0 +1,84 @@
+/*
+ * The programmable interrupt controller class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pic.hpp"
+
+#include "port.hpp"
+
+uint8_t OSMOS::IO::PIC::MASTER_MASK = 0xFF;
+uint8_t OSMOS::IO::PIC::SLAVE_MASK  = 0xFF;
+
+void OSMOS::IO::PIC::initialize() {
+    // ICW1: initialization with ICW4, ICW2: vector offsets, ICW3: slave on
+    // the line 2 of the master, ICW4: 8086 mode
+    OSMOS::IO::Port::out((uint16_t) 0x20, (uint8_t) 0x11);
+    OSMOS::IO::Port::out((uint16_t) 0xA0, (uint8_t) 0x11);
+    OSMOS::IO::Port::out((uint16_t) 0x21, (uint8_t) OSMOS::IO::PIC::VECTOR_BASE);
+    OSMOS::IO::Port::out((uint16_t) 0xA1, (uint8_t) (OSMOS::IO::PIC::VECTOR_BASE + 8));
+    OSMOS::IO::Port::out((uint16_t) 0x21, (uint8_t) 0x04);
+    OSMOS::IO::Port::out((uint16_t) 0xA1, (uint8_t) 0x02);
+    OSMOS::IO::Port::out((uint16_t) 0x21, (uint8_t) 0x01);
+    OSMOS::IO::Port::out((uint16_t) 0xA1, (uint8_t) 0x01);
+
+    // Everything is masked, except the cascade line of the slave
+    OSMOS::IO::PIC::MASTER_MASK = 0xFB;
+    OSMOS::IO::PIC::SLAVE_MASK = 0xFF;
+    OSMOS::IO::Port::out((uint16_t) 0x21, OSMOS::IO::PIC::MASTER_MASK);
+    OSMOS::IO::Port::out((uint16_t) 0xA1, OSMOS::IO::PIC::SLAVE_MASK);
+}
+
+void OSMOS::IO::PIC::mask(uint8_t line) {
+    if (line < 8) {
+        OSMOS::IO::PIC::MASTER_MASK |= 1 << line;
+        OSMOS::IO::Port::out((uint16_t) 0x21, OSMOS::IO::PIC::MASTER_MASK);
+    } else if (line < OSMOS::IO::PIC::LINE_COUNT) {
+        OSMOS::IO::PIC::SLAVE_MASK |= 1 << (line - 8);
+        OSMOS::IO::Port::out((uint16_t) 0xA1, OSMOS::IO::PIC::SLAVE_MASK);
+    }
+}
+
+void OSMOS::IO::PIC::unmask(uint8_t line) {
+    if (line < 8) {
+        OSMOS::IO::PIC::MASTER_MASK &= ~(1 << line);
+        OSMOS::IO::Port::out((uint16_t) 0x21, OSMOS::IO::PIC::MASTER_MASK);
+    } else if (line < OSMOS::IO::PIC::LINE_COUNT) {
+        OSMOS::IO::PIC::SLAVE_MASK &= ~(1 << (line - 8));
+        OSMOS::IO::Port::out((uint16_t) 0xA1, OSMOS::IO::PIC::SLAVE_MASK);
+    }
+}
+
+void OSMOS::IO::PIC::acknowledge(uint8_t line) {
+    if (line >= 8)
+        OSMOS::IO::Port::out((uint16_t) 0xA0, (uint8_t) 0x20);
+
+    OSMOS::IO::Port::out((uint16_t) 0x20, (uint8_t) 0x20);
+}
+
+bool OSMOS::IO::PIC::isSpurious(uint8_t line) {
+    if (line != 7 && line != 15)
+        return false;
+
+    // OCW3: the next read of the command port returns the in-service register
+    uint16_t port = (line == 7 ? 0x20 : 0xA0);
+    uint8_t inService;
+
+    OSMOS::IO::Port::out(port, (uint8_t) 0x0B);
+    OSMOS::IO::Port::in(port, &inService);
+
+    return !(inService & 0x80);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+/*
+ * The programmable interrupt controller class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIC_HPP
+#define PIC_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief PIC's class that controls the two cascaded 8259 interrupt
+         * controllers, which deliver the hardware interrupts (IRQs)
+         **/
+        class PIC {
+        private:
+            /**
+             * The masks of the master and slave controllers, kept in memory so
+             * they are never read back from the hardware
+             **/
+            static uint8_t MASTER_MASK;
+            static uint8_t SLAVE_MASK;
+
+        public:
+            /**
+             * The number of IRQ lines
+             **/
+            static const uint8_t LINE_COUNT = 16;
+            /**
+             * The first interrupt vector of the IRQ lines, right after the
+             * exceptions of the processor
+             **/
+            static const uint8_t VECTOR_BASE = 32;
+
+            /**
+             * @brief Remaps the IRQs to the vectors VECTOR_BASE to
+             * VECTOR_BASE + 15 and masks every line
+             **/
+            static void initialize();
+
+            /**
+             * @brief Masks an IRQ line
+             * @param line the line to mask
+             **/
+            static void mask(uint8_t line);
+            /**
+             * @brief Unmasks an IRQ line
+             * @param line the line to unmask
+             **/
+            static void unmask(uint8_t line);
+
+            /**
+             * @brief Sends the end of interrupt to the controllers handling the
+             * given line
+             * @param line the line which has been handled
+             **/
+            static void acknowledge(uint8_t line);
+            /**
+             * @brief Checks if an interrupt of the lowest priority line of a
+             * controller, 7 or 15, is spurious: the controller raised it for a
+             * request which went away, and has no line in service
+             * @param line the line which raised the interrupt
+             * @return true if the interrupt is spurious, and must not be
+             * acknowledged to its controller
+             **/
+            static bool isSpurious(uint8_t line);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -21,24 +21,21 @@
 #include "../osmos.hpp"
 
 void OSMOS::IO::Port::in(uint16_t port, uint8_t *value) {
-    asm("inb ebx, %[port]\n \
-         mov %[value], ebx"
-       : [value] "=a" (value)
-       : [port] "c" (port));
+    asm volatile("in %[value], %[port]"
+                : [value] "=a" (*value)
+                : [port] "Nd" (port));
 }
 
 void OSMOS::IO::Port::in(uint16_t port, uint16_t *value) {
-    asm("inw bx, %[port]\n \
-         mov %[value], bx"
-       : [value] "=a" (value)
-       : [port] "c" (port));
+    asm volatile("in %[value], %[port]"
+                : [value] "=a" (*value)
+                : [port] "Nd" (port));
 }
 
 void OSMOS::IO::Port::in(uint16_t port, uint32_t *value) {
-    asm("ind bl, %[port]\n \
-         mov %[value], bl"
-       : [value] "=a" (value)
-       : [port] "c" (port));
+    asm volatile("in %[value], %[port]"
+                : [value] "=a" (*value)
+                : [port] "Nd" (port));
 }
 
 void OSMOS::IO::Port::in(uint16_t port, char *str) {
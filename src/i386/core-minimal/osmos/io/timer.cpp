@@ -0,0 +1,49 @@
+/*
+ * The programmable interval timer class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "timer.hpp"
+
+#include "port.hpp"
+#include "../sys/scheduler.hpp"
+
+volatile uint32_t OSMOS::IO::Timer::TICKS                   = 0;
+
+// The input clock of the timer, in Hz
+#define TIMER_INPUT_FREQUENCY                               1193182
+
+void OSMOS::IO::Timer::initialize() {
+    uint32_t divisor = TIMER_INPUT_FREQUENCY / OSMOS::IO::Timer::FREQUENCY;
+
+    // Channel 0, low then high byte, rate generator
+    OSMOS::IO::Port::out((uint16_t) 0x43, (uint8_t) 0x34);
+    OSMOS::IO::Port::out((uint16_t) 0x40, (uint8_t) (divisor & 0xFF));
+    OSMOS::IO::Port::out((uint16_t) 0x40, (uint8_t) ((divisor >> 8) & 0xFF));
+
+    OSMOS::System::Interrupts::setIRQHandler(0, OSMOS::IO::Timer::handleInterrupt);
+}
+
+uint32_t OSMOS::IO::Timer::getTicks() {
+    return OSMOS::IO::Timer::TICKS;
+}
+
+void OSMOS::IO::Timer::handleInterrupt(OSMOS::System::Interrupts::Frame *frame) {
+    (void) frame;
+
+    OSMOS::IO::Timer::TICKS = OSMOS::IO::Timer::TICKS + 1;
+    OSMOS::System::Scheduler::tick(OSMOS::IO::Timer::TICKS);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+/*
+ * The programmable interval timer class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include "../osmos.hpp"
+
+#include "../sys/interrupts.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief Timer's class that programs the channel 0 of the 8253/8254
+         * interval timer to count ticks on the IRQ 0, and wakes the sleeping
+         * threads
+         **/
+        class Timer {
+        public:
+            /**
+             * The number of ticks per second
+             **/
+            static const uint32_t FREQUENCY = 1000;
+
+        private:
+            /**
+             * The number of ticks since initialize
+             **/
+            static volatile uint32_t TICKS;
+
+            /**
+             * @brief Handles the IRQ 0
+             * @param frame the state of the interrupted code
+             **/
+            static void handleInterrupt(OSMOS::System::Interrupts::Frame *frame);
+
+        public:
+            /**
+             * @brief Programs the timer at FREQUENCY and unmasks the IRQ 0
+             **/
+            static void initialize();
+            /**
+             * @brief Gets the number of ticks since initialize. A tick lasts
+             * 1 / FREQUENCY second (one millisecond)
+             * @return the number of ticks, which wraps around
+             **/
+            static uint32_t getTicks();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
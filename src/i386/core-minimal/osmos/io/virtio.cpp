@@ -0,0 +1,229 @@
+/*
+ * The virtio transport and virtqueue class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "virtio.hpp"
+
+#include "port.hpp"
+#include "../sys/frame.hpp"
+#include "../sys/memory.hpp"
+
+uint16_t OSMOS::IO::Virtio::PCI_VENDOR                      = 0x1AF4;
+
+uint8_t OSMOS::IO::Virtio::STATUS_ACKNOWLEDGE               = 1;
+uint8_t OSMOS::IO::Virtio::STATUS_DRIVER                    = 2;
+uint8_t OSMOS::IO::Virtio::STATUS_DRIVER_OK                 = 4;
+uint8_t OSMOS::IO::Virtio::STATUS_FAILED                    = 128;
+
+uint32_t OSMOS::IO::Virtio::FEATURE_INDIRECT_DESCRIPTORS    = 1 << 28;
+uint32_t OSMOS::IO::Virtio::FEATURE_EVENT_INDEX             = 1 << 29;
+
+uint16_t OSMOS::IO::Virtio::DESCRIPTOR_NEXT                 = 1;
+uint16_t OSMOS::IO::Virtio::DESCRIPTOR_WRITE                = 2;
+uint16_t OSMOS::IO::Virtio::DESCRIPTOR_INDIRECT             = 4;
+
+uint16_t OSMOS::IO::Virtio::REGISTER_CONFIGURATION          = 0x14;
+
+// The registers of the legacy interface, relative to the I/O BAR 0
+#define VIRTIO_REGISTER_DEVICE_FEATURES                     0x00
+#define VIRTIO_REGISTER_DRIVER_FEATURES                     0x04
+#define VIRTIO_REGISTER_QUEUE_ADDRESS                       0x08
+#define VIRTIO_REGISTER_QUEUE_SIZE                          0x0C
+#define VIRTIO_REGISTER_QUEUE_SELECT                        0x0E
+#define VIRTIO_REGISTER_QUEUE_NOTIFY                        0x10
+#define VIRTIO_REGISTER_DEVICE_STATUS                       0x12
+#define VIRTIO_REGISTER_ISR_STATUS                          0x13
+
+// The legacy interface requires the used ring to begin on a 4 KB boundary
+#define VIRTIO_QUEUE_ALIGNMENT                              4096
+
+// The flag of the available ring that asks the device not to interrupt, and
+// the one of the used ring that asks the driver not to notify
+#define VIRTIO_AVAILABLE_NO_INTERRUPT                       1
+#define VIRTIO_USED_NO_NOTIFY                               1
+
+// A full barrier: the stores before it are visible before the loads after it
+static inline void virtioBarrier() {
+    asm volatile("lock or dword ptr [esp], 0" : : : "memory");
+}
+
+void OSMOS::IO::Virtio::reset(uint16_t port) {
+    OSMOS::IO::Port::out((uint16_t) (port + VIRTIO_REGISTER_DEVICE_STATUS), (uint8_t) 0);
+    OSMOS::IO::Virtio::addStatus(port, OSMOS::IO::Virtio::STATUS_ACKNOWLEDGE);
+    OSMOS::IO::Virtio::addStatus(port, OSMOS::IO::Virtio::STATUS_DRIVER);
+}
+
+void OSMOS::IO::Virtio::addStatus(uint16_t port, uint8_t status) {
+    uint8_t current;
+
+    OSMOS::IO::Port::in((uint16_t) (port + VIRTIO_REGISTER_DEVICE_STATUS), &current);
+    OSMOS::IO::Port::out((uint16_t) (port + VIRTIO_REGISTER_DEVICE_STATUS), (uint8_t) (current | status));
+}
+
+uint32_t OSMOS::IO::Virtio::negotiate(uint16_t port, uint32_t wanted) {
+    uint32_t offered;
+
+    OSMOS::IO::Port::in((uint16_t) (port + VIRTIO_REGISTER_DEVICE_FEATURES), &offered);
+    OSMOS::IO::Port::out((uint16_t) (port + VIRTIO_REGISTER_DRIVER_FEATURES), (uint32_t) (offered & wanted));
+
+    return offered & wanted;
+}
+
+uint8_t OSMOS::IO::Virtio::acknowledge(uint16_t port) {
+    uint8_t status;
+
+    OSMOS::IO::Port::in((uint16_t) (port + VIRTIO_REGISTER_ISR_STATUS), &status);
+    return status;
+}
+
+bool OSMOS::IO::Virtio::setupQueue(OSMOS::IO::Virtio::Queue *queue, uint16_t port, uint16_t index, bool eventIndex) {
+    uint16_t size;
+
+    OSMOS::IO::Port::out((uint16_t) (port + VIRTIO_REGISTER_QUEUE_SELECT), index);
+    OSMOS::IO::Port::in((uint16_t) (port + VIRTIO_REGISTER_QUEUE_SIZE), &size);
+    if (size == 0)
+        return false;
+
+    // Descriptors, then the available ring and the used event; the used ring
+    // and the available event on the next boundary
+    uint32_t availableEnd = size * sizeof(OSMOS::IO::Virtio::Descriptor) + (3 + size) * sizeof(uint16_t);
+    uint32_t usedOffset = (availableEnd + VIRTIO_QUEUE_ALIGNMENT - 1) & ~(VIRTIO_QUEUE_ALIGNMENT - 1);
+    uint32_t usedEnd = usedOffset + 3 * sizeof(uint16_t) + size * sizeof(OSMOS::IO::Virtio::UsedElement);
+    uint32_t frames = (usedEnd + OSMOS::System::Frame::FRAME_SIZE - 1) / OSMOS::System::Frame::FRAME_SIZE;
+
+    address_t memory = OSMOS::System::Frame::allocate(frames);
+    if (memory == NULL)
+        return false;
+    OSMOS::System::Memory::fill((uint8_t *) memory, frames * OSMOS::System::Frame::FRAME_SIZE, 0);
+
+    queue->port = port;
+    queue->index = index;
+    queue->size = size;
+    queue->eventIndex = eventIndex;
+
+    queue->descriptors = (OSMOS::IO::Virtio::Descriptor *) memory;
+    uint16_t *available = (uint16_t *) (memory + size * sizeof(OSMOS::IO::Virtio::Descriptor));
+    queue->availableFlags = &available[0];
+    queue->availableIndex = &available[1];
+    queue->availableRing = &available[2];
+    queue->usedEvent = &available[2 + size];
+
+    uint16_t *used = (uint16_t *) (memory + usedOffset);
+    queue->usedFlags = &used[0];
+    queue->usedIndex = &used[1];
+    queue->usedRing = (OSMOS::IO::Virtio::UsedElement *) &used[2];
+    queue->availableEvent = (uint16_t *) &queue->usedRing[size];
+
+    for (uint16_t i = 0; i < size; i++)
+        queue->descriptors[i].next = i + 1;
+    queue->freeHead = 0;
+    queue->freeCount = size;
+    queue->availableShadow = 0;
+    queue->availableKicked = 0;
+    queue->lastUsed = 0;
+
+    OSMOS::IO::Port::out((uint16_t) (port + VIRTIO_REGISTER_QUEUE_ADDRESS), (uint32_t) (memory / VIRTIO_QUEUE_ALIGNMENT));
+    return true;
+}
+
+uint16_t OSMOS::IO::Virtio::allocate(OSMOS::IO::Virtio::Queue *queue, uint16_t count) {
+    if (count == 0 || count > queue->freeCount)
+        return queue->size;
+
+    uint16_t head = queue->freeHead;
+    uint16_t last = head;
+    for (uint16_t i = 1; i < count; i++) {
+        queue->descriptors[last].flags = OSMOS::IO::Virtio::DESCRIPTOR_NEXT;
+        last = queue->descriptors[last].next;
+    }
+
+    queue->freeHead = queue->descriptors[last].next;
+    queue->descriptors[last].flags = 0;
+    queue->freeCount -= count;
+
+    return head;
+}
+
+void OSMOS::IO::Virtio::free(OSMOS::IO::Virtio::Queue *queue, uint16_t head) {
+    uint16_t last = head;
+    uint16_t count = 1;
+
+    while (queue->descriptors[last].flags & OSMOS::IO::Virtio::DESCRIPTOR_NEXT) {
+        last = queue->descriptors[last].next;
+        count++;
+    }
+
+    queue->descriptors[last].next = queue->freeHead;
+    queue->freeHead = head;
+    queue->freeCount += count;
+}
+
+void OSMOS::IO::Virtio::push(OSMOS::IO::Virtio::Queue *queue, uint16_t head) {
+    queue->availableRing[queue->availableShadow % queue->size] = head;
+    queue->availableShadow++;
+}
+
+bool OSMOS::IO::Virtio::kick(OSMOS::IO::Virtio::Queue *queue) {
+    uint16_t previous = queue->availableKicked;
+    uint16_t next = queue->availableShadow;
+
+    if (previous == next)
+        return false;
+
+    // The ring entries must be visible before the index, and the index before
+    // the event index of the device is read
+    asm volatile("" : : : "memory");
+    *queue->availableIndex = next;
+    virtioBarrier();
+    queue->availableKicked = next;
+
+    bool notify;
+    if (queue->eventIndex) {
+        uint16_t event = *queue->availableEvent;
+        notify = (uint16_t) (next - event - 1) < (uint16_t) (next - previous);
+    } else
+        notify = !(*queue->usedFlags & VIRTIO_USED_NO_NOTIFY);
+
+    if (notify)
+        OSMOS::IO::Port::out((uint16_t) (queue->port + VIRTIO_REGISTER_QUEUE_NOTIFY), queue->index);
+
+    return notify;
+}
+
+bool OSMOS::IO::Virtio::pop(OSMOS::IO::Virtio::Queue *queue, uint16_t *head, uint32_t *length) {
+    if (queue->lastUsed == *queue->usedIndex)
+        return false;
+
+    // The element must not be read before the index
+    asm volatile("" : : : "memory");
+    volatile OSMOS::IO::Virtio::UsedElement *element = &queue->usedRing[queue->lastUsed % queue->size];
+    *head = element->id;
+    *length = element->length;
+    queue->lastUsed++;
+
+    return true;
+}
+
+bool OSMOS::IO::Virtio::rearm(OSMOS::IO::Virtio::Queue *queue) {
+    if (queue->eventIndex)
+        *queue->usedEvent = queue->lastUsed;
+    else
+        *queue->availableFlags &= ~VIRTIO_AVAILABLE_NO_INTERRUPT;
+
+    virtioBarrier();
+    return queue->lastUsed != *queue->usedIndex;
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+/*
+ * The virtio transport and virtqueue class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIRTIO_HPP
+#define VIRTIO_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief Virtio's class that drives the legacy virtio PCI interface
+         * (the I/O BAR 0 of the transitional devices) and the split
+         * virtqueues shared by every virtio device
+         **/
+        class Virtio {
+        public:
+            /**
+             * The vendor identifier of the virtio PCI devices
+             **/
+            static uint16_t PCI_VENDOR;
+
+            /**
+             * The device status bits, written in order while the device is
+             * initialized
+             **/
+            static uint8_t STATUS_ACKNOWLEDGE;
+            static uint8_t STATUS_DRIVER;
+            static uint8_t STATUS_DRIVER_OK;
+            static uint8_t STATUS_FAILED;
+
+            /**
+             * The <i>indirect descriptors</i> feature, which lets a single ring
+             * descriptor point to a whole table of descriptors
+             **/
+            static uint32_t FEATURE_INDIRECT_DESCRIPTORS;
+            /**
+             * The <i>event index</i> feature, which lets both sides tell up to
+             * which index they want to be notified
+             **/
+            static uint32_t FEATURE_EVENT_INDEX;
+
+            /**
+             * The descriptor flags
+             **/
+            static uint16_t DESCRIPTOR_NEXT;
+            static uint16_t DESCRIPTOR_WRITE;
+            static uint16_t DESCRIPTOR_INDIRECT;
+
+            /**
+             * The offset of the device specific configuration in the I/O BAR,
+             * when MSI-X is disabled
+             **/
+            static uint16_t REGISTER_CONFIGURATION;
+
+            /**
+             * A descriptor of a buffer shared with the device
+             **/
+            struct Descriptor {
+                uint64_t address;
+                uint32_t length;
+                uint16_t flags;
+                uint16_t next;
+            } __attribute__((packed));
+
+            /**
+             * An entry of the used ring, written by the device
+             **/
+            struct UsedElement {
+                uint32_t id;
+                uint32_t length;
+            } __attribute__((packed));
+
+            /**
+             * A split virtqueue: the descriptor table, the available ring
+             * (driver to device) and the used ring (device to driver)
+             **/
+            struct Queue {
+                /**
+                 * The first port of the device and the number of the queue
+                 **/
+                uint16_t port;
+                uint16_t index;
+                /**
+                 * The number of descriptors, set by the device
+                 **/
+                uint16_t size;
+
+                OSMOS::IO::Virtio::Descriptor *descriptors;
+                volatile uint16_t *availableFlags;
+                volatile uint16_t *availableIndex;
+                volatile uint16_t *availableRing;
+                /**
+                 * The used index after which the device interrupts (event
+                 * index), stored after the available ring
+                 **/
+                volatile uint16_t *usedEvent;
+                volatile uint16_t *usedFlags;
+                volatile uint16_t *usedIndex;
+                volatile OSMOS::IO::Virtio::UsedElement *usedRing;
+                /**
+                 * The available index after which the device wants to be
+                 * notified (event index), stored after the used ring
+                 **/
+                volatile uint16_t *availableEvent;
+
+                /**
+                 * The head of the free descriptors list and its length
+                 **/
+                uint16_t freeHead;
+                uint16_t freeCount;
+                /**
+                 * The next available index, not yet published to the device
+                 **/
+                uint16_t availableShadow;
+                /**
+                 * The available index published by the last kick
+                 **/
+                uint16_t availableKicked;
+                /**
+                 * The next used index to consume
+                 **/
+                uint16_t lastUsed;
+                /**
+                 * Whether the event index feature has been negotiated
+                 **/
+                bool eventIndex;
+            };
+
+            /**
+             * @brief Resets the device and acknowledges it
+             * @param port the first port of the device
+             **/
+            static void reset(uint16_t port);
+            /**
+             * @brief Adds bits to the device status
+             * @param port the first port of the device
+             * @param status the bits to add
+             **/
+            static void addStatus(uint16_t port, uint8_t status);
+            /**
+             * @brief Negotiates the features: only the wanted features offered
+             * by the device are accepted
+             * @param port the first port of the device
+             * @param wanted the features supported by the driver
+             * @return the accepted features
+             **/
+            static uint32_t negotiate(uint16_t port, uint32_t wanted);
+            /**
+             * @brief Reads and acknowledges the interrupt status of the device
+             * @param port the first port of the device
+             * @return the interrupt status, bit 0 being set for a used ring
+             * update
+             **/
+            static uint8_t acknowledge(uint16_t port);
+
+            /**
+             * @brief Allocates and registers a virtqueue of the device
+             * @param queue the queue to set up
+             * @param port the first port of the device
+             * @param index the number of the queue
+             * @param eventIndex whether the event index feature was accepted
+             * @return true if the queue exists and its memory was allocated
+             **/
+            static bool setupQueue(OSMOS::IO::Virtio::Queue *queue, uint16_t port, uint16_t index, bool eventIndex);
+
+            /**
+             * @brief Takes descriptors from the free list and chains them with
+             * their next field
+             * @param queue the queue to use
+             * @param count the number of descriptors
+             * @return the first descriptor of the chain, or the queue size if
+             * there are not enough free descriptors
+             **/
+            static uint16_t allocate(OSMOS::IO::Virtio::Queue *queue, uint16_t count);
+            /**
+             * @brief Gives a chain of descriptors back to the free list
+             * @param queue the queue to use
+             * @param head the first descriptor of the chain
+             **/
+            static void free(OSMOS::IO::Virtio::Queue *queue, uint16_t head);
+
+            /**
+             * @brief Puts a chain in the available ring without publishing it:
+             * the device only sees it after the next kick
+             * @param queue the queue to use
+             * @param head the first descriptor of the chain
+             **/
+            static void push(OSMOS::IO::Virtio::Queue *queue, uint16_t head);
+            /**
+             * @brief Publishes every pushed chain at once, and notifies the
+             * device only if it asked for it (event index or flags)
+             * @param queue the queue to kick
+             * @return true if the device has been notified
+             **/
+            static bool kick(OSMOS::IO::Virtio::Queue *queue);
+            /**
+             * @brief Takes the next chain completed by the device
+             * @param queue the queue to use
+             * @param head the pointer receiving the first descriptor
+             * @param length the pointer receiving the number of bytes written
+             * by the device
+             * @return true if a chain was completed
+             **/
+            static bool pop(OSMOS::IO::Virtio::Queue *queue, uint16_t *head, uint32_t *length);
+            /**
+             * @brief Tells the device to interrupt for the next completion,
+             * after every completed chain has been popped
+             * @param queue the queue to use
+             * @return true if the device completed chains meanwhile, which
+             * must be popped without waiting for an interrupt
+             **/
+            static bool rearm(OSMOS::IO::Virtio::Queue *queue);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,360 @@
+/*
+ * The virtio block device driver class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "virtioblock.hpp"
+
+#include "pic.hpp"
+#include "port.hpp"
+#include "../sys/frame.hpp"
+#include "../sys/memory.hpp"
+
+uint32_t OSMOS::IO::VirtioBlock::REQUEST_READ               = 0;
+uint32_t OSMOS::IO::VirtioBlock::REQUEST_WRITE              = 1;
+uint32_t OSMOS::IO::VirtioBlock::REQUEST_FLUSH              = 4;
+
+uint8_t OSMOS::IO::VirtioBlock::STATUS_OK                   = 0;
+uint8_t OSMOS::IO::VirtioBlock::STATUS_ERROR                = 1;
+uint8_t OSMOS::IO::VirtioBlock::STATUS_UNSUPPORTED          = 2;
+uint8_t OSMOS::IO::VirtioBlock::STATUS_PENDING              = 0xFF;
+
+OSMOS::IO::VirtioBlock::Device OSMOS::IO::VirtioBlock::DEVICES[OSMOS::IO::VirtioBlock::DEVICE_MAXIMUM];
+uint32_t OSMOS::IO::VirtioBlock::DEVICE_COUNT               = 0;
+OSMOS::System::Deferred::Queue *OSMOS::IO::VirtioBlock::QUEUE = NULL;
+
+// The PCI identifiers of the transitional block device, and the subsystem of
+// the legacy block devices
+#define VIRTIO_BLOCK_PCI_DEVICE                             0x1001
+#define VIRTIO_BLOCK_SUBSYSTEM                              2
+
+// The block device features used by the driver
+#define VIRTIO_BLOCK_FEATURE_SEGMENT_MAXIMUM                (1 << 2)
+#define VIRTIO_BLOCK_FEATURE_READ_ONLY                      (1 << 5)
+
+// The registers of the block device configuration
+#define VIRTIO_BLOCK_CONFIGURATION_CAPACITY                 0x00
+#define VIRTIO_BLOCK_CONFIGURATION_SEGMENT_MAXIMUM          0x0C
+
+uint32_t OSMOS::IO::VirtioBlock::initialize() {
+    OSMOS::IO::VirtioBlock::DEVICE_COUNT = 0;
+
+    if (OSMOS::IO::VirtioBlock::QUEUE == NULL)
+        OSMOS::IO::VirtioBlock::QUEUE = OSMOS::System::Deferred::create("virtio-blk", OSMOS::IO::VirtioBlock::handleDeferred);
+
+    for (uint32_t i = 0; i < OSMOS::IO::PCI::getDeviceCount() && OSMOS::IO::VirtioBlock::DEVICE_COUNT < OSMOS::IO::VirtioBlock::DEVICE_MAXIMUM; i++) {
+        OSMOS::IO::PCI::Device *pci = OSMOS::IO::PCI::getDevice(i);
+
+        if (pci->vendor != OSMOS::IO::Virtio::PCI_VENDOR || pci->device < 0x1000 || pci->device > 0x103F)
+            continue;
+        if (pci->device != VIRTIO_BLOCK_PCI_DEVICE && pci->subsystem != VIRTIO_BLOCK_SUBSYSTEM)
+            continue;
+
+        OSMOS::IO::VirtioBlock::probe(pci);
+    }
+
+    return OSMOS::IO::VirtioBlock::DEVICE_COUNT;
+}
+
+bool OSMOS::IO::VirtioBlock::probe(OSMOS::IO::PCI::Device *pci) {
+    if (pci->bars[0].type != OSMOS::IO::PCI::BAR_TYPE_IO || pci->bars[0].address == 0)
+        return false;
+
+    OSMOS::IO::VirtioBlock::Device *device = &OSMOS::IO::VirtioBlock::DEVICES[OSMOS::IO::VirtioBlock::DEVICE_COUNT];
+    device->pci = pci;
+    device->port = pci->bars[0].address;
+    device->inFlight = 0;
+    device->requestCount = 0;
+    device->kickCount = 0;
+    device->notifyCount = 0;
+    device->interruptCount = 0;
+    device->deferred = false;
+
+    OSMOS::IO::PCI::enable(pci);
+    OSMOS::IO::Virtio::reset(device->port);
+
+    uint32_t features = OSMOS::IO::Virtio::negotiate(device->port, OSMOS::IO::Virtio::FEATURE_INDIRECT_DESCRIPTORS | OSMOS::IO::Virtio::FEATURE_EVENT_INDEX | VIRTIO_BLOCK_FEATURE_SEGMENT_MAXIMUM | VIRTIO_BLOCK_FEATURE_READ_ONLY);
+    device->indirect = (features & OSMOS::IO::Virtio::FEATURE_INDIRECT_DESCRIPTORS) != 0;
+    device->readOnly = (features & VIRTIO_BLOCK_FEATURE_READ_ONLY) != 0;
+
+    uint16_t configuration = device->port + OSMOS::IO::Virtio::REGISTER_CONFIGURATION;
+    uint32_t capacityLow, capacityHigh;
+    OSMOS::IO::Port::in((uint16_t) (configuration + VIRTIO_BLOCK_CONFIGURATION_CAPACITY), &capacityLow);
+    OSMOS::IO::Port::in((uint16_t) (configuration + VIRTIO_BLOCK_CONFIGURATION_CAPACITY + 4), &capacityHigh);
+    device->capacity = ((uint64_t) capacityHigh << 32) | capacityLow;
+
+    device->segmentMaximum = OSMOS::IO::VirtioBlock::SEGMENT_MAXIMUM;
+    if (features & VIRTIO_BLOCK_FEATURE_SEGMENT_MAXIMUM) {
+        uint32_t segmentMaximum;
+        OSMOS::IO::Port::in((uint16_t) (configuration + VIRTIO_BLOCK_CONFIGURATION_SEGMENT_MAXIMUM), &segmentMaximum);
+        if (segmentMaximum != 0 && segmentMaximum < device->segmentMaximum)
+            device->segmentMaximum = segmentMaximum;
+    }
+
+    if (!OSMOS::IO::Virtio::setupQueue(&device->queue, device->port, 0, (features & OSMOS::IO::Virtio::FEATURE_EVENT_INDEX) != 0)) {
+        OSMOS::IO::Virtio::addStatus(device->port, OSMOS::IO::Virtio::STATUS_FAILED);
+        return false;
+    }
+
+    // Without indirect descriptors, a request takes its header, buffers and
+    // status from the ring itself
+    if (!device->indirect && device->segmentMaximum > (uint32_t) device->queue.size - 2)
+        device->segmentMaximum = device->queue.size - 2;
+
+    uint32_t slotsSize = device->queue.size * sizeof(OSMOS::IO::VirtioBlock::Slot);
+    uint32_t frames = (slotsSize + OSMOS::System::Frame::FRAME_SIZE - 1) / OSMOS::System::Frame::FRAME_SIZE;
+    device->slots = (OSMOS::IO::VirtioBlock::Slot *) OSMOS::System::Frame::allocate(frames);
+    if (device->slots == NULL) {
+        OSMOS::IO::Virtio::addStatus(device->port, OSMOS::IO::Virtio::STATUS_FAILED);
+        return false;
+    }
+    OSMOS::System::Memory::fill((uint8_t *) device->slots, frames * OSMOS::System::Frame::FRAME_SIZE, 0);
+
+    OSMOS::IO::Virtio::addStatus(device->port, OSMOS::IO::Virtio::STATUS_DRIVER_OK);
+    OSMOS::IO::VirtioBlock::DEVICE_COUNT++;
+
+    if (pci->interruptLine < OSMOS::IO::PIC::LINE_COUNT)
+        OSMOS::System::Interrupts::setIRQHandler(pci->interruptLine, OSMOS::IO::VirtioBlock::handleInterrupt);
+
+    // A request takes a single ring descriptor with the indirect descriptors,
+    // or its buffers plus 2 without them
+    device->block.sectorSize = OSMOS::IO::VirtioBlock::SECTOR_SIZE;
+    device->block.bufferCount = device->capacity / (OSMOS::IO::Block::BUFFER_SIZE / OSMOS::IO::VirtioBlock::SECTOR_SIZE);
+    device->block.segmentMaximum = device->segmentMaximum;
+    device->block.queueMaximum = (device->indirect ? device->queue.size : device->queue.size / (device->segmentMaximum + 2));
+    device->block.readOnly = device->readOnly;
+    device->block.submit = OSMOS::IO::VirtioBlock::submitBlock;
+    device->block.poll = (pci->interruptLine < OSMOS::IO::PIC::LINE_COUNT ? NULL : OSMOS::IO::VirtioBlock::pollBlock);
+    device->block.driver = device;
+    OSMOS::IO::Block::attach(&device->block);
+
+    return true;
+}
+
+uint32_t OSMOS::IO::VirtioBlock::getDeviceCount() {
+    return OSMOS::IO::VirtioBlock::DEVICE_COUNT;
+}
+
+OSMOS::IO::VirtioBlock::Device *OSMOS::IO::VirtioBlock::getDevice(uint32_t index) {
+    return (index < OSMOS::IO::VirtioBlock::DEVICE_COUNT ? &OSMOS::IO::VirtioBlock::DEVICES[index] : NULL);
+}
+
+bool OSMOS::IO::VirtioBlock::queue(OSMOS::IO::VirtioBlock::Device *device, OSMOS::IO::VirtioBlock::Request *request) {
+    if (request->segmentCount > device->segmentMaximum)
+        return false;
+    if (request->segmentCount == 0 && request->type != OSMOS::IO::VirtioBlock::REQUEST_FLUSH)
+        return false;
+    if (request->type == OSMOS::IO::VirtioBlock::REQUEST_WRITE && device->readOnly)
+        return false;
+
+    uint32_t count = request->segmentCount + 2;
+
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    uint16_t head = OSMOS::IO::Virtio::allocate(&device->queue, device->indirect ? 1 : count);
+    if (head == device->queue.size) {
+        if (enabled)
+            OSMOS::System::Interrupts::enable();
+        return false;
+    }
+
+    OSMOS::IO::VirtioBlock::Slot *slot = &device->slots[head];
+    slot->header.type = request->type;
+    slot->header.reserved = 0;
+    slot->header.sector = request->sector;
+    slot->status = OSMOS::IO::VirtioBlock::STATUS_PENDING;
+    slot->request = request;
+    request->status = OSMOS::IO::VirtioBlock::STATUS_PENDING;
+
+    // The device writes into the buffers of a read, and into the status
+    uint16_t dataFlags = (request->type == OSMOS::IO::VirtioBlock::REQUEST_READ ? OSMOS::IO::Virtio::DESCRIPTOR_WRITE : 0);
+
+    OSMOS::IO::Virtio::Descriptor *descriptors;
+    uint16_t index;
+    if (device->indirect) {
+        // A single ring descriptor, pointing to a table chained in order
+        for (uint16_t i = 0; i < count; i++) {
+            slot->table[i].flags = ((uint32_t) i + 1 < count ? OSMOS::IO::Virtio::DESCRIPTOR_NEXT : 0);
+            slot->table[i].next = i + 1;
+        }
+
+        OSMOS::IO::Virtio::Descriptor *ring = &device->queue.descriptors[head];
+        ring->address = (address_t) slot->table;
+        ring->length = count * sizeof(OSMOS::IO::Virtio::Descriptor);
+        ring->flags = OSMOS::IO::Virtio::DESCRIPTOR_INDIRECT;
+
+        descriptors = slot->table;
+        index = 0;
+    } else {
+        descriptors = device->queue.descriptors;
+        index = head;
+    }
+
+    descriptors[index].address = (address_t) &slot->header;
+    descriptors[index].length = sizeof(OSMOS::IO::VirtioBlock::Header);
+    index = descriptors[index].next;
+
+    for (uint32_t i = 0; i < request->segmentCount; i++) {
+        descriptors[index].address = request->segments[i].address;
+        descriptors[index].length = request->segments[i].length;
+        descriptors[index].flags |= dataFlags;
+        index = descriptors[index].next;
+    }
+
+    descriptors[index].address = (address_t) &slot->status;
+    descriptors[index].length = 1;
+    descriptors[index].flags |= OSMOS::IO::Virtio::DESCRIPTOR_WRITE;
+
+    OSMOS::IO::Virtio::push(&device->queue, head);
+    device->inFlight++;
+    device->requestCount++;
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return true;
+}
+
+void OSMOS::IO::VirtioBlock::kick(OSMOS::IO::VirtioBlock::Device *device) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    device->kickCount++;
+    if (OSMOS::IO::Virtio::kick(&device->queue))
+        device->notifyCount++;
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+}
+
+uint32_t OSMOS::IO::VirtioBlock::submit(OSMOS::IO::VirtioBlock::Device *device, OSMOS::IO::VirtioBlock::Request **requests, uint32_t count) {
+    uint32_t submitted = 0;
+
+    while (submitted < count && OSMOS::IO::VirtioBlock::queue(device, requests[submitted]))
+        submitted++;
+
+    if (submitted > 0)
+        OSMOS::IO::VirtioBlock::kick(device);
+
+    return submitted;
+}
+
+uint32_t OSMOS::IO::VirtioBlock::complete(OSMOS::IO::VirtioBlock::Device *device) {
+    uint32_t completed = 0;
+    uint16_t head;
+    uint32_t length;
+
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    // The device does not interrupt while the used ring is drained: the event
+    // index is only moved once it is empty
+    do {
+        while (OSMOS::IO::Virtio::pop(&device->queue, &head, &length)) {
+            OSMOS::IO::VirtioBlock::Slot *slot = &device->slots[head];
+            OSMOS::IO::VirtioBlock::Request *request = slot->request;
+
+            OSMOS::IO::Virtio::free(&device->queue, head);
+            device->inFlight--;
+            completed++;
+
+            request->status = slot->status;
+            if (request->callback != NULL)
+                request->callback(request);
+        }
+    } while (OSMOS::IO::Virtio::rearm(&device->queue));
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return completed;
+}
+
+void OSMOS::IO::VirtioBlock::handleInterrupt(OSMOS::System::Interrupts::Frame *frame) {
+    uint8_t line = frame->vector - OSMOS::IO::PIC::VECTOR_BASE;
+
+    // The line may be shared: every device on it is checked
+    for (uint32_t i = 0; i < OSMOS::IO::VirtioBlock::DEVICE_COUNT; i++) {
+        OSMOS::IO::VirtioBlock::Device *device = &OSMOS::IO::VirtioBlock::DEVICES[i];
+
+        if (device->pci->interruptLine != line)
+            continue;
+
+        if (!(OSMOS::IO::Virtio::acknowledge(device->port) & 0x01))
+            continue;
+
+        device->interruptCount++;
+
+        // A device waiting in the queue needs no other item
+        if (device->deferred)
+            continue;
+
+        // Without a free item, the requests are completed right away
+        device->deferred = true;
+        if (OSMOS::IO::VirtioBlock::QUEUE == NULL || !OSMOS::System::Deferred::enqueue(OSMOS::IO::VirtioBlock::QUEUE, device)) {
+            device->deferred = false;
+            OSMOS::IO::VirtioBlock::complete(device);
+        }
+    }
+}
+
+void OSMOS::IO::VirtioBlock::handleDeferred(void *data) {
+    OSMOS::IO::VirtioBlock::Device *device = (OSMOS::IO::VirtioBlock::Device *) data;
+
+    // An IRQ coming from now on enqueues the device again
+    device->deferred = false;
+    OSMOS::IO::VirtioBlock::complete(device);
+}
+
+uint32_t OSMOS::IO::VirtioBlock::submitBlock(OSMOS::IO::Block::Device *block, OSMOS::IO::Block::Request **requests, uint32_t count) {
+    OSMOS::IO::VirtioBlock::Device *device = (OSMOS::IO::VirtioBlock::Device *) block->driver;
+    uint32_t submitted = 0;
+
+    // Each buffer is its own frame, so it is a segment of the request
+    for (; submitted < count; submitted++) {
+        OSMOS::IO::Block::Request *blockRequest = requests[submitted];
+        OSMOS::IO::VirtioBlock::Request *request = &device->requests[blockRequest->identifier];
+
+        request->type = (blockRequest->type == OSMOS::IO::Block::REQUEST_WRITE ? OSMOS::IO::VirtioBlock::REQUEST_WRITE : OSMOS::IO::VirtioBlock::REQUEST_READ);
+        request->sector = (uint64_t) blockRequest->index * (OSMOS::IO::Block::BUFFER_SIZE / OSMOS::IO::VirtioBlock::SECTOR_SIZE);
+
+        for (uint32_t i = 0; i < blockRequest->count; i++) {
+            request->segments[i].address = (address_t) blockRequest->buffers[i]->data;
+            request->segments[i].length = OSMOS::IO::Block::BUFFER_SIZE;
+        }
+
+        request->segmentCount = blockRequest->count;
+        request->callback = OSMOS::IO::VirtioBlock::completeBlock;
+        request->data = blockRequest;
+
+        if (!OSMOS::IO::VirtioBlock::queue(device, request))
+            break;
+    }
+
+    if (submitted > 0)
+        OSMOS::IO::VirtioBlock::kick(device);
+
+    return submitted;
+}
+
+void OSMOS::IO::VirtioBlock::pollBlock(OSMOS::IO::Block::Device *block) {
+    OSMOS::IO::VirtioBlock::complete((OSMOS::IO::VirtioBlock::Device *) block->driver);
+}
+
+void OSMOS::IO::VirtioBlock::completeBlock(OSMOS::IO::VirtioBlock::Request *request) {
+    OSMOS::IO::Block::complete((OSMOS::IO::Block::Request *) request->data, request->status == OSMOS::IO::VirtioBlock::STATUS_OK);
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+/*
+ * The virtio block device driver class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef VIRTIOBLOCK_HPP
+#define VIRTIOBLOCK_HPP
+
+#include "../osmos.hpp"
+
+#include "block.hpp"
+#include "pci.hpp"
+#include "virtio.hpp"
+#include "../sys/deferred.hpp"
+#include "../sys/interrupts.hpp"
+
+namespace OSMOS {
+    namespace IO {
+        /**
+         * @brief VirtioBlock's class that drives the virtio block devices.
+         * Requests are queued without touching the device, then a whole batch
+         * is published with a single kick; they complete asynchronously from
+         * the interrupt handler, which calls their callback. Each device is
+         * also registered in the block layer
+         **/
+        class VirtioBlock {
+        public:
+            /**
+             * The maximum number of virtio block devices
+             **/
+            static const uint32_t DEVICE_MAXIMUM = 4;
+            /**
+             * The maximum number of buffers of a single request
+             **/
+            static const uint32_t SEGMENT_MAXIMUM = 32;
+            /**
+             * The size in bytes of a sector, the unit of the request positions
+             **/
+            static const uint32_t SECTOR_SIZE = 512;
+
+            /**
+             * The request types
+             **/
+            static uint32_t REQUEST_READ;
+            static uint32_t REQUEST_WRITE;
+            static uint32_t REQUEST_FLUSH;
+
+            /**
+             * The request statuses written by the device. The <i>pending</i>
+             * status is set by queue until the request completes
+             **/
+            static uint8_t STATUS_OK;
+            static uint8_t STATUS_ERROR;
+            static uint8_t STATUS_UNSUPPORTED;
+            static uint8_t STATUS_PENDING;
+
+            /**
+             * A buffer of a request, which must be physically contiguous
+             **/
+            struct Segment {
+                address_t address;
+                uint32_t length;
+            };
+
+            /**
+             * A request given to the driver. It belongs to the driver from
+             * queue until its callback is called
+             **/
+            struct Request {
+                /**
+                 * One of the REQUEST_* values of the VirtioBlock class
+                 **/
+                uint32_t type;
+                /**
+                 * The first sector of the transfer
+                 **/
+                uint64_t sector;
+                OSMOS::IO::VirtioBlock::Segment segments[SEGMENT_MAXIMUM];
+                uint32_t segmentCount;
+                /**
+                 * One of the STATUS_* values of the VirtioBlock class
+                 **/
+                volatile uint8_t status;
+                /**
+                 * The function called from the interrupt handler once the
+                 * request completed, or NULL
+                 **/
+                void (*callback)(OSMOS::IO::VirtioBlock::Request *request);
+                /**
+                 * Free for the owner of the request
+                 **/
+                void *data;
+            };
+
+            /**
+             * The header of a request, read by the device
+             **/
+            struct Header {
+                uint32_t type;
+                uint32_t reserved;
+                uint64_t sector;
+            } __attribute__((packed));
+
+            /**
+             * The driver memory attached to a ring descriptor: the header, the
+             * status byte and the indirect table of a request in flight
+             **/
+            struct Slot {
+                OSMOS::IO::VirtioBlock::Header header;
+                volatile uint8_t status;
+                uint8_t reserved[3];
+                OSMOS::IO::VirtioBlock::Request *request;
+                uint32_t padding[2];
+                OSMOS::IO::Virtio::Descriptor table[SEGMENT_MAXIMUM + 2];
+            } __attribute__((packed));
+
+            /**
+             * A virtio block device
+             **/
+            struct Device {
+                OSMOS::IO::PCI::Device *pci;
+                uint16_t port;
+                /**
+                 * The capacity of the device in sectors
+                 **/
+                uint64_t capacity;
+                /**
+                 * The maximum number of buffers the device accepts per request
+                 **/
+                uint32_t segmentMaximum;
+                bool indirect;
+                bool readOnly;
+                OSMOS::IO::Virtio::Queue queue;
+                /**
+                 * The slots, one per ring descriptor
+                 **/
+                OSMOS::IO::VirtioBlock::Slot *slots;
+                /**
+                 * The number of requests in flight
+                 **/
+                uint32_t inFlight;
+                /**
+                 * The number of requests and kicks, and the number of kicks
+                 * which really notified the device
+                 **/
+                uint32_t requestCount;
+                uint32_t kickCount;
+                uint32_t notifyCount;
+                uint32_t interruptCount;
+                /**
+                 * Set while the device waits in the deferred queue, which then
+                 * drains its whole used ring
+                 **/
+                volatile bool deferred;
+                /**
+                 * The device registered in the block layer, and the driver
+                 * requests used for its requests, by request identifier
+                 **/
+                OSMOS::IO::Block::Device block;
+                OSMOS::IO::VirtioBlock::Request requests[OSMOS::IO::Block::REQUEST_MAXIMUM];
+            };
+
+        private:
+            static OSMOS::IO::VirtioBlock::Device DEVICES[DEVICE_MAXIMUM];
+            static uint32_t DEVICE_COUNT;
+            /**
+             * The deferred queue completing the requests out of the IRQ
+             **/
+            static OSMOS::System::Deferred::Queue *QUEUE;
+
+            /**
+             * @brief Sets up a device found on the PCI bus
+             * @param pci the PCI function of the device
+             * @return true if the device is ready
+             **/
+            static bool probe(OSMOS::IO::PCI::Device *pci);
+            /**
+             * @brief Handles the IRQ of the virtio block devices
+             * @param frame the state of the interrupted code
+             **/
+            static void handleInterrupt(OSMOS::System::Interrupts::Frame *frame);
+            /**
+             * @brief Completes the requests of a device, as the bottom half
+             * of its IRQ
+             * @param data the device
+             **/
+            static void handleDeferred(void *data);
+
+            /**
+             * @brief Queues requests of the block layer and kicks the device
+             * once
+             * @param block the device of the block layer
+             * @param requests the requests to submit
+             * @param count the number of requests
+             * @return the number of requests submitted
+             **/
+            static uint32_t submitBlock(OSMOS::IO::Block::Device *block, OSMOS::IO::Block::Request **requests, uint32_t count);
+            /**
+             * @brief Completes the requests of a device without IRQ line
+             * @param block the device of the block layer
+             **/
+            static void pollBlock(OSMOS::IO::Block::Device *block);
+            /**
+             * @brief Gives a completed request back to the block layer
+             * @param request the driver request
+             **/
+            static void completeBlock(OSMOS::IO::VirtioBlock::Request *request);
+
+        public:
+            /**
+             * @brief Sets up every virtio block device found by the PCI
+             * enumeration and registers their IRQ handlers
+             * @return the number of devices ready
+             **/
+            static uint32_t initialize();
+            /**
+             * @brief Gets the number of devices ready
+             * @return the number of devices
+             **/
+            static uint32_t getDeviceCount();
+            /**
+             * @brief Gets a device
+             * @param index the index of the device
+             * @return the device, or NULL if the index is out of range
+             **/
+            static OSMOS::IO::VirtioBlock::Device *getDevice(uint32_t index);
+
+            /**
+             * @brief Puts a request in the available ring. The device does not
+             * see it before the next kick
+             * @param device the device to use
+             * @param request the request to queue
+             * @return false if the ring is full or the request is invalid
+             **/
+            static bool queue(OSMOS::IO::VirtioBlock::Device *device, OSMOS::IO::VirtioBlock::Request *request);
+            /**
+             * @brief Publishes the queued requests, notifying the device once
+             * for the whole batch if it needs it
+             * @param device the device to kick
+             **/
+            static void kick(OSMOS::IO::VirtioBlock::Device *device);
+            /**
+             * @brief Queues several requests and kicks the device once
+             * @param device the device to use
+             * @param requests the requests to submit
+             * @param count the number of requests
+             * @return the number of requests submitted, the next ones did not
+             * fit in the ring
+             **/
+            static uint32_t submit(OSMOS::IO::VirtioBlock::Device *device, OSMOS::IO::VirtioBlock::Request **requests, uint32_t count);
+            /**
+             * @brief Completes the requests processed by the device and calls
+             * their callbacks. It is called by the interrupt handler, but can
+             * also be used to poll the device with the interrupts disabled
+             * @param device the device to complete
+             * @return the number of completed requests
+             **/
+            static uint32_t complete(OSMOS::IO::VirtioBlock::Device *device);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
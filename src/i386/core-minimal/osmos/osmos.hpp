@@ -28,12 +28,12 @@
 typedef unsigned char                    uint8_t;
 typedef unsigned short                   uint16_t;
 typedef unsigned int                     uint32_t;
-typedef unsigned long                    uint64_t;
+typedef unsigned long long               uint64_t;
 
 typedef signed char                      int8_t;
 typedef signed short                     int16_t;
 typedef signed int                       int32_t;
-typedef signed long                      int64_t;
+typedef signed long long                 int64_t;
 
 // Processor specific address size
 typedef uint32_t                         address_t;
@@ -66,6 +66,14 @@ namespace OSMOS {
     namespace IO {
         
     };
+
+    /**
+     * @brief The FS (File System) namespace allows you to read the partitions
+     * and the filesystems of the block devices
+     **/
+    namespace FS {
+        
+    };
 };
 
 #endif
\ No newline at end of file
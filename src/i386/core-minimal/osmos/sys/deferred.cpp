@@ -0,0 +1,211 @@
+/*
+ * The deferred work class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "deferred.hpp"
+
+#include "interrupts.hpp"
+#include "processor.hpp"
+#include "../io/timer.hpp"
+
+OSMOS::System::Deferred::Queue OSMOS::System::Deferred::QUEUES[OSMOS::System::Deferred::QUEUE_MAXIMUM];
+uint32_t OSMOS::System::Deferred::QUEUE_COUNT               = 0;
+uint32_t OSMOS::System::Deferred::NEXT                      = 0;
+bool OSMOS::System::Deferred::RUNNING                       = false;
+OSMOS::System::Scheduler::Thread *OSMOS::System::Deferred::WORKER = NULL;
+bool OSMOS::System::Deferred::TIMESTAMP                     = false;
+
+bool OSMOS::System::Deferred::initialize() {
+    OSMOS::System::Deferred::QUEUE_COUNT = 0;
+    OSMOS::System::Deferred::NEXT = 0;
+    OSMOS::System::Deferred::RUNNING = false;
+    OSMOS::System::Deferred::TIMESTAMP = OSMOS::System::Processor::hasFeature(OSMOS::System::Processor::FEATURE_TSC);
+
+    OSMOS::System::Deferred::WORKER = OSMOS::System::Scheduler::create(OSMOS::System::Deferred::runWorker, NULL);
+    return OSMOS::System::Deferred::WORKER != NULL;
+}
+
+OSMOS::System::Deferred::Queue *OSMOS::System::Deferred::create(const char *name, OSMOS::System::Deferred::Handler handler) {
+    if (OSMOS::System::Deferred::QUEUE_COUNT >= OSMOS::System::Deferred::QUEUE_MAXIMUM)
+        return NULL;
+
+    OSMOS::System::Deferred::Queue *queue = &OSMOS::System::Deferred::QUEUES[OSMOS::System::Deferred::QUEUE_COUNT];
+    queue->head = 0;
+    queue->tail = 0;
+    queue->handler = handler;
+    queue->name = name;
+    queue->rateStart = 0;
+    queue->rateTick = OSMOS::IO::Timer::getTicks();
+
+    queue->statistics.enqueued = 0;
+    queue->statistics.dropped = 0;
+    queue->statistics.processed = 0;
+    queue->statistics.batches = 0;
+    queue->statistics.batchMaximum = 0;
+    queue->statistics.deferred = 0;
+    queue->statistics.rate = 0;
+    queue->statistics.delay = 0;
+    queue->statistics.delayMaximum = 0;
+
+    // The queue is only visible to the bottom halves once filled
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    OSMOS::System::Deferred::QUEUE_COUNT++;
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return queue;
+}
+
+bool OSMOS::System::Deferred::enqueue(OSMOS::System::Deferred::Queue *queue, void *data) {
+    uint32_t tail = queue->tail;
+
+    if (tail - queue->head >= OSMOS::System::Deferred::QUEUE_SIZE) {
+        queue->statistics.dropped++;
+        return false;
+    }
+
+    OSMOS::System::Deferred::Item *item = &queue->items[tail & (OSMOS::System::Deferred::QUEUE_SIZE - 1)];
+    item->data = data;
+    item->timestamp = (OSMOS::System::Deferred::TIMESTAMP ? OSMOS::System::Processor::readTimestamp() : 0);
+
+    // The item is written before it is published
+    asm volatile("" : : : "memory");
+    queue->tail = tail + 1;
+    queue->statistics.enqueued++;
+
+    return true;
+}
+
+bool OSMOS::System::Deferred::isPending() {
+    for (uint32_t i = 0; i < OSMOS::System::Deferred::QUEUE_COUNT; i++) {
+        if (OSMOS::System::Deferred::QUEUES[i].head != OSMOS::System::Deferred::QUEUES[i].tail)
+            return true;
+    }
+
+    return false;
+}
+
+bool OSMOS::System::Deferred::process() {
+    uint32_t budget = OSMOS::System::Deferred::BUDGET;
+    uint32_t idle = 0;
+
+    OSMOS::System::Interrupts::enable();
+
+    // The queues are visited in turn until the budget is spent or a whole
+    // turn finds them empty
+    while (budget > 0 && idle < OSMOS::System::Deferred::QUEUE_COUNT) {
+        OSMOS::System::Deferred::Queue *queue = &OSMOS::System::Deferred::QUEUES[OSMOS::System::Deferred::NEXT];
+        OSMOS::System::Deferred::NEXT = (OSMOS::System::Deferred::NEXT + 1) % OSMOS::System::Deferred::QUEUE_COUNT;
+
+        if (queue->head == queue->tail) {
+            idle++;
+            continue;
+        }
+
+        uint64_t timestamp = (OSMOS::System::Deferred::TIMESTAMP ? OSMOS::System::Processor::readTimestamp() : 0);
+        uint32_t batch = 0;
+
+        while (batch < OSMOS::System::Deferred::BATCH_MAXIMUM && batch < budget && queue->head != queue->tail) {
+            OSMOS::System::Deferred::Item *item = &queue->items[queue->head & (OSMOS::System::Deferred::QUEUE_SIZE - 1)];
+            void *data = item->data;
+            uint64_t delay = timestamp - item->timestamp;
+
+            // The item is read before its slot is given back
+            asm volatile("" : : : "memory");
+            queue->head = queue->head + 1;
+
+            queue->statistics.delay += delay;
+            if (delay > queue->statistics.delayMaximum)
+                queue->statistics.delayMaximum = (delay >> 32 ? 0xFFFFFFFF : (uint32_t) delay);
+
+            queue->handler(data);
+            batch++;
+        }
+
+        queue->statistics.processed += batch;
+        queue->statistics.batches++;
+        if (batch > queue->statistics.batchMaximum)
+            queue->statistics.batchMaximum = batch;
+
+        budget -= batch;
+        idle = 0;
+    }
+
+    OSMOS::System::Interrupts::disable();
+
+    bool left = false;
+    uint32_t now = OSMOS::IO::Timer::getTicks();
+
+    for (uint32_t i = 0; i < OSMOS::System::Deferred::QUEUE_COUNT; i++) {
+        OSMOS::System::Deferred::Queue *queue = &OSMOS::System::Deferred::QUEUES[i];
+
+        if (queue->head != queue->tail) {
+            queue->statistics.deferred++;
+            left = true;
+        }
+
+        if (now - queue->rateTick >= OSMOS::IO::Timer::FREQUENCY) {
+            queue->statistics.rate = queue->statistics.enqueued - queue->rateStart;
+            queue->rateStart = queue->statistics.enqueued;
+            queue->rateTick = now;
+        }
+    }
+
+    return left;
+}
+
+void OSMOS::System::Deferred::run() {
+    if (OSMOS::System::Deferred::RUNNING || !OSMOS::System::Deferred::isPending())
+        return;
+
+    // The IRQs coming meanwhile only enqueue their items, which this run
+    // picks up within its budget
+    OSMOS::System::Deferred::RUNNING = true;
+    bool left = OSMOS::System::Deferred::process();
+    OSMOS::System::Deferred::RUNNING = false;
+
+    if (left && OSMOS::System::Deferred::WORKER != NULL)
+        OSMOS::System::Scheduler::wake(OSMOS::System::Deferred::WORKER);
+}
+
+void OSMOS::System::Deferred::runWorker(void *) {
+    for (;;) {
+        OSMOS::System::Interrupts::disable();
+
+        // A bottom half never yields, so none is running here
+        while (!OSMOS::System::Deferred::isPending())
+            OSMOS::System::Scheduler::block();
+
+        OSMOS::System::Deferred::RUNNING = true;
+        OSMOS::System::Deferred::process();
+        OSMOS::System::Deferred::RUNNING = false;
+
+        OSMOS::System::Interrupts::enable();
+        OSMOS::System::Scheduler::yield();
+    }
+}
+
+uint32_t OSMOS::System::Deferred::getQueueCount() {
+    return OSMOS::System::Deferred::QUEUE_COUNT;
+}
+
+OSMOS::System::Deferred::Queue *OSMOS::System::Deferred::getQueue(uint32_t index) {
+    return (index < OSMOS::System::Deferred::QUEUE_COUNT ? &OSMOS::System::Deferred::QUEUES[index] : NULL);
+}
\ No newline at end of file
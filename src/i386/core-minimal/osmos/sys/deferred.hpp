@@ -0,0 +1,197 @@
+/*
+ * The deferred work class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEFERRED_HPP
+#define DEFERRED_HPP
+
+#include "../osmos.hpp"
+
+#include "scheduler.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Deferred's class that runs the work of the interrupt handlers
+         * out of them. A handler (the top half) only acknowledges its device
+         * and enqueues an item, then the items are processed in batches (the
+         * bottom halves) with the interrupts enabled, when the outermost IRQ
+         * returns. A run processes at most BUDGET items, the rest being left
+         * to the worker thread
+         **/
+        class Deferred {
+        public:
+            /**
+             * The maximum number of queues
+             **/
+            static const uint32_t QUEUE_MAXIMUM = 8;
+            /**
+             * The number of items of a queue, a power of 2
+             **/
+            static const uint32_t QUEUE_SIZE = 64;
+            /**
+             * The maximum number of items processed from a queue before the
+             * next queue is visited, and by a whole run
+             **/
+            static const uint32_t BATCH_MAXIMUM = 16;
+            static const uint32_t BUDGET = 64;
+
+            /**
+             * A function processing the items of a queue
+             **/
+            typedef void (*Handler)(void *data);
+
+            /**
+             * An item of a queue
+             **/
+            struct Item {
+                void *data;
+                /**
+                 * The timestamp counter when the item was enqueued
+                 **/
+                uint64_t timestamp;
+            };
+
+            /**
+             * The counters of a queue, which tell if the budget fits the rate
+             * of its interrupts
+             **/
+            struct Statistics {
+                uint32_t enqueued;
+                /**
+                 * The items refused because the queue was full
+                 **/
+                uint32_t dropped;
+                uint32_t processed;
+                uint32_t batches;
+                uint32_t batchMaximum;
+                /**
+                 * The runs which left items of the queue to the worker thread
+                 **/
+                uint32_t deferred;
+                /**
+                 * The number of items enqueued during the last second
+                 **/
+                uint32_t rate;
+                /**
+                 * The total and the maximum number of cycles spent by the
+                 * items in the queue
+                 **/
+                uint64_t delay;
+                uint32_t delayMaximum;
+            };
+
+            /**
+             * A queue, filled by a top half and emptied by the bottom halves.
+             * The first only moves the tail, the second only the head, so
+             * neither takes a lock nor disables the interrupts
+             **/
+            struct Queue {
+                OSMOS::System::Deferred::Item items[QUEUE_SIZE];
+                volatile uint32_t head;
+                volatile uint32_t tail;
+                OSMOS::System::Deferred::Handler handler;
+                const char *name;
+                /**
+                 * The items enqueued and the tick at the start of the second
+                 * measuring the rate
+                 **/
+                uint32_t rateStart;
+                uint32_t rateTick;
+                OSMOS::System::Deferred::Statistics statistics;
+            };
+
+        private:
+            static OSMOS::System::Deferred::Queue QUEUES[QUEUE_MAXIMUM];
+            static uint32_t QUEUE_COUNT;
+            /**
+             * The next queue visited by a run, so every queue gets its share
+             * of the budget
+             **/
+            static uint32_t NEXT;
+            /**
+             * Set while the items are processed, by a bottom half or the
+             * worker thread, so there is a single consumer
+             **/
+            static bool RUNNING;
+            static OSMOS::System::Scheduler::Thread *WORKER;
+            static bool TIMESTAMP;
+
+            /**
+             * @brief Checks if a queue has items
+             * @return true if an item is waiting
+             **/
+            static bool isPending();
+            /**
+             * @brief Processes the items of the queues, at most BUDGET. The
+             * interrupts are enabled meanwhile
+             * @return true if items are left
+             **/
+            static bool process();
+            /**
+             * @brief The function of the worker thread, which processes the
+             * items left by the bottom halves, yielding between the runs
+             **/
+            static void runWorker(void *);
+
+        public:
+            /**
+             * @brief Initializes the queues and creates the worker thread. It
+             * must be called after the scheduler is initialized
+             * @return false if the worker thread could not be created
+             **/
+            static bool initialize();
+
+            /**
+             * @brief Creates a queue
+             * @param name the name of the queue
+             * @param handler the function processing its items
+             * @return the queue, or NULL if every queue is used
+             **/
+            static OSMOS::System::Deferred::Queue *create(const char *name, OSMOS::System::Deferred::Handler handler);
+            /**
+             * @brief Enqueues an item. It is called by a top half, with the
+             * interrupts disabled
+             * @param queue the queue
+             * @param data the data given to the handler of the queue
+             * @return false if the queue is full, the caller then doing the
+             * work itself
+             **/
+            static bool enqueue(OSMOS::System::Deferred::Queue *queue, void *data);
+            /**
+             * @brief Runs the bottom halves, unless they are already running.
+             * It is called by dispatch once an IRQ is acknowledged, and wakes
+             * the worker thread if the budget is spent
+             **/
+            static void run();
+
+            /**
+             * @brief Gets the number of queues
+             * @return the number of queues
+             **/
+            static uint32_t getQueueCount();
+            /**
+             * @brief Gets a queue
+             * @param index the index of the queue
+             * @return the queue, or NULL if the index is out of range
+             **/
+            static OSMOS::System::Deferred::Queue *getQueue(uint32_t index);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+/*
+ * The ELF loader class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "elf.hpp"
+
+uint32_t OSMOS::System::ELF::read(OSMOS::System::ELF::Source *source, uint32_t offset, uint8_t *target, uint32_t length) {
+    if (source->object != NULL)
+        return OSMOS::FS::PageCache::read(source->object, offset, target, length);
+
+    return OSMOS::FS::Initramfs::read(source->file, offset, target, length);
+}
+
+bool OSMOS::System::ELF::map(OSMOS::System::ELF::Source *source, OSMOS::System::Paging::Space *space, address_t address, uint32_t length, uint32_t offset, uint32_t dataLength, uint8_t flags) {
+    if (source->object != NULL)
+        return OSMOS::FS::PageCache::mapFile(space, address, length, source->object, offset, dataLength, flags);
+
+    return OSMOS::FS::Initramfs::mapFile(space, address, length, source->file, offset, dataLength, flags);
+}
+
+bool OSMOS::System::ELF::loadSource(OSMOS::System::Paging::Space *space, OSMOS::System::ELF::Source *source, address_t *entry) {
+    OSMOS::System::ELF::Header header;
+
+    if (OSMOS::System::ELF::read(source, 0, (uint8_t *) &header, sizeof(header)) != sizeof(header))
+        return false;
+
+    if (header.identification[0] != 0x7F || header.identification[1] != 'E' || header.identification[2] != 'L' || header.identification[3] != 'F')
+        return false;
+
+    if (header.identification[4] != OSMOS::System::ELF::CLASS_32 || header.identification[5] != OSMOS::System::ELF::DATA_LITTLE_ENDIAN)
+        return false;
+
+    if (header.type != OSMOS::System::ELF::TYPE_EXECUTABLE || header.machine != OSMOS::System::ELF::MACHINE_386)
+        return false;
+
+    if (header.programHeaderSize != sizeof(OSMOS::System::ELF::ProgramHeader) || header.programHeaderCount > OSMOS::System::ELF::SEGMENT_MAXIMUM)
+        return false;
+
+    OSMOS::System::ELF::ProgramHeader segments[OSMOS::System::ELF::SEGMENT_MAXIMUM];
+    uint32_t length = header.programHeaderCount * sizeof(OSMOS::System::ELF::ProgramHeader);
+
+    if (OSMOS::System::ELF::read(source, header.programHeaderOffset, (uint8_t *) segments, length) != length)
+        return false;
+
+    for (uint32_t i = 0; i < header.programHeaderCount; i++) {
+        OSMOS::System::ELF::ProgramHeader *segment = &segments[i];
+
+        if (segment->type != OSMOS::System::ELF::SEGMENT_LOAD || segment->memorySize == 0)
+            continue;
+
+        // The mappings start on a page, so the segment must have the same
+        // position in its page in the file and in memory
+        uint32_t skew = segment->virtualAddress % OSMOS::System::Paging::PAGE_SIZE;
+        if (segment->fileSize > segment->memorySize || segment->offset % OSMOS::System::Paging::PAGE_SIZE != skew)
+            return false;
+
+        if (segment->memorySize > OSMOS::System::Paging::USER_LIMIT - OSMOS::System::Paging::USER_BASE)
+            return false;
+
+        // A writable segment gets private copies of the written pages, the
+        // others borrow the pages of the source
+        uint8_t flags = OSMOS::System::Paging::MAPPING_USER | OSMOS::System::Paging::MAPPING_PRIVATE;
+        if (segment->flags & OSMOS::System::ELF::SEGMENT_WRITABLE)
+            flags |= OSMOS::System::Paging::MAPPING_WRITABLE;
+
+        if (!OSMOS::System::ELF::map(source, space, segment->virtualAddress - skew, segment->memorySize + skew, segment->offset - skew, segment->fileSize + skew, flags))
+            return false;
+    }
+
+    if (!OSMOS::System::Paging::check(space, header.entry, 1, false))
+        return false;
+
+    *entry = header.entry;
+    return true;
+}
+
+bool OSMOS::System::ELF::load(OSMOS::System::Paging::Space *space, OSMOS::FS::PageCache::Object *object, address_t *entry) {
+    OSMOS::System::ELF::Source source = {object, NULL};
+
+    return OSMOS::System::ELF::loadSource(space, &source, entry);
+}
+
+bool OSMOS::System::ELF::load(OSMOS::System::Paging::Space *space, OSMOS::FS::Initramfs::File *file, address_t *entry) {
+    OSMOS::System::ELF::Source source = {NULL, file};
+
+    return OSMOS::System::ELF::loadSource(space, &source, entry);
+}
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*
+ * The ELF loader class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELF_HPP
+#define ELF_HPP
+
+#include "../osmos.hpp"
+
+#include "paging.hpp"
+#include "../fs/initramfs.hpp"
+#include "../fs/pagecache.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief ELF's class that loads the 32-bit x86 executables. Nothing is
+         * copied: the loadable segments are mapped from the page cache or from
+         * the initramfs, and their pages are only read, lent or copied when
+         * the process first touches them
+         **/
+        class ELF {
+        public:
+            /**
+             * The maximum number of program headers of an executable
+             **/
+            static const uint32_t SEGMENT_MAXIMUM = 16;
+
+            /**
+             * The values of the header checked by load
+             **/
+            static const uint8_t CLASS_32 = 1;
+            static const uint8_t DATA_LITTLE_ENDIAN = 1;
+            static const uint16_t TYPE_EXECUTABLE = 2;
+            static const uint16_t MACHINE_386 = 3;
+
+            /**
+             * The type of the loadable segments, and the flag of the writable
+             * ones
+             **/
+            static const uint32_t SEGMENT_LOAD = 1;
+            static const uint32_t SEGMENT_WRITABLE = 2;
+
+            /**
+             * The header of an executable
+             **/
+            struct Header {
+                uint8_t identification[16];
+                uint16_t type;
+                uint16_t machine;
+                uint32_t version;
+                uint32_t entry;
+                uint32_t programHeaderOffset;
+                uint32_t sectionHeaderOffset;
+                uint32_t flags;
+                uint16_t headerSize;
+                uint16_t programHeaderSize;
+                uint16_t programHeaderCount;
+                uint16_t sectionHeaderSize;
+                uint16_t sectionHeaderCount;
+                uint16_t sectionNameIndex;
+            } __attribute__((packed));
+
+            /**
+             * A program header, describing a segment
+             **/
+            struct ProgramHeader {
+                uint32_t type;
+                uint32_t offset;
+                uint32_t virtualAddress;
+                uint32_t physicalAddress;
+                uint32_t fileSize;
+                uint32_t memorySize;
+                uint32_t flags;
+                uint32_t alignment;
+            } __attribute__((packed));
+
+        private:
+            /**
+             * An executable being loaded: a file of the page cache, or else a
+             * file of the initramfs
+             **/
+            struct Source {
+                OSMOS::FS::PageCache::Object *object;
+                OSMOS::FS::Initramfs::File *file;
+            };
+
+            /**
+             * @brief Copies bytes of an executable
+             * @param source the executable
+             * @param offset the position of the bytes in the file
+             * @param target the memory to copy to
+             * @param length the number of bytes to copy
+             * @return the number of bytes copied
+             **/
+            static uint32_t read(OSMOS::System::ELF::Source *source, uint32_t offset, uint8_t *target, uint32_t length);
+            /**
+             * @brief Maps a part of an executable, as the mapFile functions of
+             * its source do
+             * @return false if the mapping could not be added
+             **/
+            static bool map(OSMOS::System::ELF::Source *source, OSMOS::System::Paging::Space *space, address_t address, uint32_t length, uint32_t offset, uint32_t dataLength, uint8_t flags);
+            /**
+             * @brief Checks the header of an executable and maps its loadable
+             * segments
+             * @param space the address space
+             * @param source the executable
+             * @param entry the pointer receiving the first address of the code
+             * @return false if the executable is invalid or a segment could not
+             * be mapped
+             **/
+            static bool loadSource(OSMOS::System::Paging::Space *space, OSMOS::System::ELF::Source *source, address_t *entry);
+
+        public:
+            /**
+             * @brief Maps the loadable segments of an executable in an address
+             * space. The bytes of a segment after its data in the file are
+             * zeroed
+             * @param space the address space
+             * @param object the object of the executable in the page cache,
+             * kept open by the mappings
+             * @param entry the pointer receiving the first address of the code
+             * @return false if the executable is invalid or a segment could not
+             * be mapped, some segments being possibly mapped
+             **/
+            static bool load(OSMOS::System::Paging::Space *space, OSMOS::FS::PageCache::Object *object, address_t *entry);
+            /**
+             * @brief Maps the loadable segments of an executable of the
+             * initramfs in an address space. Its pages are lent by the memory
+             * of the module
+             * @param space the address space
+             * @param file the file of the executable
+             * @param entry the pointer receiving the first address of the code
+             * @return false if the executable is invalid or a segment could not
+             * be mapped, some segments being possibly mapped
+             **/
+            static bool load(OSMOS::System::Paging::Space *space, OSMOS::FS::Initramfs::File *file, address_t *entry);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
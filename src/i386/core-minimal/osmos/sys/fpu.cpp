@@ -0,0 +1,123 @@
+/*
+ * The FPU/SSE context class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "fpu.hpp"
+
+#include "memory.hpp"
+#include "processor.hpp"
+
+OSMOS::System::FPU::State *OSMOS::System::FPU::OWNER            = NULL;
+OSMOS::System::FPU::State *OSMOS::System::FPU::CURRENT          = NULL;
+OSMOS::System::FPU::State OSMOS::System::FPU::INITIAL;
+uint32_t OSMOS::System::FPU::KERNEL_NESTING                     = 0;
+bool OSMOS::System::FPU::ENABLED                                = false;
+
+static inline void fpuSave(OSMOS::System::FPU::State *state) {
+    asm volatile("fxsave [%[area]]"
+                :
+                : [area] "r" (state->area)
+                : "memory");
+}
+
+static inline void fpuRestore(OSMOS::System::FPU::State *state) {
+    asm volatile("fxrstor [%[area]]"
+                :
+                : [area] "r" (state->area)
+                : "memory");
+}
+
+bool OSMOS::System::FPU::initialize(OSMOS::System::FPU::State *state) {
+    OSMOS::System::FPU::CURRENT = state;
+
+    if (!OSMOS::System::Processor::enableSSE())
+        return false;
+
+    // The registers hold the values of fninit, with all the SSE exceptions
+    // masked (MXCSR = 0x1F80)
+    fpuSave(&OSMOS::System::FPU::INITIAL);
+    OSMOS::System::FPU::initializeState(state);
+    OSMOS::System::FPU::OWNER = state;
+
+    OSMOS::System::Interrupts::setHandler(OSMOS::System::Interrupts::VECTOR_DEVICE_NOT_AVAILABLE, OSMOS::System::FPU::handleDeviceNotAvailable);
+    OSMOS::System::FPU::ENABLED = true;
+    return true;
+}
+
+bool OSMOS::System::FPU::isEnabled() {
+    return OSMOS::System::FPU::ENABLED;
+}
+
+void OSMOS::System::FPU::initializeState(OSMOS::System::FPU::State *state) {
+    OSMOS::System::Memory::copy((uint32_t *) state->area, (uint32_t *) OSMOS::System::FPU::INITIAL.area, sizeof(state->area) / 4);
+}
+
+void OSMOS::System::FPU::switchContext(OSMOS::System::FPU::State *state) {
+    OSMOS::System::FPU::CURRENT = state;
+
+    if (!OSMOS::System::FPU::ENABLED)
+        return;
+
+    // Coming back to the owner of the registers costs nothing, any other
+    // thread traps on its first FPU/SSE instruction
+    if (OSMOS::System::FPU::OWNER == state)
+        OSMOS::System::Processor::clearTaskSwitched();
+    else
+        OSMOS::System::Processor::setTaskSwitched();
+}
+
+void OSMOS::System::FPU::release(OSMOS::System::FPU::State *state) {
+    // The registers are dropped without being saved
+    if (OSMOS::System::FPU::OWNER == state)
+        OSMOS::System::FPU::OWNER = NULL;
+}
+
+void OSMOS::System::FPU::handleDeviceNotAvailable(OSMOS::System::Interrupts::Frame *frame) {
+    (void) frame;
+
+    OSMOS::System::Processor::clearTaskSwitched();
+
+    if (OSMOS::System::FPU::OWNER == OSMOS::System::FPU::CURRENT)
+        return;
+
+    if (OSMOS::System::FPU::OWNER != NULL)
+        fpuSave(OSMOS::System::FPU::OWNER);
+
+    fpuRestore(OSMOS::System::FPU::CURRENT);
+    OSMOS::System::FPU::OWNER = OSMOS::System::FPU::CURRENT;
+}
+
+void OSMOS::System::FPU::beginKernelSection() {
+    if (!OSMOS::System::FPU::ENABLED || OSMOS::System::FPU::KERNEL_NESTING++ > 0)
+        return;
+
+    OSMOS::System::Processor::clearTaskSwitched();
+
+    if (OSMOS::System::FPU::OWNER != NULL) {
+        fpuSave(OSMOS::System::FPU::OWNER);
+        OSMOS::System::FPU::OWNER = NULL;
+    }
+}
+
+void OSMOS::System::FPU::endKernelSection() {
+    if (!OSMOS::System::FPU::ENABLED || --OSMOS::System::FPU::KERNEL_NESTING > 0)
+        return;
+
+    // The registers hold kernel values now: the thread reloads its own state
+    // on its next FPU/SSE instruction
+    OSMOS::System::Processor::setTaskSwitched();
+}
\ No newline at end of file
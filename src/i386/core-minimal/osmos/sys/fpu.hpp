@@ -0,0 +1,127 @@
+/*
+ * The FPU/SSE context class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FPU_HPP
+#define FPU_HPP
+
+#include "../osmos.hpp"
+
+#include "interrupts.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief FPU's class that switches the x87/SSE registers between
+         * threads lazily. A context switch only sets CR0.TS; the registers are
+         * saved and restored by the #NM handler when the new thread really
+         * executes an FPU/SSE instruction, so threads that never touch them
+         * never pay for fxsave/fxrstor
+         **/
+        class FPU {
+        public:
+            /**
+             * The fxsave/fxrstor area of a thread, which must be 16 bytes
+             * aligned
+             **/
+            struct State {
+                uint8_t area[512];
+            } __attribute__((aligned(16)));
+
+        private:
+            /**
+             * The state whose values are currently loaded in the registers, or
+             * NULL if none
+             **/
+            static OSMOS::System::FPU::State *OWNER;
+            /**
+             * The state of the running thread
+             **/
+            static OSMOS::System::FPU::State *CURRENT;
+            /**
+             * The state right after fninit, copied into every new thread
+             **/
+            static OSMOS::System::FPU::State INITIAL;
+            /**
+             * The nesting level of the kernel vector sections
+             **/
+            static uint32_t KERNEL_NESTING;
+            /**
+             * Whether the FPU and SSE have been enabled
+             **/
+            static bool ENABLED;
+
+        public:
+            /**
+             * @brief Enables the FPU and SSE, captures the initial state and
+             * installs the #NM handler
+             * @param state the state of the running (boot) thread
+             * @return true if SSE is available and enabled
+             **/
+            static bool initialize(OSMOS::System::FPU::State *state);
+            /**
+             * @brief Checks if the FPU and SSE have been enabled
+             * @return true if initialize succeeded
+             **/
+            static bool isEnabled();
+
+            /**
+             * @brief Fills a state with the initial values of the registers
+             * @param state the state to fill
+             **/
+            static void initializeState(OSMOS::System::FPU::State *state);
+
+            /**
+             * @brief Tells that the processor is now running the thread owning
+             * the given state. Nothing is saved: CR0.TS is set unless the
+             * registers already hold the state
+             * @param state the state of the next thread
+             **/
+            static void switchContext(OSMOS::System::FPU::State *state);
+            /**
+             * @brief Forgets the registers loaded from a state, whose thread
+             * is ending. Its slot may be reused by a new thread, which must
+             * load its own initial state instead
+             * @param state the state of the ending thread
+             **/
+            static void release(OSMOS::System::FPU::State *state);
+
+            /**
+             * @brief Handles the exception #NM: saves the registers into their
+             * owner and loads the state of the running thread
+             * @param frame the state of the interrupted code
+             **/
+            static void handleDeviceNotAvailable(OSMOS::System::Interrupts::Frame *frame);
+
+            /**
+             * @brief Begins a kernel section using the FPU/SSE registers. The
+             * values of the running thread are saved first, so they are
+             * preserved. Sections can be nested, but must not be used by
+             * interrupt handlers. A section must not yield or block: its
+             * nesting level is shared by every thread
+             **/
+            static void beginKernelSection();
+            /**
+             * @brief Ends a kernel section using the FPU/SSE registers. The
+             * registers will be reloaded on the next use by the thread
+             **/
+            static void endKernelSection();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
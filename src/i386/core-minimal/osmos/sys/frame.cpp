@@ -0,0 +1,177 @@
+/*
+ * The page frame allocation class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "frame.hpp"
+
+address_t OSMOS::System::Frame::FRAME_BASE_ADDRESS          = 0;
+uint32_t OSMOS::System::Frame::FRAME_COUNT                  = 0;
+uint32_t OSMOS::System::Frame::FRAME_FREE_COUNT             = 0;
+uint32_t OSMOS::System::Frame::FRAME_HINT                   = 0;
+uint32_t OSMOS::System::Frame::BITMAP[OSMOS::System::Frame::FRAME_MAXIMUM / 32];
+OSMOS::System::Frame::Reclaimer OSMOS::System::Frame::RECLAIMERS[OSMOS::System::Frame::RECLAIMER_MAXIMUM];
+uint32_t OSMOS::System::Frame::RECLAIMER_COUNT              = 0;
+bool OSMOS::System::Frame::RECLAIMING                       = false;
+
+void OSMOS::System::Frame::initialize(address_t base, address_t limit) {
+    base = (base + OSMOS::System::Frame::FRAME_SIZE - 1) & ~(OSMOS::System::Frame::FRAME_SIZE - 1);
+
+    uint32_t count = (limit > base ? (limit - base) / OSMOS::System::Frame::FRAME_SIZE : 0);
+    if (count > OSMOS::System::Frame::FRAME_MAXIMUM)
+        count = OSMOS::System::Frame::FRAME_MAXIMUM;
+
+    for (uint32_t i = 0; i < OSMOS::System::Frame::FRAME_MAXIMUM / 32; i++)
+        OSMOS::System::Frame::BITMAP[i] = 0;
+
+    OSMOS::System::Frame::FRAME_BASE_ADDRESS = base;
+    OSMOS::System::Frame::FRAME_COUNT = count;
+    OSMOS::System::Frame::FRAME_FREE_COUNT = count;
+    OSMOS::System::Frame::FRAME_HINT = 0;
+}
+
+address_t OSMOS::System::Frame::getBaseAddress() {
+    return OSMOS::System::Frame::FRAME_BASE_ADDRESS;
+}
+
+address_t OSMOS::System::Frame::getLimitAddress() {
+    return OSMOS::System::Frame::FRAME_BASE_ADDRESS + OSMOS::System::Frame::FRAME_COUNT * OSMOS::System::Frame::FRAME_SIZE;
+}
+
+uint32_t OSMOS::System::Frame::getFreeCount() {
+    return OSMOS::System::Frame::FRAME_FREE_COUNT;
+}
+
+uint32_t OSMOS::System::Frame::search(uint32_t start, uint32_t end, uint32_t count) {
+    uint32_t length = 0;
+
+    for (uint32_t frame = start; frame < end; frame++) {
+        // Whole allocated words are skipped at once
+        if ((frame & 31) == 0 && OSMOS::System::Frame::BITMAP[frame / 32] == 0xFFFFFFFF) {
+            length = 0;
+            frame += 31;
+            continue;
+        }
+
+        if (OSMOS::System::Frame::BITMAP[frame / 32] & (1U << (frame & 31))) {
+            length = 0;
+            continue;
+        }
+
+        if (++length == count)
+            return frame + 1 - count;
+    }
+
+    return OSMOS::System::Frame::FRAME_MAXIMUM;
+}
+
+address_t OSMOS::System::Frame::allocate() {
+    return OSMOS::System::Frame::allocate(1);
+}
+
+uint32_t OSMOS::System::Frame::find(uint32_t count) {
+    if (count > OSMOS::System::Frame::FRAME_FREE_COUNT)
+        return OSMOS::System::Frame::FRAME_MAXIMUM;
+
+    // Next fit: the search begins after the last allocation, then wraps
+    uint32_t first = OSMOS::System::Frame::search(OSMOS::System::Frame::FRAME_HINT, OSMOS::System::Frame::FRAME_COUNT, count);
+    if (first == OSMOS::System::Frame::FRAME_MAXIMUM)
+        first = OSMOS::System::Frame::search(0, OSMOS::System::Frame::FRAME_COUNT, count);
+
+    return first;
+}
+
+uint32_t OSMOS::System::Frame::reclaim(uint32_t count) {
+    if (OSMOS::System::Frame::RECLAIMING)
+        return 0;
+
+    if (count < OSMOS::System::Frame::RECLAIM_MINIMUM)
+        count = OSMOS::System::Frame::RECLAIM_MINIMUM;
+
+    OSMOS::System::Frame::RECLAIMING = true;
+
+    uint32_t freed = 0;
+    for (uint32_t i = 0; i < OSMOS::System::Frame::RECLAIMER_COUNT && freed < count; i++)
+        freed += OSMOS::System::Frame::RECLAIMERS[i](count - freed);
+
+    OSMOS::System::Frame::RECLAIMING = false;
+    return freed;
+}
+
+bool OSMOS::System::Frame::addReclaimer(OSMOS::System::Frame::Reclaimer reclaimer) {
+    if (OSMOS::System::Frame::RECLAIMER_COUNT == OSMOS::System::Frame::RECLAIMER_MAXIMUM)
+        return false;
+
+    OSMOS::System::Frame::RECLAIMERS[OSMOS::System::Frame::RECLAIMER_COUNT++] = reclaimer;
+    return true;
+}
+
+address_t OSMOS::System::Frame::allocate(uint32_t count) {
+    if (count == 0)
+        return NULL;
+
+    // Under pressure, the caches give back their frames before failing
+    uint32_t first = OSMOS::System::Frame::find(count);
+    if (first == OSMOS::System::Frame::FRAME_MAXIMUM && OSMOS::System::Frame::reclaim(count) > 0)
+        first = OSMOS::System::Frame::find(count);
+    if (first == OSMOS::System::Frame::FRAME_MAXIMUM)
+        return NULL;
+
+    for (uint32_t frame = first; frame < first + count; frame++)
+        OSMOS::System::Frame::BITMAP[frame / 32] |= 1U << (frame & 31);
+
+    OSMOS::System::Frame::FRAME_FREE_COUNT -= count;
+    OSMOS::System::Frame::FRAME_HINT = first + count;
+
+    return OSMOS::System::Frame::FRAME_BASE_ADDRESS + first * OSMOS::System::Frame::FRAME_SIZE;
+}
+
+void OSMOS::System::Frame::free(address_t address) {
+    OSMOS::System::Frame::free(address, 1);
+}
+
+void OSMOS::System::Frame::free(address_t address, uint32_t count) {
+    if (address < OSMOS::System::Frame::FRAME_BASE_ADDRESS || address >= OSMOS::System::Frame::getLimitAddress())
+        return;
+
+    uint32_t first = (address - OSMOS::System::Frame::FRAME_BASE_ADDRESS) / OSMOS::System::Frame::FRAME_SIZE;
+    for (uint32_t frame = first; frame < first + count && frame < OSMOS::System::Frame::FRAME_COUNT; frame++) {
+        if (OSMOS::System::Frame::BITMAP[frame / 32] & (1U << (frame & 31))) {
+            OSMOS::System::Frame::BITMAP[frame / 32] &= ~(1U << (frame & 31));
+            OSMOS::System::Frame::FRAME_FREE_COUNT++;
+        }
+    }
+}
+
+void OSMOS::System::Frame::reserve(address_t address, uint32_t length) {
+    address_t base = OSMOS::System::Frame::FRAME_BASE_ADDRESS;
+    address_t limit = OSMOS::System::Frame::getLimitAddress();
+    address_t end = address + length;
+
+    // Only the part of the range in the allocation area has frames
+    if (length == 0 || end <= base || address >= limit)
+        return;
+
+    uint32_t first = (address > base ? (address - base) / OSMOS::System::Frame::FRAME_SIZE : 0);
+    uint32_t last = (end < limit ? (end - base + OSMOS::System::Frame::FRAME_SIZE - 1) / OSMOS::System::Frame::FRAME_SIZE : OSMOS::System::Frame::FRAME_COUNT);
+
+    for (uint32_t frame = first; frame < last; frame++) {
+        if (!(OSMOS::System::Frame::BITMAP[frame / 32] & (1U << (frame & 31)))) {
+            OSMOS::System::Frame::BITMAP[frame / 32] |= 1U << (frame & 31);
+            OSMOS::System::Frame::FRAME_FREE_COUNT--;
+        }
+    }
+}
\ No newline at end of file
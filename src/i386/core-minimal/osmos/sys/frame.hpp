@@ -0,0 +1,183 @@
+/*
+ * The page frame allocation class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_HPP
+#define FRAME_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Frame's class that allocates page frames (4 KB blocks of
+         * physical memory aligned on 4 KB) from a bitmap. Unlike the blocks of
+         * the Memory class, frames can be given to devices for DMA
+         **/
+        class Frame {
+        public:
+            /**
+             * The size in bytes of a frame
+             **/
+            static const uint32_t FRAME_SIZE = 4096;
+            /**
+             * The maximum number of frames managed by the allocator (128 MB)
+             **/
+            static const uint32_t FRAME_MAXIMUM = 32768;
+            /**
+             * The maximum number of registered reclaimers
+             **/
+            static const uint32_t RECLAIMER_MAXIMUM = 4;
+            /**
+             * The minimum number of frames asked to the reclaimers, so the
+             * next allocations do not reclaim again
+             **/
+            static const uint32_t RECLAIM_MINIMUM = 32;
+
+            /**
+             * A function called when the frames run out, which frees frames
+             * held by a cache
+             * @param count the number of frames wanted
+             * @return the number of frames freed
+             **/
+            typedef uint32_t (*Reclaimer)(uint32_t count);
+
+        private:
+            /**
+             * The base address of the frame allocation area
+             **/
+            static address_t FRAME_BASE_ADDRESS;
+            /**
+             * The number of frames in the allocation area
+             **/
+            static uint32_t FRAME_COUNT;
+            /**
+             * The number of frames currently free
+             **/
+            static uint32_t FRAME_FREE_COUNT;
+            /**
+             * The frame where the next search begins
+             **/
+            static uint32_t FRAME_HINT;
+            /**
+             * The bitmap of the frames, a set bit meaning that the frame is
+             * allocated
+             **/
+            static uint32_t BITMAP[FRAME_MAXIMUM / 32];
+            /**
+             * The reclaimers, called in their registration order
+             **/
+            static OSMOS::System::Frame::Reclaimer RECLAIMERS[RECLAIMER_MAXIMUM];
+            static uint32_t RECLAIMER_COUNT;
+            /**
+             * Set while the reclaimers run, so an allocation made by a
+             * reclaimer does not reclaim again
+             **/
+            static bool RECLAIMING;
+
+            /**
+             * @brief Searches free contiguous frames
+             * @param start the frame to start from
+             * @param end the frame to stop before
+             * @param count the number of contiguous frames to find
+             * @return the index of the first frame, or FRAME_MAXIMUM if none
+             **/
+            static uint32_t search(uint32_t start, uint32_t end, uint32_t count);
+            /**
+             * @brief Finds free contiguous frames, starting after the last
+             * allocation then wrapping around
+             * @param count the number of contiguous frames to find
+             * @return the index of the first frame, or FRAME_MAXIMUM if none
+             **/
+            static uint32_t find(uint32_t count);
+            /**
+             * @brief Asks the reclaimers to free frames, until enough are free
+             * @param count the number of frames wanted
+             * @return the number of frames freed
+             **/
+            static uint32_t reclaim(uint32_t count);
+
+        public:
+            /**
+             * @brief Initializes the frame allocation area. The base address is
+             * aligned up on FRAME_SIZE
+             * @param base the base address of the area
+             * @param limit the limit address of the area
+             **/
+            static void initialize(address_t base, address_t limit);
+
+            /**
+             * @brief Gets the base address of the frame allocation area
+             * @return the base address of the area
+             **/
+            static address_t getBaseAddress();
+            /**
+             * @brief Gets the limit address of the frame allocation area
+             * @return the limit address of the area
+             **/
+            static address_t getLimitAddress();
+            /**
+             * @brief Gets the number of free frames
+             * @return the number of free frames
+             **/
+            static uint32_t getFreeCount();
+
+            /**
+             * @brief Registers a reclaimer, called when an allocation finds no
+             * free frames
+             * @param reclaimer the reclaimer
+             * @return true if the reclaimer has been registered
+             **/
+            static bool addReclaimer(OSMOS::System::Frame::Reclaimer reclaimer);
+
+            /**
+             * @brief Allocates a single frame
+             * @return the address of the frame, or NULL if none is free, even
+             * after reclaiming
+             **/
+            static address_t allocate();
+            /**
+             * @brief Allocates physically contiguous frames
+             * @param count the number of frames
+             * @return the address of the first frame, or NULL if there is no
+             * such free range, even after reclaiming
+             **/
+            static address_t allocate(uint32_t count);
+            /**
+             * @brief Frees a single frame
+             * @param address the address of the frame
+             **/
+            static void free(address_t address);
+            /**
+             * @brief Frees contiguous frames
+             * @param address the address of the first frame
+             * @param count the number of frames
+             **/
+            static void free(address_t address, uint32_t count);
+            /**
+             * @brief Marks the frames of a range as allocated, such as the
+             * memory of the boot modules. It must be called before any
+             * allocation may return them
+             * @param address the first address of the range
+             * @param length the length of the range in bytes
+             **/
+            static void reserve(address_t address, uint32_t length);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
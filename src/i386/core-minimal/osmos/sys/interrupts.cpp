@@ -0,0 +1,252 @@
+/*
+ * The interrupt descriptor table class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "interrupts.hpp"
+
+#include "deferred.hpp"
+#include "process.hpp"
+#include "../io/pic.hpp"
+#include "../io/port.hpp"
+
+uint8_t OSMOS::System::Interrupts::VECTOR_DEVICE_NOT_AVAILABLE  = 7;
+uint8_t OSMOS::System::Interrupts::VECTOR_PAGE_FAULT            = 14;
+uint8_t OSMOS::System::Interrupts::VECTOR_SIMD_EXCEPTION        = 19;
+
+uint8_t OSMOS::System::Interrupts::GATE_KERNEL                  = 0x8E;
+
+OSMOS::System::Interrupts::Gate OSMOS::System::Interrupts::TABLE[OSMOS::System::Interrupts::GATE_COUNT];
+OSMOS::System::Interrupts::Handler OSMOS::System::Interrupts::HANDLERS[OSMOS::System::Interrupts::GATE_COUNT];
+
+// The common part of every stub: saves the registers, gives the frame to
+// dispatch, then restores the registers and drops the vector/error code
+extern "C" void interruptDispatch(OSMOS::System::Interrupts::Frame *frame) {
+    OSMOS::System::Interrupts::dispatch(frame);
+}
+
+extern "C" void __attribute__((naked)) interruptCommon() {
+    asm("pusha\n \
+         cld\n \
+         push esp\n \
+         call interruptDispatch\n \
+         add esp, 4\n \
+         popa\n \
+         add esp, 8\n \
+         iret");
+}
+
+// The stubs entered by the processor. An exception without error code gets
+// a null one, so every frame has the same layout
+#define INTERRUPT_STUB(vector) \
+    extern "C" void __attribute__((naked)) interruptStub##vector() { \
+        asm("push 0\n push " #vector "\n jmp interruptCommon"); \
+    }
+
+#define INTERRUPT_STUB_ERROR(vector) \
+    extern "C" void __attribute__((naked)) interruptStub##vector() { \
+        asm("push " #vector "\n jmp interruptCommon"); \
+    }
+
+INTERRUPT_STUB(0)
+INTERRUPT_STUB(1)
+INTERRUPT_STUB(2)
+INTERRUPT_STUB(3)
+INTERRUPT_STUB(4)
+INTERRUPT_STUB(5)
+INTERRUPT_STUB(6)
+INTERRUPT_STUB(7)
+INTERRUPT_STUB_ERROR(8)
+INTERRUPT_STUB(9)
+INTERRUPT_STUB_ERROR(10)
+INTERRUPT_STUB_ERROR(11)
+INTERRUPT_STUB_ERROR(12)
+INTERRUPT_STUB_ERROR(13)
+INTERRUPT_STUB_ERROR(14)
+INTERRUPT_STUB(15)
+INTERRUPT_STUB(16)
+INTERRUPT_STUB_ERROR(17)
+INTERRUPT_STUB(18)
+INTERRUPT_STUB(19)
+INTERRUPT_STUB(20)
+INTERRUPT_STUB_ERROR(21)
+INTERRUPT_STUB(22)
+INTERRUPT_STUB(23)
+INTERRUPT_STUB(24)
+INTERRUPT_STUB(25)
+INTERRUPT_STUB(26)
+INTERRUPT_STUB(27)
+INTERRUPT_STUB(28)
+INTERRUPT_STUB_ERROR(29)
+INTERRUPT_STUB_ERROR(30)
+INTERRUPT_STUB(31)
+
+INTERRUPT_STUB(32)
+INTERRUPT_STUB(33)
+INTERRUPT_STUB(34)
+INTERRUPT_STUB(35)
+INTERRUPT_STUB(36)
+INTERRUPT_STUB(37)
+INTERRUPT_STUB(38)
+INTERRUPT_STUB(39)
+INTERRUPT_STUB(40)
+INTERRUPT_STUB(41)
+INTERRUPT_STUB(42)
+INTERRUPT_STUB(43)
+INTERRUPT_STUB(44)
+INTERRUPT_STUB(45)
+INTERRUPT_STUB(46)
+INTERRUPT_STUB(47)
+
+static address_t EXCEPTION_STUBS[OSMOS::System::Interrupts::EXCEPTION_COUNT] = {
+    (address_t) interruptStub0,  (address_t) interruptStub1,  (address_t) interruptStub2,  (address_t) interruptStub3,
+    (address_t) interruptStub4,  (address_t) interruptStub5,  (address_t) interruptStub6,  (address_t) interruptStub7,
+    (address_t) interruptStub8,  (address_t) interruptStub9,  (address_t) interruptStub10, (address_t) interruptStub11,
+    (address_t) interruptStub12, (address_t) interruptStub13, (address_t) interruptStub14, (address_t) interruptStub15,
+    (address_t) interruptStub16, (address_t) interruptStub17, (address_t) interruptStub18, (address_t) interruptStub19,
+    (address_t) interruptStub20, (address_t) interruptStub21, (address_t) interruptStub22, (address_t) interruptStub23,
+    (address_t) interruptStub24, (address_t) interruptStub25, (address_t) interruptStub26, (address_t) interruptStub27,
+    (address_t) interruptStub28, (address_t) interruptStub29, (address_t) interruptStub30, (address_t) interruptStub31
+};
+
+static address_t IRQ_STUBS[OSMOS::IO::PIC::LINE_COUNT] = {
+    (address_t) interruptStub32, (address_t) interruptStub33, (address_t) interruptStub34, (address_t) interruptStub35,
+    (address_t) interruptStub36, (address_t) interruptStub37, (address_t) interruptStub38, (address_t) interruptStub39,
+    (address_t) interruptStub40, (address_t) interruptStub41, (address_t) interruptStub42, (address_t) interruptStub43,
+    (address_t) interruptStub44, (address_t) interruptStub45, (address_t) interruptStub46, (address_t) interruptStub47
+};
+
+static const char *EXCEPTION_NAMES[OSMOS::System::Interrupts::EXCEPTION_COUNT] = {
+    "#DE", "#DB", "NMI", "#BP", "#OF", "#BR", "#UD", "#NM",
+    "#DF", "#CSO", "#TS", "#NP", "#SS", "#GP", "#PF", "#15",
+    "#MF", "#AC", "#MC", "#XM", "#VE", "#CP", "#22", "#23",
+    "#24", "#25", "#26", "#27", "#HV", "#VC", "#SX", "#31"
+};
+
+void OSMOS::System::Interrupts::initialize() {
+    OSMOS::System::Interrupts::disable();
+
+    for (uint32_t vector = 0; vector < OSMOS::System::Interrupts::GATE_COUNT; vector++) {
+        OSMOS::System::Interrupts::HANDLERS[vector] = NULL;
+        OSMOS::System::Interrupts::TABLE[vector].flags = 0;
+    }
+
+    for (uint32_t vector = 0; vector < OSMOS::System::Interrupts::EXCEPTION_COUNT; vector++)
+        OSMOS::System::Interrupts::setGate(vector, EXCEPTION_STUBS[vector], OSMOS::System::Interrupts::GATE_KERNEL);
+
+    OSMOS::IO::PIC::initialize();
+    for (uint8_t line = 0; line < OSMOS::IO::PIC::LINE_COUNT; line++)
+        OSMOS::System::Interrupts::setGate(OSMOS::IO::PIC::VECTOR_BASE + line, IRQ_STUBS[line], OSMOS::System::Interrupts::GATE_KERNEL);
+
+    OSMOS::System::Interrupts::Descriptor descriptor;
+    descriptor.limit = sizeof(OSMOS::System::Interrupts::TABLE) - 1;
+    descriptor.base = (address_t) OSMOS::System::Interrupts::TABLE;
+
+    asm volatile("lidt [%[descriptor]]"
+                :
+                : [descriptor] "r" (&descriptor)
+                : "memory");
+}
+
+void OSMOS::System::Interrupts::setGate(uint8_t vector, address_t handler, uint8_t flags) {
+    uint16_t selector;
+    asm volatile("mov %[selector], cs"
+                : [selector] "=r" (selector));
+
+    OSMOS::System::Interrupts::Gate *gate = &OSMOS::System::Interrupts::TABLE[vector];
+    gate->offsetLow = handler & 0xFFFF;
+    gate->selector = selector;
+    gate->zero = 0;
+    gate->flags = flags;
+    gate->offsetHigh = (handler >> 16) & 0xFFFF;
+}
+
+void OSMOS::System::Interrupts::setHandler(uint8_t vector, OSMOS::System::Interrupts::Handler handler) {
+    OSMOS::System::Interrupts::HANDLERS[vector] = handler;
+}
+
+void OSMOS::System::Interrupts::setIRQHandler(uint8_t line, OSMOS::System::Interrupts::Handler handler) {
+    OSMOS::System::Interrupts::HANDLERS[OSMOS::IO::PIC::VECTOR_BASE + line] = handler;
+
+    if (handler != NULL)
+        OSMOS::IO::PIC::unmask(line);
+    else
+        OSMOS::IO::PIC::mask(line);
+}
+
+void OSMOS::System::Interrupts::dispatch(OSMOS::System::Interrupts::Frame *frame) {
+    OSMOS::System::Interrupts::Handler handler = OSMOS::System::Interrupts::HANDLERS[frame->vector & 0xFF];
+
+    if (frame->vector >= OSMOS::IO::PIC::VECTOR_BASE && frame->vector < (uint32_t) OSMOS::IO::PIC::VECTOR_BASE + OSMOS::IO::PIC::LINE_COUNT) {
+        uint8_t line = frame->vector - OSMOS::IO::PIC::VECTOR_BASE;
+
+        // An end of interrupt for a spurious IRQ would end the real one in
+        // service instead. The master did raise the cascade of a spurious
+        // slave IRQ, so it alone is acknowledged
+        if (OSMOS::IO::PIC::isSpurious(line)) {
+            if (line >= 8)
+                OSMOS::IO::PIC::acknowledge(2);
+
+            return;
+        }
+
+        if (handler != NULL)
+            handler(frame);
+
+        OSMOS::IO::PIC::acknowledge(line);
+
+        // The work left by the handlers runs with the IRQs unmasked
+        OSMOS::System::Deferred::run();
+        return;
+    }
+
+    if (handler != NULL) {
+        handler(frame);
+        return;
+    }
+
+    if (frame->vector < OSMOS::System::Interrupts::EXCEPTION_COUNT) {
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "\r\nUnhandled exception ");
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, EXCEPTION_NAMES[frame->vector]);
+
+        // A fault of the user code only ends its process
+        if (frame->cs & 3) {
+            OSMOS::IO::Port::out((uint16_t) 0x3F8, " in a process, exiting it\r\n");
+            OSMOS::System::Process::exit(OSMOS::System::Process::EXIT_FAULT);
+        }
+
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, ", halting\r\n");
+
+        for (;;)
+            asm volatile("cli\n hlt");
+    }
+}
+
+void OSMOS::System::Interrupts::enable() {
+    asm volatile("sti" : : : "memory");
+}
+
+void OSMOS::System::Interrupts::disable() {
+    asm volatile("cli" : : : "memory");
+}
+
+bool OSMOS::System::Interrupts::areEnabled() {
+    uint32_t eflags;
+    asm volatile("pushfd\n \
+                  pop %[eflags]"
+                : [eflags] "=r" (eflags));
+    return (eflags & (1 << 9)) != 0;
+}
\ No newline at end of file
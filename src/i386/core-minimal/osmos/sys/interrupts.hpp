@@ -0,0 +1,179 @@
+/*
+ * The interrupt descriptor table class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERRUPTS_HPP
+#define INTERRUPTS_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Interrupts' class that builds the interrupt descriptor table
+         * and dispatches exceptions and IRQs to the handlers registered by the
+         * kernel
+         **/
+        class Interrupts {
+        public:
+            /**
+             * The number of gates in the interrupt descriptor table
+             **/
+            static const uint32_t GATE_COUNT = 256;
+            /**
+             * The number of exceptions reserved by the processor
+             **/
+            static const uint32_t EXCEPTION_COUNT = 32;
+
+            /**
+             * The exception vector raised by an FPU/SSE instruction while
+             * CR0.TS is set (device not available, #NM)
+             **/
+            static uint8_t VECTOR_DEVICE_NOT_AVAILABLE;
+            /**
+             * The exception vector raised by an access to a page which is not
+             * present or not allowed (#PF)
+             **/
+            static uint8_t VECTOR_PAGE_FAULT;
+            /**
+             * The exception vector raised by an unmasked SIMD floating-point
+             * exception (#XM)
+             **/
+            static uint8_t VECTOR_SIMD_EXCEPTION;
+
+            /**
+             * The flags of a present 32-bit interrupt gate, only reachable by
+             * the kernel
+             **/
+            static uint8_t GATE_KERNEL;
+
+            /**
+             * An entry of the interrupt descriptor table
+             **/
+            struct Gate {
+                uint16_t offsetLow;
+                uint16_t selector;
+                uint8_t zero;
+                uint8_t flags;
+                uint16_t offsetHigh;
+            } __attribute__((packed));
+
+            /**
+             * The operand of the lidt instruction
+             **/
+            struct Descriptor {
+                uint16_t limit;
+                uint32_t base;
+            } __attribute__((packed));
+
+            /**
+             * The state of the interrupted code, as pushed on the stack by the
+             * processor and the interrupt stubs
+             **/
+            struct Frame {
+                uint32_t edi;
+                uint32_t esi;
+                uint32_t ebp;
+                uint32_t esp;
+                uint32_t ebx;
+                uint32_t edx;
+                uint32_t ecx;
+                uint32_t eax;
+                /**
+                 * The vector of the interrupt, pushed by the stub
+                 **/
+                uint32_t vector;
+                /**
+                 * The error code pushed by the processor, or 0 if the
+                 * exception has none
+                 **/
+                uint32_t error;
+                uint32_t eip;
+                uint32_t cs;
+                uint32_t eflags;
+            } __attribute__((packed));
+
+            /**
+             * A function handling an interrupt vector
+             **/
+            typedef void (*Handler)(OSMOS::System::Interrupts::Frame *frame);
+
+        private:
+            /**
+             * The interrupt descriptor table
+             **/
+            static OSMOS::System::Interrupts::Gate TABLE[GATE_COUNT];
+            /**
+             * The handlers called by dispatch for each vector
+             **/
+            static OSMOS::System::Interrupts::Handler HANDLERS[GATE_COUNT];
+
+        public:
+            /**
+             * @brief Fills the interrupt descriptor table with the exception
+             * and IRQ stubs, remaps the IRQs after the exceptions and loads the
+             * table with lidt. Interrupts stay disabled and IRQs masked
+             **/
+            static void initialize();
+
+            /**
+             * @brief Sets a gate of the interrupt descriptor table
+             * @param vector the vector of the gate
+             * @param handler the address of the code entered by the processor
+             * @param flags the type and privilege flags of the gate
+             **/
+            static void setGate(uint8_t vector, address_t handler, uint8_t flags);
+            /**
+             * @brief Registers the handler of a vector
+             * @param vector the vector to handle
+             * @param handler the handler to call, or NULL to remove it
+             **/
+            static void setHandler(uint8_t vector, OSMOS::System::Interrupts::Handler handler);
+            /**
+             * @brief Registers the handler of an IRQ line and unmasks it. The
+             * end of interrupt is sent by dispatch once the handler returns
+             * @param line the IRQ line to handle
+             * @param handler the handler to call, or NULL to remove it and
+             * mask the line
+             **/
+            static void setIRQHandler(uint8_t line, OSMOS::System::Interrupts::Handler handler);
+            /**
+             * @brief Calls the handler of the interrupted vector, or halts the
+             * processor if the vector is an exception without handler. An IRQ
+             * is followed by the bottom halves of the Deferred class
+             * @param frame the state of the interrupted code
+             **/
+            static void dispatch(OSMOS::System::Interrupts::Frame *frame);
+
+            /**
+             * @brief Enables the maskable interrupts (sti)
+             **/
+            static void enable();
+            /**
+             * @brief Disables the maskable interrupts (cli)
+             **/
+            static void disable();
+            /**
+             * @brief Checks if the maskable interrupts are enabled
+             * @return true if EFLAGS.IF is set
+             **/
+            static bool areEnabled();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,98 @@
+/*
+ * The multiboot information class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "multiboot.hpp"
+
+#include "memory.hpp"
+
+uint8_t OSMOS::System::Multiboot::TABLE[OSMOS::System::Multiboot::TABLE_MAXIMUM] __attribute__((aligned(8)));
+uint32_t OSMOS::System::Multiboot::TABLE_SIZE = 0;
+
+// The size of the header of the table: its total size and a reserved field
+#define MULTIBOOT_HEADER_SIZE                               8
+
+// The alignment of the tags
+#define MULTIBOOT_TAG_ALIGNMENT                             8
+
+bool OSMOS::System::Multiboot::initialize(uint32_t magic, address_t address) {
+    OSMOS::System::Multiboot::TABLE_SIZE = 0;
+
+    if (magic != OSMOS::System::Multiboot::MAGIC || address == NULL)
+        return false;
+
+    uint8_t *table = (uint8_t *) address + MULTIBOOT_HEADER_SIZE;
+    uint32_t size = *((uint32_t *) address) - MULTIBOOT_HEADER_SIZE;
+
+    // Only whole tags are kept, so a truncated table still ends on a tag
+    uint32_t copied = 0;
+    while (copied + sizeof(OSMOS::System::Multiboot::Tag) <= size) {
+        OSMOS::System::Multiboot::Tag *tag = (OSMOS::System::Multiboot::Tag *) (table + copied);
+        uint32_t length = (tag->size + MULTIBOOT_TAG_ALIGNMENT - 1) & ~(MULTIBOOT_TAG_ALIGNMENT - 1);
+
+        if (tag->type == OSMOS::System::Multiboot::TAG_END || tag->size < sizeof(OSMOS::System::Multiboot::Tag) || copied + length > size || copied + length > OSMOS::System::Multiboot::TABLE_MAXIMUM)
+            break;
+
+        copied += length;
+    }
+
+    OSMOS::System::Memory::copy(OSMOS::System::Multiboot::TABLE, table, copied);
+    OSMOS::System::Multiboot::TABLE_SIZE = copied;
+
+    return true;
+}
+
+OSMOS::System::Multiboot::Tag *OSMOS::System::Multiboot::find(uint32_t type, OSMOS::System::Multiboot::Tag *previous) {
+    uint32_t offset = 0;
+
+    if (previous != NULL)
+        offset = ((uint8_t *) previous - OSMOS::System::Multiboot::TABLE) + ((previous->size + MULTIBOOT_TAG_ALIGNMENT - 1) & ~(MULTIBOOT_TAG_ALIGNMENT - 1));
+
+    while (offset < OSMOS::System::Multiboot::TABLE_SIZE) {
+        OSMOS::System::Multiboot::Tag *tag = (OSMOS::System::Multiboot::Tag *) &OSMOS::System::Multiboot::TABLE[offset];
+
+        if (tag->type == type)
+            return tag;
+
+        offset += (tag->size + MULTIBOOT_TAG_ALIGNMENT - 1) & ~(MULTIBOOT_TAG_ALIGNMENT - 1);
+    }
+
+    return NULL;
+}
+
+OSMOS::System::Multiboot::Framebuffer *OSMOS::System::Multiboot::getFramebuffer() {
+    OSMOS::System::Multiboot::Tag *tag = OSMOS::System::Multiboot::find(OSMOS::System::Multiboot::TAG_FRAMEBUFFER, NULL);
+
+    if (tag == NULL || tag->size < sizeof(OSMOS::System::Multiboot::Framebuffer))
+        return NULL;
+
+    return (OSMOS::System::Multiboot::Framebuffer *) tag;
+}
+
+OSMOS::System::Multiboot::Module *OSMOS::System::Multiboot::getModule(OSMOS::System::Multiboot::Module *previous) {
+    OSMOS::System::Multiboot::Tag *tag = (OSMOS::System::Multiboot::Tag *) previous;
+
+    // A truncated tag is skipped, as is a module ending before its start
+    while ((tag = OSMOS::System::Multiboot::find(OSMOS::System::Multiboot::TAG_MODULE, tag)) != NULL) {
+        OSMOS::System::Multiboot::Module *module = (OSMOS::System::Multiboot::Module *) tag;
+
+        if (tag->size > sizeof(OSMOS::System::Multiboot::Module) && module->end >= module->start)
+            return module;
+    }
+
+    return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+/*
+ * The multiboot information class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MULTIBOOT_HPP
+#define MULTIBOOT_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Multiboot's class that keeps the information table given by
+         * the multiboot2 loader. The table is copied at boot, before its memory
+         * is given to the frame allocator, then its tags can be looked up
+         **/
+        class Multiboot {
+        public:
+            /**
+             * The value of EAX when the kernel is loaded by a multiboot2 loader
+             **/
+            static const uint32_t MAGIC = 0x36D76289;
+            /**
+             * The maximum size in bytes of the copied table. The tags after it
+             * are dropped
+             **/
+            static const uint32_t TABLE_MAXIMUM = 8192;
+
+            /**
+             * The types of the tags
+             **/
+            static const uint32_t TAG_END = 0;
+            static const uint32_t TAG_MODULE = 3;
+            static const uint32_t TAG_FRAMEBUFFER = 8;
+
+            /**
+             * The type of a framebuffer whose pixels are made of RGB fields
+             **/
+            static const uint8_t FRAMEBUFFER_RGB = 1;
+
+            /**
+             * The header of a tag. The tags follow each other, 8 bytes aligned
+             **/
+            struct Tag {
+                uint32_t type;
+                uint32_t size;
+            } __attribute__((packed));
+
+            /**
+             * The tag of a module loaded by the loader (module2 of GRUB). The
+             * memory of the module is left in place
+             **/
+            struct Module {
+                OSMOS::System::Multiboot::Tag tag;
+                uint32_t start;
+                uint32_t end;
+                /**
+                 * The command line of the module, null-terminated
+                 **/
+                char string[];
+            } __attribute__((packed));
+
+            /**
+             * The tag describing the framebuffer set up by the loader
+             **/
+            struct Framebuffer {
+                OSMOS::System::Multiboot::Tag tag;
+                uint64_t address;
+                uint32_t pitch;
+                uint32_t width;
+                uint32_t height;
+                uint8_t depth;
+                uint8_t type;
+                uint16_t reserved;
+                /**
+                 * The position and the size in bits of the fields of a pixel,
+                 * for the RGB framebuffers
+                 **/
+                uint8_t redPosition;
+                uint8_t redSize;
+                uint8_t greenPosition;
+                uint8_t greenSize;
+                uint8_t bluePosition;
+                uint8_t blueSize;
+            } __attribute__((packed));
+
+        private:
+            /**
+             * The copy of the table, without its header
+             **/
+            static uint8_t TABLE[TABLE_MAXIMUM] __attribute__((aligned(8)));
+            static uint32_t TABLE_SIZE;
+
+        public:
+            /**
+             * @brief Copies the information table
+             * @param magic the value of EAX given by the loader
+             * @param address the address of the table given by the loader
+             * @return false if the kernel was not loaded by a multiboot2
+             * loader, no tag being available
+             **/
+            static bool initialize(uint32_t magic, address_t address);
+
+            /**
+             * @brief Finds a tag of the table
+             * @param type the type of the tag
+             * @param previous the tag after which the search starts, or NULL
+             * to start with the first tag
+             * @return the tag, or NULL if there is no such tag
+             **/
+            static OSMOS::System::Multiboot::Tag *find(uint32_t type, OSMOS::System::Multiboot::Tag *previous);
+            /**
+             * @brief Gets the framebuffer set up by the loader
+             * @return the framebuffer tag, or NULL if the loader did not set up
+             * a framebuffer
+             **/
+            static OSMOS::System::Multiboot::Framebuffer *getFramebuffer();
+            /**
+             * @brief Gets a module loaded by the loader
+             * @param previous the module after which the search starts, or
+             * NULL to get the first module
+             * @return the module tag, or NULL if there is no other module
+             **/
+            static OSMOS::System::Multiboot::Module *getModule(OSMOS::System::Multiboot::Module *previous);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
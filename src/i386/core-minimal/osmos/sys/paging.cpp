@@ -0,0 +1,486 @@
+/*
+ * The paging class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "paging.hpp"
+
+#include "frame.hpp"
+#include "memory.hpp"
+#include "process.hpp"
+#include "processor.hpp"
+#include "../io/port.hpp"
+
+uint32_t OSMOS::System::Paging::PAGE_PRESENT                = 1 << 0;
+uint32_t OSMOS::System::Paging::PAGE_WRITABLE               = 1 << 1;
+uint32_t OSMOS::System::Paging::PAGE_USER                   = 1 << 2;
+uint32_t OSMOS::System::Paging::PAGE_WRITE_THROUGH          = 1 << 3;
+uint32_t OSMOS::System::Paging::PAGE_CACHE_DISABLED         = 1 << 4;
+uint32_t OSMOS::System::Paging::PAGE_LARGE                  = 1 << 7;
+uint32_t OSMOS::System::Paging::PAGE_OBJECT                 = 1 << 9;
+
+uint8_t OSMOS::System::Paging::MAPPING_WRITABLE             = 0x01;
+uint8_t OSMOS::System::Paging::MAPPING_PRIVATE              = 0x02;
+uint8_t OSMOS::System::Paging::MAPPING_USER                 = 0x04;
+
+uint32_t OSMOS::System::Paging::KERNEL_DIRECTORY[OSMOS::System::Paging::ENTRY_COUNT] __attribute__((aligned(4096)));
+OSMOS::System::Paging::Space OSMOS::System::Paging::KERNEL_SPACE;
+OSMOS::System::Paging::Space OSMOS::System::Paging::SPACES[OSMOS::System::Paging::SPACE_MAXIMUM];
+OSMOS::System::Paging::Space *OSMOS::System::Paging::CURRENT  = NULL;
+
+OSMOS::System::Paging::Mapping OSMOS::System::Paging::MAPPINGS[OSMOS::System::Paging::MAPPING_MAXIMUM];
+OSMOS::System::Paging::Mapping *OSMOS::System::Paging::FREE_MAPPINGS = NULL;
+
+OSMOS::System::Paging::Statistics OSMOS::System::Paging::STATISTICS;
+
+// The bits of the error code of a page fault
+#define PAGING_FAULT_WRITE                                  (1 << 1)
+
+// The interrupt flag of EFLAGS
+#define PAGING_EFLAGS_INTERRUPT                             (1 << 9)
+
+// The size of the 4 MB pages mapping the kernel, and the mask of a frame
+// address in a page table entry
+#define PAGING_LARGE_SIZE                                   0x400000
+#define PAGING_ADDRESS_MASK                                 0xFFFFF000
+
+// The page attribute table register, and the memory type written in its entry
+// 1, which the pages with the write-through bit only select
+#define PAGING_MSR_PAT                                      0x277
+#define PAGING_PAT_WRITE_COMBINING                          0x01
+
+bool OSMOS::System::Paging::initialize() {
+    if (!OSMOS::System::Processor::hasFeature(OSMOS::System::Processor::FEATURE_PSE))
+        return false;
+
+    // The memory and the kernel below the user area, the devices above it
+    // with the cache disabled
+    for (uint32_t i = 0; i < OSMOS::System::Paging::ENTRY_COUNT; i++) {
+        uint32_t entry = i * PAGING_LARGE_SIZE | OSMOS::System::Paging::PAGE_PRESENT | OSMOS::System::Paging::PAGE_WRITABLE | OSMOS::System::Paging::PAGE_LARGE;
+
+        if (i * PAGING_LARGE_SIZE >= OSMOS::System::Paging::USER_BASE && i * PAGING_LARGE_SIZE < OSMOS::System::Paging::USER_LIMIT)
+            entry = 0;
+        else if (i * PAGING_LARGE_SIZE >= OSMOS::System::Paging::USER_LIMIT)
+            entry |= OSMOS::System::Paging::PAGE_WRITE_THROUGH | OSMOS::System::Paging::PAGE_CACHE_DISABLED;
+
+        OSMOS::System::Paging::KERNEL_DIRECTORY[i] = entry;
+    }
+
+    OSMOS::System::Paging::KERNEL_SPACE.directory = OSMOS::System::Paging::KERNEL_DIRECTORY;
+    OSMOS::System::Paging::KERNEL_SPACE.mappings = NULL;
+    OSMOS::System::Paging::CURRENT = &OSMOS::System::Paging::KERNEL_SPACE;
+
+    for (uint32_t i = 0; i < OSMOS::System::Paging::SPACE_MAXIMUM; i++)
+        OSMOS::System::Paging::SPACES[i].directory = NULL;
+
+    OSMOS::System::Paging::FREE_MAPPINGS = NULL;
+    for (uint32_t i = OSMOS::System::Paging::MAPPING_MAXIMUM; i > 0; i--) {
+        OSMOS::System::Paging::MAPPINGS[i - 1].next = OSMOS::System::Paging::FREE_MAPPINGS;
+        OSMOS::System::Paging::FREE_MAPPINGS = &OSMOS::System::Paging::MAPPINGS[i - 1];
+    }
+
+    OSMOS::System::Paging::STATISTICS.faults = 0;
+    OSMOS::System::Paging::STATISTICS.lent = 0;
+    OSMOS::System::Paging::STATISTICS.zeroed = 0;
+    OSMOS::System::Paging::STATISTICS.copied = 0;
+
+    OSMOS::System::Interrupts::setHandler(OSMOS::System::Interrupts::VECTOR_PAGE_FAULT, OSMOS::System::Paging::handleFault);
+
+    OSMOS::System::Processor::setControlRegister4(OSMOS::System::Processor::getControlRegister4() | OSMOS::System::Processor::CR4_PAGE_SIZE_EXTENSION);
+    OSMOS::System::Processor::setControlRegister3((address_t) OSMOS::System::Paging::KERNEL_DIRECTORY);
+    OSMOS::System::Processor::setControlRegister0(OSMOS::System::Processor::getControlRegister0() | OSMOS::System::Processor::CR0_PAGING | OSMOS::System::Processor::CR0_WRITE_PROTECT);
+
+    return true;
+}
+
+bool OSMOS::System::Paging::enableWriteCombining(address_t start, uint32_t length) {
+    if (length == 0 || !OSMOS::System::Processor::hasFeature(OSMOS::System::Processor::FEATURE_PAT | OSMOS::System::Processor::FEATURE_MSR))
+        return false;
+
+    uint32_t first = start / PAGING_LARGE_SIZE;
+    uint32_t last = (start + (length - 1)) / PAGING_LARGE_SIZE;
+    if (start + (length - 1) < start)
+        return false;
+
+    // Only the device area is changed, where no page holds memory
+    if (first * PAGING_LARGE_SIZE < OSMOS::System::Paging::USER_LIMIT)
+        return false;
+
+    // The write-through type of the entry 1 is never used otherwise, so it
+    // becomes the write-combining one
+    uint64_t attributes = OSMOS::System::Processor::readModelSpecificRegister(PAGING_MSR_PAT);
+    attributes = (attributes & ~((uint64_t) 0xFF << 8)) | ((uint64_t) PAGING_PAT_WRITE_COMBINING << 8);
+    OSMOS::System::Processor::writeModelSpecificRegister(PAGING_MSR_PAT, attributes);
+
+    for (uint32_t i = first; i <= last; i++) {
+        uint32_t entry = (OSMOS::System::Paging::KERNEL_DIRECTORY[i] & ~OSMOS::System::Paging::PAGE_CACHE_DISABLED) | OSMOS::System::Paging::PAGE_WRITE_THROUGH;
+        OSMOS::System::Paging::KERNEL_DIRECTORY[i] = entry;
+
+        for (uint32_t j = 0; j < OSMOS::System::Paging::SPACE_MAXIMUM; j++) {
+            if (OSMOS::System::Paging::SPACES[j].directory != NULL)
+                OSMOS::System::Paging::SPACES[j].directory[i] = entry;
+        }
+    }
+
+    // The lines cached with the old type are written back, and the old
+    // translations flushed
+    OSMOS::System::Processor::writeBackCaches();
+    OSMOS::System::Processor::setControlRegister3(OSMOS::System::Processor::getControlRegister3());
+
+    return true;
+}
+
+OSMOS::System::Paging::Space *OSMOS::System::Paging::getKernelSpace() {
+    return &OSMOS::System::Paging::KERNEL_SPACE;
+}
+
+OSMOS::System::Paging::Space *OSMOS::System::Paging::getCurrentSpace() {
+    return OSMOS::System::Paging::CURRENT;
+}
+
+OSMOS::System::Paging::Space *OSMOS::System::Paging::create() {
+    OSMOS::System::Paging::Space *space = NULL;
+
+    for (uint32_t i = 0; space == NULL && i < OSMOS::System::Paging::SPACE_MAXIMUM; i++) {
+        if (OSMOS::System::Paging::SPACES[i].directory == NULL)
+            space = &OSMOS::System::Paging::SPACES[i];
+    }
+
+    if (space == NULL)
+        return NULL;
+
+    uint32_t *directory = (uint32_t *) OSMOS::System::Frame::allocate();
+    if (directory == NULL)
+        return NULL;
+
+    for (uint32_t i = 0; i < OSMOS::System::Paging::ENTRY_COUNT; i++)
+        directory[i] = OSMOS::System::Paging::KERNEL_DIRECTORY[i];
+
+    space->directory = directory;
+    space->mappings = NULL;
+
+    return space;
+}
+
+void OSMOS::System::Paging::destroy(OSMOS::System::Paging::Space *space) {
+    if (space == &OSMOS::System::Paging::KERNEL_SPACE || space->directory == NULL)
+        return;
+
+    if (OSMOS::System::Paging::CURRENT == space)
+        OSMOS::System::Paging::activate(&OSMOS::System::Paging::KERNEL_SPACE);
+
+    while (space->mappings != NULL)
+        OSMOS::System::Paging::removeMapping(space, space->mappings->start);
+
+    for (uint32_t i = OSMOS::System::Paging::USER_BASE / PAGING_LARGE_SIZE; i < OSMOS::System::Paging::USER_LIMIT / PAGING_LARGE_SIZE; i++) {
+        if (space->directory[i] & OSMOS::System::Paging::PAGE_PRESENT)
+            OSMOS::System::Frame::free(space->directory[i] & PAGING_ADDRESS_MASK);
+    }
+
+    OSMOS::System::Frame::free((address_t) space->directory);
+    space->directory = NULL;
+}
+
+void OSMOS::System::Paging::activate(OSMOS::System::Paging::Space *space) {
+    if (OSMOS::System::Paging::CURRENT == space)
+        return;
+
+    OSMOS::System::Paging::CURRENT = space;
+    OSMOS::System::Processor::setControlRegister3((address_t) space->directory);
+}
+
+uint32_t *OSMOS::System::Paging::getEntry(OSMOS::System::Paging::Space *space, address_t address, bool create) {
+    if (address < OSMOS::System::Paging::USER_BASE || address >= OSMOS::System::Paging::USER_LIMIT)
+        return NULL;
+
+    uint32_t *directoryEntry = &space->directory[address / PAGING_LARGE_SIZE];
+
+    if (!(*directoryEntry & OSMOS::System::Paging::PAGE_PRESENT)) {
+        if (!create)
+            return NULL;
+
+        uint32_t *table = (uint32_t *) OSMOS::System::Frame::allocate();
+        if (table == NULL)
+            return NULL;
+
+        for (uint32_t i = 0; i < OSMOS::System::Paging::ENTRY_COUNT; i++)
+            table[i] = 0;
+
+        // The page table entries restrict the access, not the directory
+        *directoryEntry = (address_t) table | OSMOS::System::Paging::PAGE_PRESENT | OSMOS::System::Paging::PAGE_WRITABLE | OSMOS::System::Paging::PAGE_USER;
+    }
+
+    uint32_t *table = (uint32_t *) (*directoryEntry & PAGING_ADDRESS_MASK);
+    return &table[(address / OSMOS::System::Paging::PAGE_SIZE) % OSMOS::System::Paging::ENTRY_COUNT];
+}
+
+void OSMOS::System::Paging::setEntry(OSMOS::System::Paging::Space *space, uint32_t *entry, address_t address, uint32_t value) {
+    *entry = value;
+
+    if (space == OSMOS::System::Paging::CURRENT)
+        OSMOS::System::Processor::invalidatePage(address);
+}
+
+OSMOS::System::Paging::Mapping *OSMOS::System::Paging::find(OSMOS::System::Paging::Space *space, address_t address) {
+    for (OSMOS::System::Paging::Mapping *mapping = space->mappings; mapping != NULL && mapping->start <= address; mapping = mapping->next) {
+        if (address < mapping->end)
+            return mapping;
+    }
+
+    return NULL;
+}
+
+bool OSMOS::System::Paging::addMapping(OSMOS::System::Paging::Space *space, address_t start, uint32_t length, uint8_t flags, const OSMOS::System::Paging::Pager *pager, void *object, uint32_t offset, uint32_t dataLength) {
+    if (length == 0 || (start % OSMOS::System::Paging::PAGE_SIZE) != 0 || (offset % OSMOS::System::Paging::PAGE_SIZE) != 0)
+        return false;
+
+    if (start < OSMOS::System::Paging::USER_BASE || start >= OSMOS::System::Paging::USER_LIMIT || length > OSMOS::System::Paging::USER_LIMIT - start)
+        return false;
+
+    // The writes to a lent page are never given back to its object
+    if (object != NULL && (flags & OSMOS::System::Paging::MAPPING_WRITABLE) && !(flags & OSMOS::System::Paging::MAPPING_PRIVATE))
+        return false;
+
+    address_t end = start + ((length + OSMOS::System::Paging::PAGE_SIZE - 1) & ~(OSMOS::System::Paging::PAGE_SIZE - 1));
+    if (end > OSMOS::System::Paging::USER_LIMIT || OSMOS::System::Paging::FREE_MAPPINGS == NULL)
+        return false;
+
+    OSMOS::System::Paging::Mapping **link = &space->mappings;
+    while (*link != NULL && (*link)->end <= start)
+        link = &(*link)->next;
+
+    if (*link != NULL && (*link)->start < end)
+        return false;
+
+    if (object == NULL)
+        dataLength = 0;
+    else if (dataLength > length)
+        dataLength = length;
+
+    OSMOS::System::Paging::Mapping *mapping = OSMOS::System::Paging::FREE_MAPPINGS;
+    OSMOS::System::Paging::FREE_MAPPINGS = mapping->next;
+
+    mapping->start = start;
+    mapping->end = end;
+    mapping->flags = flags;
+    mapping->pager = (object != NULL ? pager : NULL);
+    mapping->object = object;
+    mapping->offset = offset;
+    mapping->dataEnd = start + dataLength;
+    mapping->next = *link;
+    *link = mapping;
+
+    return true;
+}
+
+void OSMOS::System::Paging::unmap(OSMOS::System::Paging::Space *space, OSMOS::System::Paging::Mapping *mapping) {
+    for (address_t page = mapping->start; page < mapping->end; page += OSMOS::System::Paging::PAGE_SIZE) {
+        uint32_t *entry = OSMOS::System::Paging::getEntry(space, page, false);
+
+        // A whole missing page table is skipped at once
+        if (entry == NULL) {
+            page = (page & ~(PAGING_LARGE_SIZE - 1)) + PAGING_LARGE_SIZE - OSMOS::System::Paging::PAGE_SIZE;
+            continue;
+        }
+
+        if (!(*entry & OSMOS::System::Paging::PAGE_PRESENT))
+            continue;
+
+        uint32_t value = *entry;
+        OSMOS::System::Paging::setEntry(space, entry, page, 0);
+
+        if (value & OSMOS::System::Paging::PAGE_OBJECT)
+            mapping->pager->put(mapping->object, (mapping->offset + (page - mapping->start)) / OSMOS::System::Paging::PAGE_SIZE);
+        else
+            OSMOS::System::Frame::free(value & PAGING_ADDRESS_MASK);
+    }
+}
+
+bool OSMOS::System::Paging::removeMapping(OSMOS::System::Paging::Space *space, address_t start) {
+    OSMOS::System::Paging::Mapping **link = &space->mappings;
+    while (*link != NULL && (*link)->start != start)
+        link = &(*link)->next;
+
+    OSMOS::System::Paging::Mapping *mapping = *link;
+    if (mapping == NULL)
+        return false;
+
+    *link = mapping->next;
+    OSMOS::System::Paging::unmap(space, mapping);
+
+    if (mapping->object != NULL && mapping->pager->release != NULL)
+        mapping->pager->release(mapping->object);
+
+    mapping->next = OSMOS::System::Paging::FREE_MAPPINGS;
+    OSMOS::System::Paging::FREE_MAPPINGS = mapping;
+
+    return true;
+}
+
+bool OSMOS::System::Paging::resolve(OSMOS::System::Paging::Space *space, address_t address, bool write) {
+    OSMOS::System::Paging::Mapping *mapping = OSMOS::System::Paging::find(space, address);
+    if (mapping == NULL || (write && !(mapping->flags & OSMOS::System::Paging::MAPPING_WRITABLE)))
+        return false;
+
+    address_t page = address & ~(OSMOS::System::Paging::PAGE_SIZE - 1);
+    uint32_t index = (mapping->offset + (page - mapping->start)) / OSMOS::System::Paging::PAGE_SIZE;
+
+    uint32_t *entry = OSMOS::System::Paging::getEntry(space, page, true);
+    if (entry == NULL)
+        return false;
+
+    uint32_t flags = OSMOS::System::Paging::PAGE_PRESENT;
+    if (mapping->flags & OSMOS::System::Paging::MAPPING_USER)
+        flags |= OSMOS::System::Paging::PAGE_USER;
+
+    // A present page is either already resolved, or a lent page written for
+    // the first time, which is replaced by a copy
+    if (*entry & OSMOS::System::Paging::PAGE_PRESENT) {
+        if (!write || (*entry & OSMOS::System::Paging::PAGE_WRITABLE))
+            return true;
+
+        if (!(*entry & OSMOS::System::Paging::PAGE_OBJECT))
+            return false;
+
+        uint8_t *copy = (uint8_t *) OSMOS::System::Frame::allocate();
+        if (copy == NULL)
+            return false;
+
+        OSMOS::System::Memory::copy(copy, (uint8_t *) (*entry & PAGING_ADDRESS_MASK), OSMOS::System::Paging::PAGE_SIZE);
+        OSMOS::System::Paging::setEntry(space, entry, page, (address_t) copy | flags | OSMOS::System::Paging::PAGE_WRITABLE);
+        mapping->pager->put(mapping->object, index);
+
+        OSMOS::System::Paging::STATISTICS.copied++;
+        return true;
+    }
+
+    // A page wholly in the data of the object is lent, unless it is written
+    // right away
+    if (page + OSMOS::System::Paging::PAGE_SIZE <= mapping->dataEnd) {
+        address_t lent = mapping->pager->get(mapping->object, index);
+        if (lent == NULL)
+            return false;
+
+        // The pager may have waited for the disk, while another thread
+        // changed the space
+        if ((*entry & OSMOS::System::Paging::PAGE_PRESENT) || OSMOS::System::Paging::find(space, page) != mapping) {
+            mapping->pager->put(mapping->object, index);
+            return OSMOS::System::Paging::resolve(space, address, write);
+        }
+
+        if (!write) {
+            OSMOS::System::Paging::setEntry(space, entry, page, lent | flags | OSMOS::System::Paging::PAGE_OBJECT);
+            OSMOS::System::Paging::STATISTICS.lent++;
+            return true;
+        }
+
+        uint8_t *copy = (uint8_t *) OSMOS::System::Frame::allocate();
+        if (copy != NULL) {
+            OSMOS::System::Memory::copy(copy, (uint8_t *) lent, OSMOS::System::Paging::PAGE_SIZE);
+            OSMOS::System::Paging::setEntry(space, entry, page, (address_t) copy | flags | OSMOS::System::Paging::PAGE_WRITABLE);
+            OSMOS::System::Paging::STATISTICS.copied++;
+        }
+
+        mapping->pager->put(mapping->object, index);
+        return copy != NULL;
+    }
+
+    // Otherwise the page is zeroed, and the end of the data copied in
+    uint8_t *zeroed = (uint8_t *) OSMOS::System::Frame::allocate();
+    if (zeroed == NULL)
+        return false;
+
+    OSMOS::System::Memory::fill(zeroed, OSMOS::System::Paging::PAGE_SIZE, (uint8_t) 0);
+
+    if (page < mapping->dataEnd) {
+        address_t lent = mapping->pager->get(mapping->object, index);
+        if (lent == NULL) {
+            OSMOS::System::Frame::free((address_t) zeroed);
+            return false;
+        }
+
+        OSMOS::System::Memory::copy(zeroed, (uint8_t *) lent, mapping->dataEnd - page);
+        mapping->pager->put(mapping->object, index);
+
+        if ((*entry & OSMOS::System::Paging::PAGE_PRESENT) || OSMOS::System::Paging::find(space, page) != mapping) {
+            OSMOS::System::Frame::free((address_t) zeroed);
+            return OSMOS::System::Paging::resolve(space, address, write);
+        }
+    }
+
+    if (mapping->flags & OSMOS::System::Paging::MAPPING_WRITABLE)
+        flags |= OSMOS::System::Paging::PAGE_WRITABLE;
+
+    OSMOS::System::Paging::setEntry(space, entry, page, (address_t) zeroed | flags);
+    OSMOS::System::Paging::STATISTICS.zeroed++;
+
+    return true;
+}
+
+bool OSMOS::System::Paging::check(OSMOS::System::Paging::Space *space, address_t start, uint32_t length, bool write) {
+    if (length == 0)
+        return true;
+
+    if (start < OSMOS::System::Paging::USER_BASE || start >= OSMOS::System::Paging::USER_LIMIT || length > OSMOS::System::Paging::USER_LIMIT - start)
+        return false;
+
+    // The mappings never overlap, so the range is walked a mapping at a time
+    for (address_t address = start; address < start + length;) {
+        OSMOS::System::Paging::Mapping *mapping = OSMOS::System::Paging::find(space, address);
+
+        if (mapping == NULL || !(mapping->flags & OSMOS::System::Paging::MAPPING_USER))
+            return false;
+
+        if (write && !(mapping->flags & OSMOS::System::Paging::MAPPING_WRITABLE))
+            return false;
+
+        address = mapping->end;
+    }
+
+    return true;
+}
+
+void OSMOS::System::Paging::handleFault(OSMOS::System::Interrupts::Frame *frame) {
+    address_t address = OSMOS::System::Processor::getControlRegister2();
+
+    OSMOS::System::Paging::STATISTICS.faults++;
+
+    // Filling the page may wait for the disk, so the interrupts are enabled
+    // again if the faulting code had them
+    if (frame->eflags & PAGING_EFLAGS_INTERRUPT)
+        OSMOS::System::Interrupts::enable();
+
+    // The user code only reaches its own mappings
+    bool write = (frame->error & PAGING_FAULT_WRITE) != 0;
+    bool user = (frame->cs & 3) != 0;
+
+    if ((!user || OSMOS::System::Paging::check(OSMOS::System::Paging::CURRENT, address, 1, write)) && OSMOS::System::Paging::resolve(OSMOS::System::Paging::CURRENT, address, write))
+        return;
+
+    if (user) {
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, "\r\nUnhandled page fault in a process, exiting it\r\n");
+        OSMOS::System::Process::exit(OSMOS::System::Process::EXIT_FAULT);
+    }
+
+    OSMOS::IO::Port::out((uint16_t) 0x3F8, "\r\nUnhandled page fault, halting\r\n");
+
+    for (;;)
+        asm volatile("cli\n hlt");
+}
+
+OSMOS::System::Paging::Statistics *OSMOS::System::Paging::getStatistics() {
+    return &OSMOS::System::Paging::STATISTICS;
+}
\ No newline at end of file
@@ -0,0 +1,314 @@
+/*
+ * The paging class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PAGING_HPP
+#define PAGING_HPP
+
+#include "../osmos.hpp"
+
+#include "interrupts.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Paging's class that builds the address spaces. The kernel
+         * is identity mapped with 4 MB pages in every space, while the user
+         * area is described by mappings whose pages are only filled when they
+         * are first touched: from a pager, which lends the frames of an object
+         * (such as the pages of a cached file) without copying them, or with
+         * zeroed frames. A private mapping copies a lent page on its first
+         * write
+         **/
+        class Paging {
+        public:
+            /**
+             * The size in bytes of a page
+             **/
+            static const uint32_t PAGE_SIZE = 4096;
+            /**
+             * The number of entries of a page directory or a page table
+             **/
+            static const uint32_t ENTRY_COUNT = 1024;
+            /**
+             * The user area of the address spaces. Below is the kernel and the
+             * memory, above are the devices, both identity mapped
+             **/
+            static const uint32_t USER_BASE = 0x40000000;
+            static const uint32_t USER_LIMIT = 0xC0000000;
+            /**
+             * The maximum number of address spaces, besides the kernel one
+             **/
+            static const uint32_t SPACE_MAXIMUM = 16;
+            /**
+             * The maximum number of mappings of all the address spaces
+             **/
+            static const uint32_t MAPPING_MAXIMUM = 256;
+
+            /**
+             * The flags of the page directory and page table entries. The
+             * <i>object</i> flag is one of the bits left to the system: it
+             * marks a frame lent by the pager of the mapping
+             **/
+            static uint32_t PAGE_PRESENT;
+            static uint32_t PAGE_WRITABLE;
+            static uint32_t PAGE_USER;
+            static uint32_t PAGE_WRITE_THROUGH;
+            static uint32_t PAGE_CACHE_DISABLED;
+            static uint32_t PAGE_LARGE;
+            static uint32_t PAGE_OBJECT;
+
+            /**
+             * The flags of a mapping: writable, private (the writes are never
+             * seen by the object) and reachable by the user code
+             **/
+            static uint8_t MAPPING_WRITABLE;
+            static uint8_t MAPPING_PRIVATE;
+            static uint8_t MAPPING_USER;
+
+            /**
+             * The functions lending the pages of an object to the mappings
+             **/
+            struct Pager {
+                /**
+                 * Gets a page of the object and keeps it until put, returning
+                 * the address of its frame or NULL
+                 **/
+                address_t (*get)(void *object, uint32_t index);
+                /**
+                 * Gives back a page taken by get
+                 **/
+                void (*put)(void *object, uint32_t index);
+                /**
+                 * Releases the object once its mapping is removed
+                 **/
+                void (*release)(void *object);
+            };
+
+            /**
+             * A range of pages of an address space
+             **/
+            struct Mapping {
+                address_t start;
+                address_t end;
+                uint8_t flags;
+                /**
+                 * The pager and the object lending the pages, or NULL for
+                 * zeroed pages only
+                 **/
+                const OSMOS::System::Paging::Pager *pager;
+                void *object;
+                /**
+                 * The position in bytes of the start of the mapping in the
+                 * object, aligned on PAGE_SIZE
+                 **/
+                uint32_t offset;
+                /**
+                 * The end of the data of the object. The pages after it are
+                 * zeroed, and the page containing it is a copy whose end is
+                 * zeroed
+                 **/
+                address_t dataEnd;
+                OSMOS::System::Paging::Mapping *next;
+            };
+
+            /**
+             * An address space
+             **/
+            struct Space {
+                /**
+                 * The page directory, or NULL if the space is free
+                 **/
+                uint32_t *directory;
+                /**
+                 * The mappings, sorted by address
+                 **/
+                OSMOS::System::Paging::Mapping *mappings;
+            };
+
+            /**
+             * The counters of the page faults
+             **/
+            struct Statistics {
+                uint32_t faults;
+                /**
+                 * The pages lent by a pager, zeroed, and copied on write
+                 **/
+                uint32_t lent;
+                uint32_t zeroed;
+                uint32_t copied;
+            };
+
+        private:
+            /**
+             * The page directory of the kernel space, whose kernel entries are
+             * copied in every space
+             **/
+            static uint32_t KERNEL_DIRECTORY[ENTRY_COUNT] __attribute__((aligned(4096)));
+            static OSMOS::System::Paging::Space KERNEL_SPACE;
+            static OSMOS::System::Paging::Space SPACES[SPACE_MAXIMUM];
+            static OSMOS::System::Paging::Space *CURRENT;
+
+            static OSMOS::System::Paging::Mapping MAPPINGS[MAPPING_MAXIMUM];
+            static OSMOS::System::Paging::Mapping *FREE_MAPPINGS;
+
+            static OSMOS::System::Paging::Statistics STATISTICS;
+
+            /**
+             * @brief Gets the page table entry of a user address
+             * @param space the address space
+             * @param address the address
+             * @param create true to allocate the page table if it is missing
+             * @return the entry, or NULL if the address is not in the user
+             * area or the page table is missing
+             **/
+            static uint32_t *getEntry(OSMOS::System::Paging::Space *space, address_t address, bool create);
+            /**
+             * @brief Finds the mapping containing an address
+             * @param space the address space
+             * @param address the address
+             * @return the mapping, or NULL if the address is not mapped
+             **/
+            static OSMOS::System::Paging::Mapping *find(OSMOS::System::Paging::Space *space, address_t address);
+            /**
+             * @brief Sets a page table entry and flushes its translation if the
+             * space is the current one
+             * @param space the address space
+             * @param entry the entry
+             * @param address the address of the page
+             * @param value the new value of the entry
+             **/
+            static void setEntry(OSMOS::System::Paging::Space *space, uint32_t *entry, address_t address, uint32_t value);
+            /**
+             * @brief Unmaps the pages of a mapping, giving back the lent pages
+             * and freeing the others
+             * @param space the address space
+             * @param mapping the mapping
+             **/
+            static void unmap(OSMOS::System::Paging::Space *space, OSMOS::System::Paging::Mapping *mapping);
+            /**
+             * @brief Handles the exception #PF
+             * @param frame the state of the faulting code
+             **/
+            static void handleFault(OSMOS::System::Interrupts::Frame *frame);
+
+        public:
+            /**
+             * @brief Builds the kernel space, then enables the 4 MB pages, the
+             * paging and the write protection of the kernel
+             * @return false if the processor does not support the 4 MB pages,
+             * the paging staying disabled
+             **/
+            static bool initialize();
+
+            /**
+             * @brief Makes the writes to a range of the kernel space combined
+             * in the write buffers of the processor instead of uncached, such as
+             * for a framebuffer. Its 4 MB pages are changed as a whole
+             * @param start the first address, in the device area above the
+             * user area
+             * @param length the length in bytes
+             * @return false if the processor has no page attribute table or if
+             * the range is not in the device area
+             **/
+            static bool enableWriteCombining(address_t start, uint32_t length);
+
+            /**
+             * @brief Gets the kernel space, which has no mappings
+             * @return the kernel space
+             **/
+            static OSMOS::System::Paging::Space *getKernelSpace();
+            /**
+             * @brief Gets the active address space
+             * @return the active space
+             **/
+            static OSMOS::System::Paging::Space *getCurrentSpace();
+            /**
+             * @brief Creates an address space, with the kernel and no mappings
+             * @return the space, or NULL if there are too many spaces or no
+             * frame for its page directory
+             **/
+            static OSMOS::System::Paging::Space *create();
+            /**
+             * @brief Destroys an address space and its mappings. The kernel
+             * space becomes active if the space was
+             * @param space the space to destroy
+             **/
+            static void destroy(OSMOS::System::Paging::Space *space);
+            /**
+             * @brief Makes an address space the active one
+             * @param space the space to activate
+             **/
+            static void activate(OSMOS::System::Paging::Space *space);
+
+            /**
+             * @brief Adds a mapping to an address space. No page is mapped
+             * until it is touched
+             * @param space the address space
+             * @param start the first address, aligned on PAGE_SIZE
+             * @param length the length in bytes
+             * @param flags the MAPPING_* flags
+             * @param pager the pager of the object, or NULL
+             * @param object the object lending the pages, or NULL for zeroed
+             * pages. It is released with the mapping
+             * @param offset the position of the mapping in the object, aligned
+             * on PAGE_SIZE
+             * @param dataLength the length of the data of the object mapped
+             * from start, at most length
+             * @return false if the range is invalid or overlaps a mapping, or
+             * if a writable mapping of an object is not private
+             **/
+            static bool addMapping(OSMOS::System::Paging::Space *space, address_t start, uint32_t length, uint8_t flags, const OSMOS::System::Paging::Pager *pager, void *object, uint32_t offset, uint32_t dataLength);
+            /**
+             * @brief Removes a mapping, its pages and its object
+             * @param space the address space
+             * @param start the first address of the mapping
+             * @return false if no mapping starts at this address
+             **/
+            static bool removeMapping(OSMOS::System::Paging::Space *space, address_t start);
+            /**
+             * @brief Maps the page containing an address as its mapping asks,
+             * as a page fault does
+             * @param space the address space
+             * @param address the address
+             * @param write true if the page is written
+             * @return false if the address is not mapped, not writable or if
+             * the page could not be filled
+             **/
+            static bool resolve(OSMOS::System::Paging::Space *space, address_t address, bool write);
+            /**
+             * @brief Checks that a range of addresses is in mappings reachable
+             * by the user code, such as a buffer given to a system call
+             * @param space the address space
+             * @param start the first address
+             * @param length the length in bytes
+             * @param write true if the range is written
+             * @return false if a part of the range is not mapped for the user,
+             * or not writable
+             **/
+            static bool check(OSMOS::System::Paging::Space *space, address_t start, uint32_t length, bool write);
+
+            /**
+             * @brief Gets the counters of the page faults
+             * @return the counters
+             **/
+            static OSMOS::System::Paging::Statistics *getStatistics();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,170 @@
+/*
+ * The process class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "process.hpp"
+
+#include "elf.hpp"
+#include "interrupts.hpp"
+#include "../fs/pagecache.hpp"
+
+uint8_t OSMOS::System::Process::PROCESS_STATUS_FREE             = 0;
+uint8_t OSMOS::System::Process::PROCESS_STATUS_RUNNING          = 1;
+uint8_t OSMOS::System::Process::PROCESS_STATUS_EXITED           = 2;
+
+OSMOS::System::Process::Control OSMOS::System::Process::CONTROLS[OSMOS::System::Process::PROCESS_MAXIMUM];
+
+OSMOS::System::Process::Control *OSMOS::System::Process::create(OSMOS::System::Paging::Space *space, address_t entry) {
+    OSMOS::System::Process::Control *process = NULL;
+
+    for (uint32_t i = 0; process == NULL && i < OSMOS::System::Process::PROCESS_MAXIMUM; i++) {
+        if (OSMOS::System::Process::CONTROLS[i].status == OSMOS::System::Process::PROCESS_STATUS_FREE)
+            process = &OSMOS::System::Process::CONTROLS[i];
+    }
+
+    if (process == NULL)
+        return NULL;
+
+    address_t stack = OSMOS::System::Paging::USER_LIMIT - OSMOS::System::Process::STACK_SIZE;
+    if (!OSMOS::System::Paging::addMapping(space, stack, OSMOS::System::Process::STACK_SIZE, OSMOS::System::Paging::MAPPING_USER | OSMOS::System::Paging::MAPPING_WRITABLE | OSMOS::System::Paging::MAPPING_PRIVATE, NULL, NULL, 0, 0))
+        return NULL;
+
+    // The thread only runs once the caller yields, so the process is filled
+    // in after its creation
+    OSMOS::System::Scheduler::Thread *thread = OSMOS::System::Scheduler::create(OSMOS::System::Process::start, process);
+    if (thread == NULL) {
+        OSMOS::System::Paging::removeMapping(space, stack);
+        return NULL;
+    }
+
+    process->space = space;
+    process->thread = thread;
+    process->entry = entry;
+    process->exitCode = 0;
+    process->waiter = NULL;
+    process->status = OSMOS::System::Process::PROCESS_STATUS_RUNNING;
+    thread->space = space;
+
+    return process;
+}
+
+OSMOS::System::Process::Control *OSMOS::System::Process::execute(OSMOS::FS::Ext4::Volume *volume, const char *path) {
+    OSMOS::FS::PageCache::Object *object = OSMOS::FS::PageCache::open(volume, path);
+    if (object == NULL)
+        return NULL;
+
+    OSMOS::System::Paging::Space *space = OSMOS::System::Paging::create();
+    OSMOS::System::Process::Control *process = NULL;
+    address_t entry;
+
+    // The mappings of the segments keep the file open
+    if (space != NULL && OSMOS::System::ELF::load(space, object, &entry))
+        process = OSMOS::System::Process::create(space, entry);
+
+    OSMOS::FS::PageCache::close(object);
+
+    if (process == NULL && space != NULL)
+        OSMOS::System::Paging::destroy(space);
+
+    return process;
+}
+
+OSMOS::System::Process::Control *OSMOS::System::Process::execute(OSMOS::FS::Initramfs::File *file) {
+    OSMOS::System::Paging::Space *space = OSMOS::System::Paging::create();
+    if (space == NULL)
+        return NULL;
+
+    OSMOS::System::Process::Control *process = NULL;
+    address_t entry;
+
+    if (OSMOS::System::ELF::load(space, file, &entry))
+        process = OSMOS::System::Process::create(space, entry);
+
+    if (process == NULL)
+        OSMOS::System::Paging::destroy(space);
+
+    return process;
+}
+
+OSMOS::System::Process::Control *OSMOS::System::Process::getCurrent() {
+    OSMOS::System::Scheduler::Thread *thread = OSMOS::System::Scheduler::getCurrent();
+
+    for (uint32_t i = 0; i < OSMOS::System::Process::PROCESS_MAXIMUM; i++) {
+        OSMOS::System::Process::Control *process = &OSMOS::System::Process::CONTROLS[i];
+
+        if (process->status == OSMOS::System::Process::PROCESS_STATUS_RUNNING && process->thread == thread)
+            return process;
+    }
+
+    return NULL;
+}
+
+void OSMOS::System::Process::start(void *argument) {
+    OSMOS::System::Process::Control *process = (OSMOS::System::Process::Control *) argument;
+
+    // The user code starts with cleared registers, its stack at the end of
+    // the user area
+    asm volatile("xor eax, eax\n \
+                  xor ebx, ebx\n \
+                  xor esi, esi\n \
+                  xor edi, edi\n \
+                  xor ebp, ebp\n \
+                  sti\n \
+                  sysexit"
+                :
+                : "c" (OSMOS::System::Paging::USER_LIMIT), "d" (process->entry)
+                : "eax", "ebx", "esi", "edi", "memory");
+}
+
+void OSMOS::System::Process::exit(uint32_t code) {
+    OSMOS::System::Process::Control *process = OSMOS::System::Process::getCurrent();
+    if (process == NULL)
+        return;
+
+    // The thread runs on in the kernel space until it ends
+    process->thread->space = NULL;
+    OSMOS::System::Paging::destroy(process->space);
+    process->space = NULL;
+
+    OSMOS::System::Interrupts::disable();
+
+    process->exitCode = code;
+    process->status = OSMOS::System::Process::PROCESS_STATUS_EXITED;
+    if (process->waiter != NULL)
+        OSMOS::System::Scheduler::wake(process->waiter);
+
+    OSMOS::System::Scheduler::exit();
+}
+
+uint32_t OSMOS::System::Process::wait(OSMOS::System::Process::Control *process) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    while (process->status != OSMOS::System::Process::PROCESS_STATUS_EXITED) {
+        process->waiter = OSMOS::System::Scheduler::getCurrent();
+        OSMOS::System::Scheduler::block();
+    }
+
+    uint32_t code = process->exitCode;
+    process->waiter = NULL;
+    process->status = OSMOS::System::Process::PROCESS_STATUS_FREE;
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+
+    return code;
+}
\ No newline at end of file
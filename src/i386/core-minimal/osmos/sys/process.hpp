@@ -0,0 +1,138 @@
+/*
+ * The process class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROCESS_HPP
+#define PROCESS_HPP
+
+#include "../osmos.hpp"
+
+#include "paging.hpp"
+#include "scheduler.hpp"
+#include "../fs/ext4.hpp"
+#include "../fs/initramfs.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Process' class that runs user code: a process is a thread
+         * with its own address space, entering the user code with sysexit and
+         * coming back to the kernel with the system calls and the interrupts
+         **/
+        class Process {
+        public:
+            /**
+             * The maximum number of processes
+             **/
+            static const uint32_t PROCESS_MAXIMUM = 8;
+            /**
+             * The size in bytes of the stack of a process, at the end of the
+             * user area. Its pages are zeroed when first touched
+             **/
+            static const uint32_t STACK_SIZE = 65536;
+            /**
+             * The exit code of a process ended by an exception
+             **/
+            static const uint32_t EXIT_FAULT = 0xFFFFFFFF;
+
+            /**
+             * The <i>free</i> status indicates that the slot can be used by
+             * create, the <i>running</i> one that the process has not exited,
+             * and the <i>exited</i> one that its exit code waits for wait
+             **/
+            static uint8_t PROCESS_STATUS_FREE;
+            static uint8_t PROCESS_STATUS_RUNNING;
+            static uint8_t PROCESS_STATUS_EXITED;
+
+            /**
+             * The state of a process
+             **/
+            struct Control {
+                OSMOS::System::Paging::Space *space;
+                OSMOS::System::Scheduler::Thread *thread;
+                /**
+                 * The first address of the user code
+                 **/
+                address_t entry;
+                uint32_t exitCode;
+                volatile uint8_t status;
+                /**
+                 * The thread blocked in wait, or NULL
+                 **/
+                OSMOS::System::Scheduler::Thread *waiter;
+            };
+
+        private:
+            static OSMOS::System::Process::Control CONTROLS[PROCESS_MAXIMUM];
+
+            /**
+             * @brief The function ran by the thread of a process, which leaves
+             * the kernel for the user code
+             * @param argument the process
+             **/
+            static void start(void *argument);
+
+        public:
+            /**
+             * @brief Creates a process running in an address space. A stack is
+             * mapped at the end of the user area
+             * @param space the address space, destroyed when the process exits
+             * @param entry the first address of the user code
+             * @return the process, or NULL if there is no free slot or thread,
+             * the space being left to the caller
+             **/
+            static OSMOS::System::Process::Control *create(OSMOS::System::Paging::Space *space, address_t entry);
+            /**
+             * @brief Creates a process running an executable. Its segments are
+             * mapped from the page cache, and only read when first touched
+             * @param volume the volume of the executable
+             * @param path the absolute path of the executable
+             * @return the process, or NULL if the executable is not found or
+             * invalid, or if the process could not be created
+             **/
+            static OSMOS::System::Process::Control *execute(OSMOS::FS::Ext4::Volume *volume, const char *path);
+            /**
+             * @brief Creates a process running an executable of the initramfs.
+             * Its segments are mapped from the memory of the module
+             * @param file the file of the executable
+             * @return the process, or NULL if the executable is invalid, or if
+             * the process could not be created
+             **/
+            static OSMOS::System::Process::Control *execute(OSMOS::FS::Initramfs::File *file);
+            /**
+             * @brief Gets the process of the running thread
+             * @return the process, or NULL for a kernel thread
+             **/
+            static OSMOS::System::Process::Control *getCurrent();
+
+            /**
+             * @brief Ends the process of the running thread: destroys its space,
+             * wakes its waiter and ends its thread
+             * @param code the exit code
+             **/
+            static void exit(uint32_t code);
+            /**
+             * @brief Waits for a process to exit and frees its slot
+             * @param process the process
+             * @return the exit code of the process
+             **/
+            static uint32_t wait(OSMOS::System::Process::Control *process);
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+/*
+ * The processor control class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "processor.hpp"
+
+uint32_t OSMOS::System::Processor::FEATURE_PSE              = 1 << 3;
+uint32_t OSMOS::System::Processor::FEATURE_TSC              = 1 << 4;
+uint32_t OSMOS::System::Processor::FEATURE_MSR              = 1 << 5;
+uint32_t OSMOS::System::Processor::FEATURE_SEP              = 1 << 11;
+uint32_t OSMOS::System::Processor::FEATURE_PAT              = 1 << 16;
+uint32_t OSMOS::System::Processor::FEATURE_FXSR             = 1 << 24;
+uint32_t OSMOS::System::Processor::FEATURE_SSE              = 1 << 25;
+uint32_t OSMOS::System::Processor::FEATURE_SSE2             = 1 << 26;
+
+uint32_t OSMOS::System::Processor::CR0_MONITOR_COPROCESSOR  = 1 << 1;
+uint32_t OSMOS::System::Processor::CR0_EMULATION            = 1 << 2;
+uint32_t OSMOS::System::Processor::CR0_TASK_SWITCHED        = 1 << 3;
+uint32_t OSMOS::System::Processor::CR0_NUMERIC_ERROR        = 1 << 5;
+uint32_t OSMOS::System::Processor::CR0_WRITE_PROTECT        = 1 << 16;
+uint32_t OSMOS::System::Processor::CR0_PAGING               = 1U << 31;
+uint32_t OSMOS::System::Processor::CR4_PAGE_SIZE_EXTENSION  = 1 << 4;
+uint32_t OSMOS::System::Processor::CR4_OSFXSR               = 1 << 9;
+uint32_t OSMOS::System::Processor::CR4_OSXMMEXCPT           = 1 << 10;
+
+void OSMOS::System::Processor::identify(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    asm volatile("cpuid"
+                : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                : "a" (leaf), "c" (0));
+}
+
+bool OSMOS::System::Processor::hasFeature(uint32_t feature) {
+    uint32_t eax, ebx, ecx, edx;
+
+    OSMOS::System::Processor::identify(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 1)
+        return false;
+
+    OSMOS::System::Processor::identify(1, &eax, &ebx, &ecx, &edx);
+    return (edx & feature) == feature;
+}
+
+uint32_t OSMOS::System::Processor::getControlRegister0() {
+    uint32_t value;
+    asm volatile("mov %[value], cr0"
+                : [value] "=r" (value));
+    return value;
+}
+
+void OSMOS::System::Processor::setControlRegister0(uint32_t value) {
+    asm volatile("mov cr0, %[value]"
+                :
+                : [value] "r" (value)
+                : "memory");
+}
+
+uint32_t OSMOS::System::Processor::getControlRegister2() {
+    uint32_t value;
+    asm volatile("mov %[value], cr2"
+                : [value] "=r" (value));
+    return value;
+}
+
+uint32_t OSMOS::System::Processor::getControlRegister3() {
+    uint32_t value;
+    asm volatile("mov %[value], cr3"
+                : [value] "=r" (value));
+    return value;
+}
+
+void OSMOS::System::Processor::setControlRegister3(uint32_t value) {
+    asm volatile("mov cr3, %[value]"
+                :
+                : [value] "r" (value)
+                : "memory");
+}
+
+uint32_t OSMOS::System::Processor::getControlRegister4() {
+    uint32_t value;
+    asm volatile("mov %[value], cr4"
+                : [value] "=r" (value));
+    return value;
+}
+
+void OSMOS::System::Processor::setControlRegister4(uint32_t value) {
+    asm volatile("mov cr4, %[value]"
+                :
+                : [value] "r" (value)
+                : "memory");
+}
+
+uint64_t OSMOS::System::Processor::readModelSpecificRegister(uint32_t index) {
+    uint32_t low, high;
+    asm volatile("rdmsr"
+                : "=a" (low), "=d" (high)
+                : "c" (index));
+    return ((uint64_t) high << 32) | low;
+}
+
+void OSMOS::System::Processor::writeModelSpecificRegister(uint32_t index, uint64_t value) {
+    asm volatile("wrmsr"
+                :
+                : "c" (index), "a" ((uint32_t) value), "d" ((uint32_t) (value >> 32))
+                : "memory");
+}
+
+uint64_t OSMOS::System::Processor::readTimestamp() {
+    uint32_t low, high;
+    asm volatile("rdtsc"
+                : "=a" (low), "=d" (high));
+    return ((uint64_t) high << 32) | low;
+}
+
+void OSMOS::System::Processor::invalidatePage(address_t address) {
+    asm volatile("invlpg [%[address]]"
+                :
+                : [address] "r" (address)
+                : "memory");
+}
+
+void OSMOS::System::Processor::writeBackCaches() {
+    asm volatile("wbinvd" : : : "memory");
+}
+
+void OSMOS::System::Processor::setTaskSwitched() {
+    OSMOS::System::Processor::setControlRegister0(OSMOS::System::Processor::getControlRegister0() | OSMOS::System::Processor::CR0_TASK_SWITCHED);
+}
+
+void OSMOS::System::Processor::clearTaskSwitched() {
+    asm volatile("clts" : : : "memory");
+}
+
+bool OSMOS::System::Processor::enableSSE() {
+    if (!OSMOS::System::Processor::hasFeature(OSMOS::System::Processor::FEATURE_FXSR | OSMOS::System::Processor::FEATURE_SSE | OSMOS::System::Processor::FEATURE_SSE2))
+        return false;
+
+    uint32_t cr0 = OSMOS::System::Processor::getControlRegister0();
+    cr0 &= ~(OSMOS::System::Processor::CR0_EMULATION | OSMOS::System::Processor::CR0_TASK_SWITCHED);
+    cr0 |= OSMOS::System::Processor::CR0_MONITOR_COPROCESSOR | OSMOS::System::Processor::CR0_NUMERIC_ERROR;
+    OSMOS::System::Processor::setControlRegister0(cr0);
+
+    OSMOS::System::Processor::setControlRegister4(OSMOS::System::Processor::getControlRegister4() | OSMOS::System::Processor::CR4_OSFXSR | OSMOS::System::Processor::CR4_OSXMMEXCPT);
+
+    asm volatile("fninit");
+    return true;
+}
\ No newline at end of file
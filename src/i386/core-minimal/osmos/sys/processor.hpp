@@ -0,0 +1,219 @@
+/*
+ * The processor control class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROCESSOR_HPP
+#define PROCESSOR_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Processor's class that contains functions for identifying
+         * the processor and accessing its control registers
+         **/
+        class Processor {
+        public:
+            /**
+             * The <i>PSE</i> feature (CPUID leaf 1, EDX bit 3) indicates that
+             * the processor supports 4 MB pages
+             **/
+            static uint32_t FEATURE_PSE;
+            /**
+             * The <i>TSC</i> feature (CPUID leaf 1, EDX bit 4) indicates that
+             * the processor has a time stamp counter readable with rdtsc
+             **/
+            static uint32_t FEATURE_TSC;
+            /**
+             * The <i>MSR</i> feature (CPUID leaf 1, EDX bit 5) indicates that
+             * the processor supports the rdmsr and wrmsr instructions
+             **/
+            static uint32_t FEATURE_MSR;
+            /**
+             * The <i>SEP</i> feature (CPUID leaf 1, EDX bit 11) indicates that
+             * the processor supports the sysenter and sysexit instructions
+             **/
+            static uint32_t FEATURE_SEP;
+            /**
+             * The <i>PAT</i> feature (CPUID leaf 1, EDX bit 16) indicates that
+             * the processor has a page attribute table, which gives the memory
+             * types selected by the cache bits of the pages
+             **/
+            static uint32_t FEATURE_PAT;
+            /**
+             * The <i>FXSR</i> feature (CPUID leaf 1, EDX bit 24) indicates that
+             * the processor supports the fxsave and fxrstor instructions
+             **/
+            static uint32_t FEATURE_FXSR;
+            /**
+             * The <i>SSE</i> feature (CPUID leaf 1, EDX bit 25)
+             **/
+            static uint32_t FEATURE_SSE;
+            /**
+             * The <i>SSE2</i> feature (CPUID leaf 1, EDX bit 26)
+             **/
+            static uint32_t FEATURE_SSE2;
+
+            /**
+             * The <i>MP</i> (monitor coprocessor) bit of CR0
+             **/
+            static uint32_t CR0_MONITOR_COPROCESSOR;
+            /**
+             * The <i>EM</i> (emulation) bit of CR0, which makes every FPU/SSE
+             * instruction fault when set
+             **/
+            static uint32_t CR0_EMULATION;
+            /**
+             * The <i>TS</i> (task switched) bit of CR0, which makes the next
+             * FPU/SSE instruction raise a device not available exception (#NM)
+             **/
+            static uint32_t CR0_TASK_SWITCHED;
+            /**
+             * The <i>NE</i> (numeric error) bit of CR0, which reports x87 errors
+             * through the exception #MF instead of the legacy IRQ 13
+             **/
+            static uint32_t CR0_NUMERIC_ERROR;
+            /**
+             * The <i>WP</i> (write protect) bit of CR0, which makes the kernel
+             * fault on writes to read-only pages, as user code does
+             **/
+            static uint32_t CR0_WRITE_PROTECT;
+            /**
+             * The <i>PG</i> (paging) bit of CR0
+             **/
+            static uint32_t CR0_PAGING;
+            /**
+             * The <i>PSE</i> bit of CR4, which enables the 4 MB pages
+             **/
+            static uint32_t CR4_PAGE_SIZE_EXTENSION;
+            /**
+             * The <i>OSFXSR</i> bit of CR4, which tells the processor that the
+             * operating system saves the SSE state with fxsave/fxrstor
+             **/
+            static uint32_t CR4_OSFXSR;
+            /**
+             * The <i>OSXMMEXCPT</i> bit of CR4, which tells the processor that
+             * the operating system handles the SIMD exception #XM
+             **/
+            static uint32_t CR4_OSXMMEXCPT;
+
+            /**
+             * @brief Executes the cpuid instruction for the given leaf
+             * @param leaf the leaf to query (value of EAX)
+             * @param eax the pointer receiving the EAX result
+             * @param ebx the pointer receiving the EBX result
+             * @param ecx the pointer receiving the ECX result
+             * @param edx the pointer receiving the EDX result
+             **/
+            static void identify(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+            /**
+             * @brief Checks if the processor has the given feature, which is one
+             * of the FEATURE_* values of this class (CPUID leaf 1, EDX)
+             * @param feature the feature to check
+             * @return true if the processor supports the feature
+             **/
+            static bool hasFeature(uint32_t feature);
+
+            /**
+             * @brief Gets the value of the control register CR0
+             * @return the value of CR0
+             **/
+            static uint32_t getControlRegister0();
+            /**
+             * @brief Sets the value of the control register CR0
+             * @param value the value to set
+             **/
+            static void setControlRegister0(uint32_t value);
+            /**
+             * @brief Gets the value of the control register CR2, which holds
+             * the address of the last page fault
+             * @return the value of CR2
+             **/
+            static uint32_t getControlRegister2();
+            /**
+             * @brief Gets the value of the control register CR3
+             * @return the value of CR3, the physical address of the page
+             * directory
+             **/
+            static uint32_t getControlRegister3();
+            /**
+             * @brief Sets the value of the control register CR3, which also
+             * flushes the TLB
+             * @param value the physical address of the page directory
+             **/
+            static void setControlRegister3(uint32_t value);
+            /**
+             * @brief Gets the value of the control register CR4
+             * @return the value of CR4
+             **/
+            static uint32_t getControlRegister4();
+            /**
+             * @brief Sets the value of the control register CR4
+             * @param value the value to set
+             **/
+            static void setControlRegister4(uint32_t value);
+
+            /**
+             * @brief Reads a model-specific register (rdmsr)
+             * @param index the index of the register
+             * @return the value of the register
+             **/
+            static uint64_t readModelSpecificRegister(uint32_t index);
+            /**
+             * @brief Writes a model-specific register (wrmsr)
+             * @param index the index of the register
+             * @param value the value to write
+             **/
+            static void writeModelSpecificRegister(uint32_t index, uint64_t value);
+            /**
+             * @brief Reads the time stamp counter (rdtsc)
+             * @return the number of cycles since the reset of the processor
+             **/
+            static uint64_t readTimestamp();
+            /**
+             * @brief Removes the translation of a page from the TLB (invlpg)
+             * @param address an address in the page
+             **/
+            static void invalidatePage(address_t address);
+            /**
+             * @brief Writes back and invalidates the caches (wbinvd), as needed
+             * when the memory type of a page changes
+             **/
+            static void writeBackCaches();
+            /**
+             * @brief Sets the TS bit of CR0, so the next FPU/SSE instruction
+             * raises the exception #NM
+             **/
+            static void setTaskSwitched();
+            /**
+             * @brief Clears the TS bit of CR0 with the clts instruction
+             **/
+            static void clearTaskSwitched();
+
+            /**
+             * @brief Enables the FPU, SSE and SSE2 after checking them with
+             * cpuid: clears CR0.EM, sets CR0.MP/NE and CR4.OSFXSR/OSXMMEXCPT,
+             * then initializes the FPU
+             * @return true if SSE and SSE2 are available and enabled
+             **/
+            static bool enableSSE();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,189 @@
+/*
+ * The kernel thread scheduler class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "scheduler.hpp"
+
+#include "interrupts.hpp"
+#include "segments.hpp"
+#include "../io/timer.hpp"
+
+uint8_t OSMOS::System::Scheduler::THREAD_STATUS_FREE            = 0;
+uint8_t OSMOS::System::Scheduler::THREAD_STATUS_RUNNABLE        = 1;
+uint8_t OSMOS::System::Scheduler::THREAD_STATUS_BLOCKED         = 2;
+
+OSMOS::System::Scheduler::Thread OSMOS::System::Scheduler::THREADS[OSMOS::System::Scheduler::THREAD_MAXIMUM];
+OSMOS::System::Scheduler::Thread *OSMOS::System::Scheduler::CURRENT = NULL;
+uint8_t OSMOS::System::Scheduler::STACKS[OSMOS::System::Scheduler::THREAD_MAXIMUM][OSMOS::System::Scheduler::THREAD_STACK_SIZE] __attribute__((aligned(16)));
+
+// Saves the callee-saved registers, the flags and the stack pointer of the
+// running thread, then loads the ones of the next thread and returns into it.
+// The flags are kept per thread so a thread blocking with the interrupts
+// disabled does not run the next one with the interrupts disabled
+extern "C" void __attribute__((naked)) schedulerSwitch(address_t *, address_t) {
+    asm("mov eax, [esp + 4]\n \
+         mov edx, [esp + 8]\n \
+         push ebp\n \
+         push ebx\n \
+         push esi\n \
+         push edi\n \
+         pushfd\n \
+         mov [eax], esp\n \
+         mov esp, edx\n \
+         popfd\n \
+         pop edi\n \
+         pop esi\n \
+         pop ebx\n \
+         pop ebp\n \
+         ret");
+}
+
+bool OSMOS::System::Scheduler::initialize() {
+    for (uint32_t i = 0; i < OSMOS::System::Scheduler::THREAD_MAXIMUM; i++) {
+        OSMOS::System::Scheduler::THREADS[i].status = OSMOS::System::Scheduler::THREAD_STATUS_FREE;
+        OSMOS::System::Scheduler::THREADS[i].identifier = i;
+    }
+
+    OSMOS::System::Scheduler::CURRENT = &OSMOS::System::Scheduler::THREADS[0];
+    OSMOS::System::Scheduler::CURRENT->status = OSMOS::System::Scheduler::THREAD_STATUS_RUNNABLE;
+    OSMOS::System::Scheduler::CURRENT->entry = NULL;
+    OSMOS::System::Scheduler::CURRENT->argument = NULL;
+    OSMOS::System::Scheduler::CURRENT->wakeTick = 0;
+    OSMOS::System::Scheduler::CURRENT->space = NULL;
+
+    return OSMOS::System::FPU::initialize(&OSMOS::System::Scheduler::CURRENT->fpu);
+}
+
+OSMOS::System::Scheduler::Thread *OSMOS::System::Scheduler::create(void (*entry)(void *argument), void *argument) {
+    OSMOS::System::Scheduler::Thread *thread = NULL;
+
+    for (uint32_t i = 1; i < OSMOS::System::Scheduler::THREAD_MAXIMUM; i++) {
+        if (OSMOS::System::Scheduler::THREADS[i].status == OSMOS::System::Scheduler::THREAD_STATUS_FREE) {
+            thread = &OSMOS::System::Scheduler::THREADS[i];
+            break;
+        }
+    }
+
+    if (thread == NULL)
+        return NULL;
+
+    thread->entry = entry;
+    thread->argument = argument;
+    thread->wakeTick = 0;
+    thread->space = NULL;
+    OSMOS::System::FPU::initializeState(&thread->fpu);
+
+    // The stack is built as if the thread was switched out right before
+    // entering start: the return address, 4 callee-saved registers, then the
+    // flags with the interrupts enabled
+    uint32_t *stack = (uint32_t *) &OSMOS::System::Scheduler::STACKS[thread->identifier][OSMOS::System::Scheduler::THREAD_STACK_SIZE];
+    *--stack = 0;
+    *--stack = (uint32_t) OSMOS::System::Scheduler::start;
+    *--stack = 0;
+    *--stack = 0;
+    *--stack = 0;
+    *--stack = 0;
+    *--stack = 0x202;
+    thread->stackPointer = (address_t) stack;
+
+    thread->status = OSMOS::System::Scheduler::THREAD_STATUS_RUNNABLE;
+    return thread;
+}
+
+OSMOS::System::Scheduler::Thread *OSMOS::System::Scheduler::getCurrent() {
+    return OSMOS::System::Scheduler::CURRENT;
+}
+
+void OSMOS::System::Scheduler::start() {
+    OSMOS::System::Scheduler::CURRENT->entry(OSMOS::System::Scheduler::CURRENT->argument);
+    OSMOS::System::Scheduler::exit();
+}
+
+void OSMOS::System::Scheduler::yield() {
+    for (;;) {
+        OSMOS::System::Scheduler::Thread *current = OSMOS::System::Scheduler::CURRENT;
+
+        // The last candidate is the running thread itself
+        for (uint32_t i = 1; i <= OSMOS::System::Scheduler::THREAD_MAXIMUM; i++) {
+            OSMOS::System::Scheduler::Thread *next = &OSMOS::System::Scheduler::THREADS[(current->identifier + i) % OSMOS::System::Scheduler::THREAD_MAXIMUM];
+
+            if (*((volatile uint8_t *) &next->status) != OSMOS::System::Scheduler::THREAD_STATUS_RUNNABLE)
+                continue;
+
+            if (next == current)
+                return;
+
+            // The kernel threads keep the active space, so switching between
+            // a process and the kernel threads never flushes the TLB
+            if (next->space != NULL && next->space != OSMOS::System::Paging::getCurrentSpace())
+                OSMOS::System::Paging::activate(next->space);
+
+            OSMOS::System::Segments::setKernelStack((address_t) &OSMOS::System::Scheduler::STACKS[next->identifier][OSMOS::System::Scheduler::THREAD_STACK_SIZE]);
+
+            OSMOS::System::Scheduler::CURRENT = next;
+            OSMOS::System::FPU::switchContext(&next->fpu);
+            schedulerSwitch(&current->stackPointer, next->stackPointer);
+            return;
+        }
+
+        // Nothing to run: wait for an interrupt handler to wake a thread
+        bool enabled = OSMOS::System::Interrupts::areEnabled();
+        asm volatile("sti\n hlt" : : : "memory");
+        if (!enabled)
+            OSMOS::System::Interrupts::disable();
+    }
+}
+
+void OSMOS::System::Scheduler::block() {
+    OSMOS::System::Scheduler::CURRENT->status = OSMOS::System::Scheduler::THREAD_STATUS_BLOCKED;
+    OSMOS::System::Scheduler::yield();
+}
+
+void OSMOS::System::Scheduler::wake(OSMOS::System::Scheduler::Thread *thread) {
+    if (thread->status == OSMOS::System::Scheduler::THREAD_STATUS_BLOCKED) {
+        thread->wakeTick = 0;
+        thread->status = OSMOS::System::Scheduler::THREAD_STATUS_RUNNABLE;
+    }
+}
+
+void OSMOS::System::Scheduler::sleep(uint32_t ticks) {
+    bool enabled = OSMOS::System::Interrupts::areEnabled();
+    OSMOS::System::Interrupts::disable();
+
+    // A null wake tick means "not sleeping", so it is skipped
+    uint32_t wakeTick = OSMOS::IO::Timer::getTicks() + (ticks > 0 ? ticks : 1);
+    OSMOS::System::Scheduler::CURRENT->wakeTick = (wakeTick != 0 ? wakeTick : 1);
+    OSMOS::System::Scheduler::block();
+
+    if (enabled)
+        OSMOS::System::Interrupts::enable();
+}
+
+void OSMOS::System::Scheduler::tick(uint32_t now) {
+    for (uint32_t i = 0; i < OSMOS::System::Scheduler::THREAD_MAXIMUM; i++) {
+        OSMOS::System::Scheduler::Thread *thread = &OSMOS::System::Scheduler::THREADS[i];
+
+        if (thread->wakeTick != 0 && (int32_t) (now - thread->wakeTick) >= 0)
+            OSMOS::System::Scheduler::wake(thread);
+    }
+}
+
+void OSMOS::System::Scheduler::exit() {
+    OSMOS::System::FPU::release(&OSMOS::System::Scheduler::CURRENT->fpu);
+    OSMOS::System::Scheduler::CURRENT->status = OSMOS::System::Scheduler::THREAD_STATUS_FREE;
+    OSMOS::System::Scheduler::yield();
+}
\ No newline at end of file
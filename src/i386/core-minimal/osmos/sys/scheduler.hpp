@@ -0,0 +1,170 @@
+/*
+ * The kernel thread scheduler class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include "../osmos.hpp"
+
+#include "fpu.hpp"
+#include "paging.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Scheduler's class that runs kernel threads cooperatively: a
+         * thread keeps the processor until it calls yield, block or exit. A
+         * thread running a process also switches to its address space and
+         * enters the kernel on its own stack
+         **/
+        class Scheduler {
+        public:
+            /**
+             * The maximum number of threads, including the boot thread
+             **/
+            static const uint32_t THREAD_MAXIMUM = 16;
+            /**
+             * The size in bytes of the stack of a created thread
+             **/
+            static const uint32_t THREAD_STACK_SIZE = 8192;
+
+            /**
+             * The <i>free</i> status indicates that the slot of the thread can
+             * be used by create
+             **/
+            static uint8_t THREAD_STATUS_FREE;
+            /**
+             * The <i>runnable</i> status indicates that the thread is running
+             * or waiting for the processor
+             **/
+            static uint8_t THREAD_STATUS_RUNNABLE;
+            /**
+             * The <i>blocked</i> status indicates that the thread waits for a
+             * wake call and is skipped by yield
+             **/
+            static uint8_t THREAD_STATUS_BLOCKED;
+
+            /**
+             * The state of a thread
+             **/
+            struct Thread {
+                /**
+                 * The FPU/SSE registers of the thread, saved lazily
+                 **/
+                OSMOS::System::FPU::State fpu;
+                /**
+                 * The saved stack pointer while the thread is not running
+                 **/
+                address_t stackPointer;
+                /**
+                 * The function ran by the thread, and its argument
+                 **/
+                void (*entry)(void *argument);
+                void *argument;
+                uint32_t identifier;
+                uint8_t status;
+                /**
+                 * The tick at which a sleeping thread is woken, or 0 if the
+                 * thread is not sleeping
+                 **/
+                uint32_t wakeTick;
+                /**
+                 * The address space of the process ran by the thread, or NULL
+                 * for a kernel thread, which runs in whichever space is active
+                 **/
+                OSMOS::System::Paging::Space *space;
+            };
+
+        private:
+            /**
+             * The slots of the threads, the first one being the boot thread
+             **/
+            static OSMOS::System::Scheduler::Thread THREADS[THREAD_MAXIMUM];
+            /**
+             * The running thread
+             **/
+            static OSMOS::System::Scheduler::Thread *CURRENT;
+            /**
+             * The stacks of the created threads
+             **/
+            static uint8_t STACKS[THREAD_MAXIMUM][THREAD_STACK_SIZE];
+
+            /**
+             * @brief The first function ran by a created thread, which calls
+             * its entry then exits
+             **/
+            static void start();
+
+        public:
+            /**
+             * @brief Makes the running code the boot thread and enables the
+             * lazy FPU/SSE switching
+             * @return true if the FPU and SSE are available
+             **/
+            static bool initialize();
+
+            /**
+             * @brief Creates a runnable thread
+             * @param entry the function ran by the thread
+             * @param argument the argument given to the function
+             * @return the created thread, or NULL if there is no free slot
+             **/
+            static OSMOS::System::Scheduler::Thread *create(void (*entry)(void *argument), void *argument);
+            /**
+             * @brief Gets the running thread
+             * @return the running thread
+             **/
+            static OSMOS::System::Scheduler::Thread *getCurrent();
+
+            /**
+             * @brief Gives the processor to the next runnable thread. If no
+             * thread is runnable, the processor waits for an interrupt
+             **/
+            static void yield();
+            /**
+             * @brief Blocks the running thread until another thread or an
+             * interrupt handler wakes it. The caller should disable the
+             * interrupts while checking its wake-up condition, so a wake call
+             * cannot be lost between the check and the block
+             **/
+            static void block();
+            /**
+             * @brief Makes a blocked thread runnable again
+             * @param thread the thread to wake
+             **/
+            static void wake(OSMOS::System::Scheduler::Thread *thread);
+            /**
+             * @brief Blocks the running thread for a number of timer ticks
+             * @param ticks the number of ticks to sleep
+             **/
+            static void sleep(uint32_t ticks);
+            /**
+             * @brief Wakes the sleeping threads whose tick has come. It is
+             * called by the timer interrupt handler
+             * @param now the current tick
+             **/
+            static void tick(uint32_t now);
+            /**
+             * @brief Ends the running thread and frees its slot
+             **/
+            static void exit();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
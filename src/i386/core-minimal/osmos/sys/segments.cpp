@@ -0,0 +1,94 @@
+/*
+ * The segments class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "segments.hpp"
+
+#include "memory.hpp"
+
+OSMOS::System::Segments::Descriptor OSMOS::System::Segments::TABLE[OSMOS::System::Segments::DESCRIPTOR_COUNT];
+OSMOS::System::Segments::TaskState OSMOS::System::Segments::TASK_STATE;
+
+// The access bytes of the segments: present, privilege level, then type
+#define SEGMENTS_ACCESS_KERNEL_CODE                         0x9A
+#define SEGMENTS_ACCESS_KERNEL_DATA                         0x92
+#define SEGMENTS_ACCESS_USER_CODE                           0xFA
+#define SEGMENTS_ACCESS_USER_DATA                           0xF2
+#define SEGMENTS_ACCESS_TASK_STATE                          0x89
+
+// The flags of the flat segments: 4 KB granularity, 32-bit
+#define SEGMENTS_FLAGS_FLAT                                 0x0C
+
+void OSMOS::System::Segments::setDescriptor(uint32_t index, address_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    OSMOS::System::Segments::Descriptor *descriptor = &OSMOS::System::Segments::TABLE[index];
+
+    descriptor->limitLow = limit & 0xFFFF;
+    descriptor->baseLow = base & 0xFFFF;
+    descriptor->baseMiddle = (base >> 16) & 0xFF;
+    descriptor->access = access;
+    descriptor->granularity = (uint8_t) ((flags << 4) | ((limit >> 16) & 0x0F));
+    descriptor->baseHigh = (base >> 24) & 0xFF;
+}
+
+void OSMOS::System::Segments::initialize() {
+    OSMOS::System::Segments::setDescriptor(0, 0, 0, 0, 0);
+    OSMOS::System::Segments::setDescriptor(OSMOS::System::Segments::SELECTOR_KERNEL_CODE / 8, 0, 0xFFFFF, SEGMENTS_ACCESS_KERNEL_CODE, SEGMENTS_FLAGS_FLAT);
+    OSMOS::System::Segments::setDescriptor(OSMOS::System::Segments::SELECTOR_KERNEL_DATA / 8, 0, 0xFFFFF, SEGMENTS_ACCESS_KERNEL_DATA, SEGMENTS_FLAGS_FLAT);
+    OSMOS::System::Segments::setDescriptor(OSMOS::System::Segments::SELECTOR_USER_CODE / 8, 0, 0xFFFFF, SEGMENTS_ACCESS_USER_CODE, SEGMENTS_FLAGS_FLAT);
+    OSMOS::System::Segments::setDescriptor(OSMOS::System::Segments::SELECTOR_USER_DATA / 8, 0, 0xFFFFF, SEGMENTS_ACCESS_USER_DATA, SEGMENTS_FLAGS_FLAT);
+
+    // Without I/O bitmap, the user code cannot access the ports
+    OSMOS::System::Memory::fill((uint8_t *) &OSMOS::System::Segments::TASK_STATE, sizeof(OSMOS::System::Segments::TaskState), (uint8_t) 0);
+
+    OSMOS::System::Segments::TASK_STATE.ss0 = OSMOS::System::Segments::SELECTOR_KERNEL_DATA;
+    OSMOS::System::Segments::TASK_STATE.ioMapBase = sizeof(OSMOS::System::Segments::TaskState);
+    OSMOS::System::Segments::setDescriptor(OSMOS::System::Segments::SELECTOR_TASK_STATE / 8, (address_t) &OSMOS::System::Segments::TASK_STATE, sizeof(OSMOS::System::Segments::TaskState) - 1, SEGMENTS_ACCESS_TASK_STATE, 0);
+
+    OSMOS::System::Segments::Pointer pointer;
+    pointer.limit = sizeof(OSMOS::System::Segments::TABLE) - 1;
+    pointer.base = (address_t) OSMOS::System::Segments::TABLE;
+
+    // The data segments of the user are also used by the kernel, so they are
+    // never reloaded when entering or leaving the kernel. Only the stack
+    // segment belongs to the kernel
+    asm volatile("lgdt [%[pointer]]\n \
+                  push %[code]\n \
+                  lea eax, [1f]\n \
+                  push eax\n \
+                  retf\n \
+                  1:\n \
+                  mov ss, %w[kernelData]\n \
+                  mov ds, %w[userData]\n \
+                  mov es, %w[userData]\n \
+                  mov fs, %w[userData]\n \
+                  mov gs, %w[userData]\n \
+                  ltr %w[taskState]"
+                :
+                : [pointer] "r" (&pointer), [code] "i" (OSMOS::System::Segments::SELECTOR_KERNEL_CODE),
+                  [kernelData] "r" ((uint32_t) OSMOS::System::Segments::SELECTOR_KERNEL_DATA),
+                  [userData] "r" ((uint32_t) OSMOS::System::Segments::SELECTOR_USER_DATA),
+                  [taskState] "r" ((uint32_t) OSMOS::System::Segments::SELECTOR_TASK_STATE)
+                : "eax", "memory");
+}
+
+void OSMOS::System::Segments::setKernelStack(address_t top) {
+    OSMOS::System::Segments::TASK_STATE.esp0 = top;
+}
+
+address_t OSMOS::System::Segments::getKernelStackAddress() {
+    return (address_t) &OSMOS::System::Segments::TASK_STATE.esp0;
+}
\ No newline at end of file
@@ -0,0 +1,140 @@
+/*
+ * The segments class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEGMENTS_HPP
+#define SEGMENTS_HPP
+
+#include "../osmos.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Segments' class that builds the global descriptor table, with
+         * flat kernel and user segments, and the task state segment giving the
+         * kernel stack entered from the user code
+         **/
+        class Segments {
+        public:
+            /**
+             * The number of descriptors of the global descriptor table
+             **/
+            static const uint32_t DESCRIPTOR_COUNT = 6;
+
+            /**
+             * The selectors of the segments. The order of the code and data
+             * segments is the one expected by sysenter and sysexit
+             **/
+            static const uint16_t SELECTOR_KERNEL_CODE = 0x08;
+            static const uint16_t SELECTOR_KERNEL_DATA = 0x10;
+            static const uint16_t SELECTOR_USER_CODE = 0x1B;
+            static const uint16_t SELECTOR_USER_DATA = 0x23;
+            static const uint16_t SELECTOR_TASK_STATE = 0x28;
+
+            /**
+             * An entry of the global descriptor table
+             **/
+            struct Descriptor {
+                uint16_t limitLow;
+                uint16_t baseLow;
+                uint8_t baseMiddle;
+                uint8_t access;
+                uint8_t granularity;
+                uint8_t baseHigh;
+            } __attribute__((packed));
+            /**
+             * The operand of the lgdt instruction
+             **/
+            struct Pointer {
+                uint16_t limit;
+                uint32_t base;
+            } __attribute__((packed));
+            /**
+             * The task state segment. Only the kernel stack is used, the tasks
+             * being switched by the scheduler
+             **/
+            struct TaskState {
+                uint32_t link;
+                uint32_t esp0;
+                uint32_t ss0;
+                uint32_t esp1;
+                uint32_t ss1;
+                uint32_t esp2;
+                uint32_t ss2;
+                uint32_t cr3;
+                uint32_t eip;
+                uint32_t eflags;
+                uint32_t eax;
+                uint32_t ecx;
+                uint32_t edx;
+                uint32_t ebx;
+                uint32_t esp;
+                uint32_t ebp;
+                uint32_t esi;
+                uint32_t edi;
+                uint32_t es;
+                uint32_t cs;
+                uint32_t ss;
+                uint32_t ds;
+                uint32_t fs;
+                uint32_t gs;
+                uint32_t ldt;
+                uint16_t trap;
+                uint16_t ioMapBase;
+            } __attribute__((packed));
+
+        private:
+            static OSMOS::System::Segments::Descriptor TABLE[DESCRIPTOR_COUNT];
+            static OSMOS::System::Segments::TaskState TASK_STATE;
+
+            /**
+             * @brief Sets a descriptor of the global descriptor table
+             * @param index the index of the descriptor
+             * @param base the base address of the segment
+             * @param limit the limit of the segment, in pages if the
+             * granularity flag is set
+             * @param access the access byte (presence, privilege and type)
+             * @param flags the granularity and size flags
+             **/
+            static void setDescriptor(uint32_t index, address_t base, uint32_t limit, uint8_t access, uint8_t flags);
+
+        public:
+            /**
+             * @brief Loads the global descriptor table and the task state
+             * segment, then reloads the segment registers. It must be called
+             * before the interrupts are initialized, which use the code
+             * selector
+             **/
+            static void initialize();
+
+            /**
+             * @brief Sets the stack entered by the interrupts and the system
+             * calls coming from the user code
+             * @param top the top of the kernel stack of the running thread
+             **/
+            static void setKernelStack(address_t top);
+            /**
+             * @brief Gets the address where the kernel stack is stored, which
+             * the system call entry loads its stack from
+             * @return the address of the kernel stack field
+             **/
+            static address_t getKernelStackAddress();
+        };
+    };
+};
+
+#endif
\ No newline at end of file
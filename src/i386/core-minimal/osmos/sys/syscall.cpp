@@ -0,0 +1,208 @@
+/*
+ * The system calls class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "syscall.hpp"
+
+#include "process.hpp"
+#include "processor.hpp"
+#include "scheduler.hpp"
+#include "segments.hpp"
+#include "../io/port.hpp"
+
+OSMOS::System::Syscall::Handler OSMOS::System::Syscall::TABLE[OSMOS::System::Syscall::CALL_MAXIMUM];
+
+const OSMOS::System::Paging::Pager OSMOS::System::Syscall::IMAGE_PAGER = {
+    OSMOS::System::Syscall::getImagePage,
+    OSMOS::System::Syscall::putImagePage,
+    NULL
+};
+
+// The model-specific registers of sysenter
+#define SYSCALL_MSR_CS                                      0x174
+#define SYSCALL_MSR_ESP                                     0x175
+#define SYSCALL_MSR_EIP                                     0x176
+
+// The part of the kernel image ran in user mode, defined by the linker script
+extern "C" uint8_t user_start[];
+extern "C" uint8_t user_end[];
+
+extern "C" uint32_t syscallDispatch(OSMOS::System::Syscall::Frame *frame) {
+    return OSMOS::System::Syscall::dispatch(frame);
+}
+
+// Entered by sysenter, with the interrupts disabled and the stack pointer on
+// the kernel stack field of the task state segment. The registers are saved
+// as a frame, the call runs with the interrupts enabled, then sysexit returns
+// to the address in EDX with the stack in ECX. The sti right before sysexit
+// only takes effect once back in the user code
+extern "C" void __attribute__((naked)) syscallEntry() {
+    asm("mov esp, [esp]\n \
+         push ecx\n \
+         push edx\n \
+         push ebp\n \
+         push edi\n \
+         push esi\n \
+         push ebx\n \
+         push eax\n \
+         sti\n \
+         cld\n \
+         push esp\n \
+         call syscallDispatch\n \
+         add esp, 8\n \
+         cli\n \
+         pop ebx\n \
+         pop esi\n \
+         pop edi\n \
+         pop ebp\n \
+         pop edx\n \
+         pop ecx\n \
+         sti\n \
+         sysexit");
+}
+
+// The benchmark process, ran in user mode from a mapping of the .user section
+// and so position independent. It exits with the number of cycles per call
+extern "C" void __attribute__((naked, section(".user"))) syscallBenchmark() {
+    asm("call 1f\n \
+         1:\n \
+         pop ebp\n \
+         xor eax, eax\n \
+         lea edx, [ebp + 2f - 1b]\n \
+         mov ecx, esp\n \
+         sysenter\n \
+         2:\n \
+         rdtsc\n \
+         mov esi, eax\n \
+         mov edi, edx\n \
+         mov ebx, 65536\n \
+         3:\n \
+         xor eax, eax\n \
+         lea edx, [ebp + 4f - 1b]\n \
+         mov ecx, esp\n \
+         sysenter\n \
+         4:\n \
+         dec ebx\n \
+         jnz 3b\n \
+         rdtsc\n \
+         sub eax, esi\n \
+         sbb edx, edi\n \
+         shrd eax, edx, 16\n \
+         mov ebx, eax\n \
+         mov eax, 1\n \
+         lea edx, [ebp + 5f - 1b]\n \
+         mov ecx, esp\n \
+         sysenter\n \
+         5:\n \
+         jmp 5b");
+}
+
+bool OSMOS::System::Syscall::initialize() {
+    if (!OSMOS::System::Processor::hasFeature(OSMOS::System::Processor::FEATURE_MSR | OSMOS::System::Processor::FEATURE_SEP))
+        return false;
+
+    for (uint32_t i = 0; i < OSMOS::System::Syscall::CALL_MAXIMUM; i++)
+        OSMOS::System::Syscall::TABLE[i] = NULL;
+
+    OSMOS::System::Syscall::setHandler(OSMOS::System::Syscall::CALL_NULL, OSMOS::System::Syscall::callNull);
+    OSMOS::System::Syscall::setHandler(OSMOS::System::Syscall::CALL_EXIT, OSMOS::System::Syscall::callExit);
+    OSMOS::System::Syscall::setHandler(OSMOS::System::Syscall::CALL_WRITE, OSMOS::System::Syscall::callWrite);
+    OSMOS::System::Syscall::setHandler(OSMOS::System::Syscall::CALL_YIELD, OSMOS::System::Syscall::callYield);
+
+    // The stack register points at the kernel stack field of the task state
+    // segment, which the scheduler updates, so the MSRs never change
+    OSMOS::System::Processor::writeModelSpecificRegister(SYSCALL_MSR_CS, OSMOS::System::Segments::SELECTOR_KERNEL_CODE);
+    OSMOS::System::Processor::writeModelSpecificRegister(SYSCALL_MSR_ESP, OSMOS::System::Segments::getKernelStackAddress());
+    OSMOS::System::Processor::writeModelSpecificRegister(SYSCALL_MSR_EIP, (address_t) syscallEntry);
+
+    return true;
+}
+
+void OSMOS::System::Syscall::setHandler(uint32_t number, OSMOS::System::Syscall::Handler handler) {
+    if (number < OSMOS::System::Syscall::CALL_MAXIMUM)
+        OSMOS::System::Syscall::TABLE[number] = handler;
+}
+
+uint32_t OSMOS::System::Syscall::dispatch(OSMOS::System::Syscall::Frame *frame) {
+    if (frame->eax >= OSMOS::System::Syscall::CALL_MAXIMUM)
+        return OSMOS::System::Syscall::RESULT_INVALID;
+
+    OSMOS::System::Syscall::Handler handler = OSMOS::System::Syscall::TABLE[frame->eax];
+    if (handler == NULL)
+        return OSMOS::System::Syscall::RESULT_INVALID;
+
+    return handler(frame->ebx, frame->esi, frame->edi);
+}
+
+uint32_t OSMOS::System::Syscall::callNull(uint32_t, uint32_t, uint32_t) {
+    return 0;
+}
+
+uint32_t OSMOS::System::Syscall::callExit(uint32_t code, uint32_t, uint32_t) {
+    OSMOS::System::Process::exit(code);
+    return 0;
+}
+
+uint32_t OSMOS::System::Syscall::callWrite(uint32_t buffer, uint32_t length, uint32_t) {
+    if (!OSMOS::System::Paging::check(OSMOS::System::Paging::getCurrentSpace(), buffer, length, false))
+        return OSMOS::System::Syscall::RESULT_INVALID;
+
+    // The pages are filled by the page faults as they are read
+    const uint8_t *data = (const uint8_t *) buffer;
+    for (uint32_t i = 0; i < length; i++)
+        OSMOS::IO::Port::out((uint16_t) 0x3F8, data[i]);
+
+    return length;
+}
+
+uint32_t OSMOS::System::Syscall::callYield(uint32_t, uint32_t, uint32_t) {
+    OSMOS::System::Scheduler::yield();
+    return 0;
+}
+
+address_t OSMOS::System::Syscall::getImagePage(void *object, uint32_t index) {
+    return (address_t) object + index * OSMOS::System::Paging::PAGE_SIZE;
+}
+
+void OSMOS::System::Syscall::putImagePage(void *, uint32_t) {
+}
+
+uint32_t OSMOS::System::Syscall::benchmark() {
+    if (!OSMOS::System::Processor::hasFeature(OSMOS::System::Processor::FEATURE_TSC))
+        return 0;
+
+    OSMOS::System::Paging::Space *space = OSMOS::System::Paging::create();
+    if (space == NULL)
+        return 0;
+
+    // The .user section is lent read-only to the process, never copied
+    address_t start = (address_t) user_start;
+    uint32_t length = (address_t) user_end - start;
+    address_t entry = OSMOS::System::Paging::USER_BASE + ((address_t) syscallBenchmark - start);
+
+    OSMOS::System::Process::Control *process = NULL;
+    if (OSMOS::System::Paging::addMapping(space, OSMOS::System::Paging::USER_BASE, length, OSMOS::System::Paging::MAPPING_USER, &OSMOS::System::Syscall::IMAGE_PAGER, (void *) start, 0, length))
+        process = OSMOS::System::Process::create(space, entry);
+
+    if (process == NULL) {
+        OSMOS::System::Paging::destroy(space);
+        return 0;
+    }
+
+    uint32_t cycles = OSMOS::System::Process::wait(process);
+    return (cycles != OSMOS::System::Process::EXIT_FAULT ? cycles : 0);
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+/*
+ * The system calls class
+ * Copyright (C) 2018 Alexis BELMONTE
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYSCALL_HPP
+#define SYSCALL_HPP
+
+#include "../osmos.hpp"
+
+#include "paging.hpp"
+
+namespace OSMOS {
+    namespace System {
+        /**
+         * @brief Syscall's class that enters the kernel from the user code
+         * with sysenter and leaves it with sysexit, which skip the descriptor
+         * and privilege checks of an interrupt gate. The calls are dispatched
+         * through a table indexed by their number
+         *
+         * The number of the call is given in EAX and its arguments in EBX,
+         * ESI and EDI. The user code gives its return address in EDX and its
+         * stack pointer in ECX, which are lost, and gets the result in EAX
+         **/
+        class Syscall {
+        public:
+            /**
+             * The size of the table of the calls
+             **/
+            static const uint32_t CALL_MAXIMUM = 64;
+
+            /**
+             * The calls of the kernel: one doing nothing, which measures the
+             * cost of the round trip, exiting the process, writing a buffer to
+             * the serial port, and yielding the processor
+             **/
+            static const uint32_t CALL_NULL = 0;
+            static const uint32_t CALL_EXIT = 1;
+            static const uint32_t CALL_WRITE = 2;
+            static const uint32_t CALL_YIELD = 3;
+
+            /**
+             * The result of an unknown call or of invalid arguments
+             **/
+            static const uint32_t RESULT_INVALID = 0xFFFFFFFF;
+
+            /**
+             * The number of calls measured by benchmark
+             **/
+            static const uint32_t BENCHMARK_CALLS = 65536;
+
+            /**
+             * The function of a call, given the 3 arguments and returning the
+             * result
+             **/
+            typedef uint32_t (*Handler)(uint32_t first, uint32_t second, uint32_t third);
+
+            /**
+             * The registers of the user code, as pushed by the entry stub
+             **/
+            struct Frame {
+                uint32_t eax;
+                uint32_t ebx;
+                uint32_t esi;
+                uint32_t edi;
+                uint32_t ebp;
+                /**
+                 * The return address and the stack pointer of the user code
+                 **/
+                uint32_t edx;
+                uint32_t ecx;
+            };
+
+        private:
+            static OSMOS::System::Syscall::Handler TABLE[CALL_MAXIMUM];
+            /**
+             * The pager lending the pages of the user code of the kernel
+             * image, which is the object of its mapping
+             **/
+            static const OSMOS::System::Paging::Pager IMAGE_PAGER;
+
+            /**
+             * @brief The built-in calls
+             **/
+            static uint32_t callNull(uint32_t first, uint32_t second, uint32_t third);
+            static uint32_t callExit(uint32_t code, uint32_t second, uint32_t third);
+            static uint32_t callWrite(uint32_t buffer, uint32_t length, uint32_t third);
+            static uint32_t callYield(uint32_t first, uint32_t second, uint32_t third);
+
+            /**
+             * @brief The pager functions of the kernel image, whose pages are
+             * always present
+             **/
+            static address_t getImagePage(void *object, uint32_t index);
+            static void putImagePage(void *object, uint32_t index);
+
+        public:
+            /**
+             * @brief Sets the model-specific registers of sysenter: the kernel
+             * code segment, the entry stub and the kernel stack, read from the
+             * task state segment. It must be called after the segments are
+             * initialized
+             * @return false if the processor does not support sysenter
+             **/
+            static bool initialize();
+
+            /**
+             * @brief Sets the function of a call
+             * @param number the number of the call
+             * @param handler the function, or NULL to remove the call
+             **/
+            static void setHandler(uint32_t number, OSMOS::System::Syscall::Handler handler);
+            /**
+             * @brief Runs the function of a call. It is called by the entry
+             * stub, with the interrupts enabled
+             * @param frame the registers of the user code
+             * @return the result given back to the user code
+             **/
+            static uint32_t dispatch(OSMOS::System::Syscall::Frame *frame);
+
+            /**
+             * @brief Measures the round trip of a call: runs a process making
+             * BENCHMARK_CALLS null calls between two reads of the time stamp
+             * counter
+             * @return the number of cycles per call, or 0 if the process could
+             * not be run
+             **/
+            static uint32_t benchmark();
+        };
+    };
+};
+
+#endif
\ No newline at end of file